@@ -0,0 +1,249 @@
+//
+//  ArcFlags.c
+//  Astar
+//
+//  Arc-flags: the map is split into regions and every road carries one bit
+//  per region, set when the road starts some shortest path towards a city
+//  of that region.
+//
+//  Regions come from recursive coordinate bisection: the cities are split
+//  in two halves at the median of their widest coordinate, recursively,
+//  which gives regions of equal size whatever the density of the map.
+//  Roads inside a region are flagged for it. Every other shortest path into
+//  a region enters it through a boundary city (one with a road coming from
+//  outside), so a backward Dijkstra from every boundary city flags the
+//  roads lying on shortest paths towards it. Boundary cities are shared
+//  among threads.
+//
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ArcFlags.h"
+#include "Sssp.h"
+
+/** Reverse graph of a plain graph: road i of the reverse goes along road fwd[i] **/
+typedef struct Reverse{
+    Graph g;
+    int * fwd;
+}Reverse;
+
+/** State shared by the threads building the flags **/
+typedef struct Builder{
+    Graph * g;
+    Reverse * rev;
+    ArcFlags * af;
+    int * boundary;
+    int next;
+    int failed;
+}Builder;
+
+
+/** private comparison of nodes by one of their coordinates, for bisect **/
+static const int * sort_coord;
+static int compCoord(const void * a, const void * b){
+    return sort_coord[*(const int *)a] - sort_coord[*(const int *)b];
+}
+
+
+/*************************************************************
+ * private function splitting nodes[0 .. n-1] into k regions numbered
+ * from first, by recursive coordinate bisection
+ *************************************************************/
+static void bisect(Graph * g, int * nodes, int n, int k, int first, int * region){
+    if (k <= 1 || n <= 1){
+        for (int i = 0; i < n; i++) region[nodes[i]] = first;
+        return;
+    }
+    int minLat = g->lat[nodes[0]], maxLat = minLat, minLgt = g->lgt[nodes[0]], maxLgt = minLgt;
+    for (int i = 1; i < n; i++){
+        int u = nodes[i];
+        if (g->lat[u] < minLat) minLat = g->lat[u];
+        if (g->lat[u] > maxLat) maxLat = g->lat[u];
+        if (g->lgt[u] < minLgt) minLgt = g->lgt[u];
+        if (g->lgt[u] > maxLgt) maxLgt = g->lgt[u];
+    }
+    sort_coord = maxLat - minLat >= maxLgt - minLgt ? g->lat : g->lgt;
+    qsort(nodes, n, sizeof(int), compCoord);
+    
+    /* the halves get a number of regions, hence of cities, in proportion */
+    int kLow = k / 2;
+    int nLow = (int)((long)n * kLow / k);
+    bisect(g, nodes, nLow, kLow, first, region);
+    bisect(g, nodes + nLow, n - nLow, k - kLow, first + kLow, region);
+}
+
+
+/*************************************************************
+ * private function building the reverse of a plain graph
+ *************************************************************/
+static Reverse * reverse_graph(Graph * g){
+    int n = g->nCities, m = g->nEdges;
+    Reverse * r = (Reverse *) calloc(1, sizeof(Reverse));
+    if (!r) return NULL;
+    r->g.nCities = n;
+    r->g.nEdges = m;
+    r->g.first = (int *) calloc(n + 2, sizeof(int));
+    r->g.adj = (int *) malloc((m + 1) * sizeof(int));
+    r->g.dist = (int *) malloc((m + 1) * sizeof(int));
+    r->fwd = (int *) malloc((m + 1) * sizeof(int));
+    if (!r->g.first || !r->g.adj || !r->g.dist || !r->fwd){
+        free(r->g.first); free(r->g.adj); free(r->g.dist); free(r->fwd); free(r);
+        return NULL;
+    }
+    
+    /* count incoming roads, turn counts into offsets, then place every road */
+    for (int e = 0; e < m; e++) r->g.first[g->adj[e] + 2]++;
+    for (int v = 0; v < n; v++){
+        r->g.first[v + 2] += r->g.first[v + 1];
+        int degree = r->g.first[v + 2] - r->g.first[v + 1];
+        if (degree > r->g.maxDegree) r->g.maxDegree = degree;
+    }
+    for (int u = 0; u < n; u++)
+        for (int e = g->first[u]; e < g->first[u+1]; e++){
+            int i = r->g.first[g->adj[e] + 1]++;
+            r->g.adj[i] = u;
+            r->g.dist[i] = g->dist[e];
+            r->fwd[i] = e;
+        }
+    return r;
+}
+
+static void delReverse(Reverse * r){
+    if (!r) return;
+    free(r->g.first); free(r->g.adj); free(r->g.dist); free(r->fwd); free(r);
+}
+
+
+/*************************************************************
+ * private function run by every thread: take the next boundary city,
+ * compute the distances towards it and flag the roads that are tight
+ *************************************************************/
+static void * flag_worker(void * arg){
+    Builder * b = (Builder *)arg;
+    int n = b->g->nCities;
+    int * dist = (int *) malloc((n + 1) * sizeof(int));
+    int * parent = (int *) malloc((n + 1) * sizeof(int));
+    if (!dist || !parent) b->failed = 1;
+    
+    for (;;){
+        int i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->af->nBoundary || b->failed) break;
+        int target = b->boundary[i];
+        unsigned long long bit = 1ULL << b->af->region[target];
+        
+        /* dist[u] is the distance from u to target */
+        if (dijkstra(&b->rev->g, target, dist, parent) != OK){
+            b->failed = 1;
+            break;
+        }
+        Graph * r = &b->rev->g;
+        for (int v = 0; v < n; v++){
+            if (dist[v] == UNREACHED) continue;
+            for (int k = r->first[v]; k < r->first[v+1]; k++)
+                if (dist[r->adj[k]] == dist[v] + r->dist[k])
+                    __atomic_fetch_or(&b->af->flags[b->rev->fwd[k]], bit, __ATOMIC_RELAXED);
+        }
+    }
+    
+    free(dist);
+    free(parent);
+    return NULL;
+}
+
+
+/*************************************************************
+ * Split the map into regions and compute the flags of every road.
+ * The flags refer to road indices: renumbering the graph afterwards
+ * invalidates them.
+ * @param g the graph (plain arrays)
+ * @param nRegions number of regions, from 1 to MAX_REGIONS
+ * @param nThreads number of threads, 0 to use every online processor
+ * @return the arc-flags
+ * @return NULL if the graph is stored, nRegions is out of range or memory allocation failed
+ *************************************************************/
+ArcFlags * build_arc_flags(Graph * g, int nRegions, int nThreads){
+    int n = g->nCities, m = g->nEdges;
+    if (g->store || nRegions < 1 || nRegions > MAX_REGIONS) return NULL;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    
+    ArcFlags * af = (ArcFlags *) calloc(1, sizeof(ArcFlags));
+    int * nodes = (int *) malloc((n + 1) * sizeof(int));
+    int * boundary = (int *) malloc((n + 1) * sizeof(int));
+    Reverse * rev = reverse_graph(g);
+    if (af){
+        af->nRegions = nRegions;
+        af->region = (int *) malloc((n + 1) * sizeof(int));
+        af->flags = (unsigned long long *) calloc(m + 1, sizeof(unsigned long long));
+    }
+    if (!af || !nodes || !boundary || !rev || !af->region || !af->flags){
+        free(nodes); free(boundary); delReverse(rev); delArcFlags(af);
+        return NULL;
+    }
+    
+    for (int u = 0; u < n; u++) nodes[u] = u;
+    bisect(g, nodes, n, nRegions, 0, af->region);
+    free(nodes);
+    
+    /* roads inside a region are flagged for it; their targets are boundary cities otherwise */
+    char * isBoundary = (char *) calloc(n + 1, sizeof(char));
+    if (!isBoundary){
+        free(boundary); delReverse(rev); delArcFlags(af);
+        return NULL;
+    }
+    for (int u = 0; u < n; u++)
+        for (int e = g->first[u]; e < g->first[u+1]; e++){
+            int v = g->adj[e];
+            if (af->region[u] == af->region[v]) af->flags[e] |= 1ULL << af->region[u];
+            else isBoundary[v] = 1;
+        }
+    for (int v = 0; v < n; v++) if (isBoundary[v]) boundary[af->nBoundary++] = v;
+    free(isBoundary);
+    
+    Builder b = {g, rev, af, boundary, 0, 0};
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t * threads = (pthread_t *) malloc((nThreads > 1 ? nThreads : 1) * sizeof(pthread_t));
+    int started = 1;
+    if (threads)
+        for (; started < nThreads; started++)
+            if (pthread_create(&threads[started], NULL, flag_worker, &b) != 0) break;
+    flag_worker(&b);
+    for (int t = 1; t < started; t++) pthread_join(threads[t], NULL);
+    free(threads);
+    free(boundary);
+    delReverse(rev);
+    
+    if (b.failed){
+        delArcFlags(af);
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    af->buildSeconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    return af;
+}
+
+
+/*************************************************************
+ * Destroy arc-flags by deallocating used memory
+ * @param af the arc-flags to destroy
+ *************************************************************/
+void delArcFlags(ArcFlags * af){
+    if (!af) return;
+    free(af->region);
+    free(af->flags);
+    free(af);
+}
+
+
+/*************************************************************
+ * Number of bytes used by the flags (only the bits of the existing
+ * regions are counted, as they would be stored) and the regions
+ * @param g the graph the flags were built for
+ * @param af the arc-flags
+ * @return the size in bytes
+ *************************************************************/
+size_t arc_flags_bytes(Graph * g, ArcFlags * af){
+    return (size_t)g->nEdges * ((af->nRegions + 7) / 8) + (size_t)g->nCities * sizeof(int);
+}
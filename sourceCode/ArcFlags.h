@@ -0,0 +1,37 @@
+//
+//  ArcFlags.h
+//  Astar
+//
+//  Arc-flags: the map is split into regions and every road carries one bit
+//  per region, set when the road starts some shortest path towards a city
+//  of that region. A search towards a goal only follows the roads flagged
+//  for the region of the goal.
+//
+
+#ifndef ArcFlags_h
+#define ArcFlags_h
+
+#include "Graph.h"
+
+/** maximum number of regions (one bit each in a flag word) **/
+#define MAX_REGIONS 64
+
+/** ArcFlags structure: flags[e] is the bit set of the road e of the array view **/
+typedef struct ArcFlags{
+    int nRegions;
+    int * region;
+    unsigned long long * flags;
+    int nBoundary;
+    double buildSeconds;
+}ArcFlags;
+
+/** Split the map into regions and compute the flags of every road **/
+ArcFlags * build_arc_flags(Graph *, int, int);
+
+/** Destroy arc-flags by deallocating used memory **/
+void delArcFlags(ArcFlags *);
+
+/** Number of bytes used by the flags and the regions **/
+size_t arc_flags_bytes(Graph *, ArcFlags *);
+
+#endif /* ArcFlags_h */
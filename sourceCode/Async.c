@@ -0,0 +1,288 @@
+//
+//  Async.c
+//  Astar
+//
+//  Asynchronous searches on one graph.
+//
+//  Submitted tickets wait in a bounded ring: when it is full, submitting
+//  either blocks or fails with ERRFULL, so a caller cannot queue more work
+//  than the threads take. Each thread owns a workspace and a path buffer
+//  for all its searches. An answered ticket is handed to its callback, on
+//  the thread that answered it, or appended to the list of answered
+//  tickets; the eventfd, in semaphore mode, counts the tickets of that
+//  list, so it stays readable while one is waiting and an event loop can
+//  poll it with the other descriptors it watches.
+//
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "Async.h"
+
+/** Argument of a thread of a router **/
+typedef struct Worker{
+    struct Router * r;
+    Workspace * ws;
+}Worker;
+
+struct Router{
+    Graph * g;
+    int nThreads;
+    int nWorkers;
+    pthread_t * threads;
+    Worker * workers;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    pthread_cond_t idle;
+    Ticket ** queue;
+    int capacity;
+    int head;
+    int count;
+    int outstanding;
+    int stopping;
+    Ticket * doneHead;
+    Ticket * doneTail;
+    int fd;
+};
+
+
+/*************************************************************
+ * Create a query from start to goal
+ * @param start index of the start city
+ * @param goal index of the goal city
+ * @param b limits of the search, NULL for none
+ * @param done called when the query is answered, NULL to collect it with router_done
+ * @param arg passed to done
+ * @return the ticket, to destroy with delTicket once answered
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Ticket * newTicket(int start, int goal, const Budget * b, ticketCallback done, void * arg){
+    Ticket * t = (Ticket *) calloc(1, sizeof(Ticket));
+    if (!t) return NULL;
+    t->start = start;
+    t->goal = goal;
+    if (b) t->budget = *b;
+    t->done = done;
+    t->arg = arg;
+    t->res = ERRUNABLE;
+    return t;
+}
+
+
+/*************************************************************
+ * Destroy a ticket and its path
+ * @param t the ticket
+ *************************************************************/
+void delTicket(Ticket * t){
+    if (!t) return;
+    delPath(t->path);
+    free(t);
+}
+
+
+/** private function answering a ticket with the workspace of the calling thread **/
+static void answer(Router * r, Workspace * ws, Ticket * t){
+    t->res = astar(r->g, t->start, t->goal, &t->budget, ws, &t->stats);
+    if (t->res == OK || t->res == ERRBUDGET){
+        t->path = newReachedPath(ws);
+        if (!t->path) t->res = ERRALLOC;
+    }
+}
+
+
+/** private function run by every thread of a router: answers tickets until the router stops **/
+static void * route(void * arg){
+    Worker * w = (Worker *)arg;
+    Router * r = w->r;
+    for (;;){
+        pthread_mutex_lock(&r->lock);
+        while (r->count == 0 && !r->stopping) pthread_cond_wait(&r->notEmpty, &r->lock);
+        if (r->count == 0){
+            pthread_mutex_unlock(&r->lock);
+            return NULL;
+        }
+        Ticket * t = r->queue[r->head];
+        r->head = (r->head + 1) % r->capacity;
+        r->count--;
+        pthread_cond_signal(&r->notFull);
+        pthread_mutex_unlock(&r->lock);
+        
+        answer(r, w->ws, t);
+        
+        /* the ticket belongs to the callback or to the list from now on */
+        ticketCallback done = t->done;
+        if (done) done(t, t->arg);
+        pthread_mutex_lock(&r->lock);
+        if (!done){
+            uint64_t one = 1;
+            t->next = NULL;
+            if (r->doneTail) r->doneTail->next = t;
+            else r->doneHead = t;
+            r->doneTail = t;
+            while (write(r->fd, &one, sizeof one) < 0 && errno == EINTR);
+        }
+        if (--r->outstanding == 0) pthread_cond_broadcast(&r->idle);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+
+/*************************************************************
+ * Create a router: a pool of threads searching the given graph
+ * @param g the graph, which must outlive the router
+ * @param nThreads number of threads, 0 for one per processor
+ * @param capacity number of tickets the queue holds before submitting waits or fails
+ * @return the router
+ * @return NULL if memory allocation failed or a thread could not be started
+ *************************************************************/
+Router * newRouter(Graph * g, int nThreads, int capacity){
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads < 1) nThreads = 1;
+    if (capacity < 1) capacity = 1;
+    Router * r = (Router *) calloc(1, sizeof(Router));
+    if (!r) return NULL;
+    r->g = g;
+    r->capacity = capacity;
+    r->nWorkers = nThreads;
+    r->threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
+    r->workers = (Worker *) calloc(nThreads, sizeof(Worker));
+    r->queue = (Ticket **) malloc(capacity * sizeof(Ticket *));
+    r->fd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->notEmpty, NULL);
+    pthread_cond_init(&r->notFull, NULL);
+    pthread_cond_init(&r->idle, NULL);
+    int ok = r->threads && r->workers && r->queue && r->fd >= 0;
+    for (int t = 0; ok && t < nThreads; t++){
+        r->workers[t].r = r;
+        ok = (r->workers[t].ws = newWorkspace(g)) != NULL;
+    }
+    while (ok && r->nThreads < nThreads){
+        ok = pthread_create(&r->threads[r->nThreads], NULL, route, &r->workers[r->nThreads]) == 0;
+        if (ok) r->nThreads++;
+    }
+    if (!ok){
+        delRouter(r);
+        return NULL;
+    }
+    return r;
+}
+
+
+/*************************************************************
+ * Wait for the submitted queries, stop the threads and destroy the
+ * router; the answered tickets not taken by router_done are destroyed
+ * @param r the router
+ *************************************************************/
+void delRouter(Router * r){
+    if (!r) return;
+    pthread_mutex_lock(&r->lock);
+    r->stopping = 1;
+    pthread_cond_broadcast(&r->notEmpty);
+    pthread_cond_broadcast(&r->notFull);
+    pthread_mutex_unlock(&r->lock);
+    for (int t = 0; t < r->nThreads; t++) pthread_join(r->threads[t], NULL);
+    
+    while (r->doneHead){
+        Ticket * t = r->doneHead;
+        r->doneHead = t->next;
+        delTicket(t);
+    }
+    for (int t = 0; r->workers && t < r->nWorkers; t++) delWorkspace(r->workers[t].ws);
+    if (r->fd >= 0) close(r->fd);
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->notEmpty);
+    pthread_cond_destroy(&r->notFull);
+    pthread_cond_destroy(&r->idle);
+    free(r->threads);
+    free(r->workers);
+    free(r->queue);
+    free(r);
+}
+
+
+/*************************************************************
+ * Let the searches of a router use a goal cache (GoalCache.h): the goals
+ * many tickets go to are then searched with exact estimates. To call
+ * before submitting tickets; the cache must outlive the router.
+ * @param r the router
+ * @param goals the cache, made for the graph of the router, NULL for none
+ *************************************************************/
+void router_use_goals(Router * r, struct GoalCache * goals){
+    pthread_mutex_lock(&r->lock);
+    for (int t = 0; t < r->nWorkers; t++) r->workers[t].ws->goals = goals;
+    pthread_mutex_unlock(&r->lock);
+}
+
+
+/*************************************************************
+ * Submit a ticket to the threads of a router
+ * @param r the router
+ * @param t the ticket, owned by the router until it is answered
+ * @param wait whether to wait for room when the queue is full
+ * @return ERRINDEX if start or goal is not a node of the graph
+ * @return ERRFULL if the queue is full and wait is not set
+ * @return ERRUNABLE if the router is being destroyed
+ * @return OK otherwise
+ *************************************************************/
+status router_submit(Router * r, Ticket * t, int wait){
+    if (t->start < 0 || t->start >= r->g->nCities || t->goal < 0 || t->goal >= r->g->nCities)
+        return ERRINDEX;
+    pthread_mutex_lock(&r->lock);
+    while (wait && r->count == r->capacity && !r->stopping) pthread_cond_wait(&r->notFull, &r->lock);
+    status res = r->stopping ? ERRUNABLE : r->count == r->capacity ? ERRFULL : OK;
+    if (res == OK){
+        r->queue[(r->head + r->count) % r->capacity] = t;
+        r->count++;
+        r->outstanding++;
+        pthread_cond_signal(&r->notEmpty);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return res;
+}
+
+
+/*************************************************************
+ * File descriptor of a router, readable while answered tickets without
+ * callback wait to be taken by router_done (do not read it directly)
+ * @param r the router
+ * @return the descriptor (an eventfd)
+ *************************************************************/
+int router_fd(Router * r){
+    return r->fd;
+}
+
+
+/*************************************************************
+ * Take the oldest answered ticket without callback
+ * @param r the router
+ * @return the ticket, to destroy with delTicket
+ * @return NULL if none is waiting
+ *************************************************************/
+Ticket * router_done(Router * r){
+    pthread_mutex_lock(&r->lock);
+    Ticket * t = r->doneHead;
+    if (t){
+        uint64_t one;
+        r->doneHead = t->next;
+        if (!r->doneHead) r->doneTail = NULL;
+        while (read(r->fd, &one, sizeof one) < 0 && errno == EINTR);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return t;
+}
+
+
+/*************************************************************
+ * Wait until every ticket submitted so far is answered (and its
+ * callback, if any, has returned)
+ * @param r the router
+ *************************************************************/
+void router_drain(Router * r){
+    pthread_mutex_lock(&r->lock);
+    while (r->outstanding > 0) pthread_cond_wait(&r->idle, &r->lock);
+    pthread_mutex_unlock(&r->lock);
+}
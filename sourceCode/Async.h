@@ -0,0 +1,65 @@
+//
+//  Async.h
+//  Astar
+//
+//  Asynchronous searches: queries are submitted to a router, a pool of
+//  threads searching one graph, and their results delivered through a
+//  callback or collected when an eventfd becomes readable.
+//
+
+#ifndef Async_h
+#define Async_h
+
+#include "Graph.h"
+#include "Search.h"
+#include "Path.h"
+
+struct Ticket;
+
+/** Called by a thread of the router when the search of a ticket is over **/
+typedef void (*ticketCallback)(struct Ticket *, void *);
+
+/** A submitted query: res, path and stats are set once it is done **/
+typedef struct Ticket{
+    int start;
+    int goal;
+    Budget budget;
+    ticketCallback done;
+    void * arg;
+    status res;
+    Path * path;
+    SearchStats stats;
+    struct Ticket * next;
+}Ticket;
+
+/** Pool of threads answering the queries submitted on a graph **/
+typedef struct Router Router;
+
+/** Create a query from start to goal, done being called when it is answered **/
+Ticket * newTicket(int, int, const Budget *, ticketCallback, void *);
+
+/** Destroy a ticket and its path **/
+void delTicket(Ticket *);
+
+/** Create a router of the given number of threads and queue capacity **/
+Router * newRouter(Graph *, int, int);
+
+/** Wait for the submitted queries, stop the threads and destroy the router **/
+void delRouter(Router *);
+
+/** Let the searches of a router take exact estimates toward hot goals from a cache **/
+void router_use_goals(Router *, struct GoalCache *);
+
+/** Submit a ticket, waiting for room in the queue or not **/
+status router_submit(Router *, Ticket *, int);
+
+/** File descriptor readable while answered tickets without callback wait **/
+int router_fd(Router *);
+
+/** Take an answered ticket without callback, NULL if none is waiting **/
+Ticket * router_done(Router *);
+
+/** Wait until every submitted ticket is answered **/
+void router_drain(Router *);
+
+#endif /* Async_h */
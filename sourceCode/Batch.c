@@ -0,0 +1,159 @@
+//
+//  Batch.c
+//  Astar
+//
+//  Batches of queries answered together.
+//
+//  Grouped, the queries are sorted by start city and every group is
+//  answered by a single search: it is begun once from the start city and
+//  resumed for each goal, the nearest goals first, so the nodes settled
+//  for one goal are not expanded again for the next ones, and goals
+//  already settled cost nothing. Every path is read from the parent array
+//  shared by the group as soon as its goal is settled.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "Batch.h"
+#include "Spatial.h"
+
+/** Position of a query in the order it is answered in **/
+typedef struct Slot{
+    int start;
+    int h;
+    int index;
+}Slot;
+
+
+/*************************************************************
+ * Read a batch of queries, one "start goal" pair of city names (or of
+ * coordinates "lat,lgt", see find_place) per line.
+ * A query naming an unknown city is kept with res set to ERRABSENT, and
+ * the name read for that city in startName or goalName (NULL otherwise).
+ * @param g the graph
+ * @param filepath the file to read
+ * @param n (out) number of queries
+ * @return the queries, to destroy with delBatch
+ * @return NULL if the file cannot be read or memory allocation failed
+ *************************************************************/
+BatchQuery * read_batch(Graph * g, char * filepath, int * n){
+    FILE * f = fopen(filepath, "r");
+    if (!f) return NULL;
+    int capacity = 64;
+    BatchQuery * q = (BatchQuery *) malloc(capacity * sizeof(BatchQuery));
+    char from[64], to[64], line[256];
+    *n = 0;
+    while (q && fgets(line, sizeof line, f)){
+        if (sscanf(line, "%63s %63s", from, to) != 2) continue;
+        if (*n == capacity){
+            capacity *= 2;
+            BatchQuery * bigger = (BatchQuery *) realloc(q, capacity * sizeof(BatchQuery));
+            if (!bigger){
+                free(q);
+                q = NULL;
+                break;
+            }
+            q = bigger;
+        }
+        BatchQuery * cur = &q[(*n)++];
+        cur->start = find_place(g, from);
+        cur->goal = find_place(g, to);
+        cur->startName = cur->start < 0 ? strdup(from) : NULL;
+        cur->goalName = cur->goal < 0 ? strdup(to) : NULL;
+        cur->res = cur->start < 0 || cur->goal < 0 ? ERRABSENT : OK;
+        cur->path = NULL;
+    }
+    fclose(f);
+    return q;
+}
+
+
+/*************************************************************
+ * Destroy a batch and the paths of its answers
+ * @param q the queries
+ * @param n number of queries
+ *************************************************************/
+void delBatch(BatchQuery * q, int n){
+    if (!q) return;
+    for (int i = 0; i < n; i++){
+        delPath(q[i].path);
+        free(q[i].startName);
+        free(q[i].goalName);
+    }
+    free(q);
+}
+
+
+/** private function ordering queries by start city, then nearest goal first **/
+static int by_start(const void * a, const void * b){
+    const Slot * x = (const Slot *)a, * y = (const Slot *)b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    if (x->h != y->h) return x->h < y->h ? -1 : 1;
+    return x->index - y->index;
+}
+
+
+/** private function adding the statistics of a search to a total **/
+static void add_stats(SearchStats * total, const SearchStats * st){
+    total->expanded += st->expanded;
+    total->relaxed += st->relaxed;
+    total->reopened += st->reopened;
+    total->pruned += st->pruned;
+    if (st->bytes > total->bytes) total->bytes = st->bytes;
+}
+
+
+/*************************************************************
+ * Answer all the queries of a batch. Grouped, the queries with the same
+ * start city share one search (see astar_resume, arc-flags are then not
+ * used); otherwise every query is an independent astar.
+ * @param g the graph
+ * @param q the queries, their res and path are set
+ * @param n number of queries
+ * @param grouped whether the queries are grouped by start city
+ * @param b limits of every query (of each resumption, grouped), NULL for none
+ * @param ws workspace of the searches
+ * @param total (out) statistics summed over the batch (bytes: the largest), may be NULL
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ *************************************************************/
+status run_batch(Graph * g, BatchQuery * q, int n, int grouped, const Budget * b,
+                 Workspace * ws, SearchStats * total){
+    SearchStats local;
+    if (!total) total = &local;
+    memset(total, 0, sizeof(SearchStats));
+    double t0 = search_clock();
+    
+    Slot * order = (Slot *) malloc((n + 1) * sizeof(Slot));
+    if (!order) return ERRALLOC;
+    int m = 0;
+    for (int i = 0; i < n; i++){
+        if (q[i].res == ERRABSENT) continue;
+        order[m].start = q[i].start;
+        order[m].h = graph_h(g, q[i].start, q[i].goal);
+        order[m].index = i;
+        m++;
+    }
+    if (grouped) qsort(order, m, sizeof(Slot), by_start);
+    
+    status res = OK;
+    for (int k = 0; k < m && res == OK; k++){
+        BatchQuery * cur = &q[order[k].index];
+        SearchStats st;
+        if (!grouped) cur->res = astar(g, cur->start, cur->goal, b, ws, &st);
+        else {
+            if ((k == 0 || order[k-1].start != cur->start) && astar_begin(g, cur->start, ws) != OK){
+                res = ERRALLOC;
+                break;
+            }
+            cur->res = astar_resume(g, cur->goal, b, ws, &st);
+        }
+        add_stats(total, &st);
+        if (cur->res == ERRALLOC) res = ERRALLOC;
+        else if (cur->res != ERRNOPATH && !(cur->path = newReachedPath(ws))) res = ERRALLOC;
+    }
+    
+    free(order);
+    total->seconds = search_clock() - t0;
+    return res;
+}
@@ -0,0 +1,36 @@
+//
+//  Batch.h
+//  Astar
+//
+//  Batches of queries: the queries sharing a start city are answered by
+//  one search, resumed from goal to goal.
+//
+
+#ifndef Batch_h
+#define Batch_h
+
+#include "Graph.h"
+#include "Search.h"
+#include "Path.h"
+
+/** A query of a batch and its answer: res is OK with the path, ERRBUDGET
+ * with the best partial path, or the reason there is no path **/
+typedef struct BatchQuery{
+    int start;
+    int goal;
+    char * startName;
+    char * goalName;
+    status res;
+    Path * path;
+}BatchQuery;
+
+/** Read a batch of queries, one "start goal" pair of city names or coordinates per line **/
+BatchQuery * read_batch(Graph *, char *, int *);
+
+/** Destroy a batch and the paths of its answers **/
+void delBatch(BatchQuery *, int);
+
+/** Answer all the queries of a batch, grouped by start city or not **/
+status run_batch(Graph *, BatchQuery *, int, int, const Budget *, Workspace *, SearchStats *);
+
+#endif /* Batch_h */
@@ -0,0 +1,524 @@
+//
+//  Compress.c
+//  Astar
+//
+//  Compressed storage of a graph, in memory and on disk.
+//
+//  Roads: the record of node u starts at data[offset[u]] with the varint
+//  degree of u, followed by its roads sorted by target. Each road is the
+//  varint of (zigzag(target - previous target) << 1 | mirrored), previous
+//  target starting at u. A road to a smaller node v whose reverse road has
+//  the same distance is "mirrored": its distance is only stored in the
+//  record of v. Other roads are followed by their distance on wBytes bytes
+//  (1, 2 or 4, the narrowest that fits every distance of the graph).
+//
+//  Names: sorted by name and front-coded in blocks of NAME_BLOCK: the first
+//  name of a block is complete, the next ones are stored as the varint
+//  length of the prefix shared with the previous name, the varint length of
+//  the rest and the rest itself.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "Compress.h"
+
+#define NAME_BLOCK 16
+
+static const char magic[4] = {'A', 'C', 'G', '2'};
+/** ints of the header of a file: counts, sizes and metric of the estimate **/
+#define HEADER_INTS 9
+
+/** Compressed roads and names of a graph **/
+typedef struct Packed{
+    int nCities;
+    int wBytes;
+    unsigned * offset;
+    unsigned char * data;
+    unsigned nData;
+    size_t dataRoom;
+    int nBlocks;
+    unsigned * blockOffset;
+    unsigned char * pool;
+    unsigned nPool;
+    size_t poolRoom;
+    int * nodeOfRank;
+    int * rankOfNode;
+}Packed;
+
+
+/** private function appending a varint to a byte buffer **/
+static unsigned char * put_varint(unsigned char * p, unsigned v){
+    while (v >= 0x80){
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+/** private function reading a varint from a byte buffer **/
+static inline const unsigned char * get_varint(const unsigned char * p, unsigned * v){
+    unsigned r = *p & 0x7f;
+    int shift = 7;
+    while (*p++ & 0x80){
+        r |= (unsigned)(*p & 0x7f) << shift;
+        shift += 7;
+    }
+    *v = r;
+    return p;
+}
+
+static inline unsigned zigzag(int v){ return ((unsigned)v << 1) ^ (unsigned)(v >> 31); }
+static inline int unzigzag(unsigned v){ return (int)(v >> 1) ^ -(int)(v & 1); }
+
+static inline int get_weight(const unsigned char * p, int wBytes){
+    if (wBytes == 1) return p[0];
+    if (wBytes == 2) return p[0] | p[1] << 8;
+    return (int)(p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24);
+}
+
+static unsigned char * put_weight(unsigned char * p, int w, int wBytes){
+    for (int i = 0; i < wBytes; i++) *p++ = (unsigned char)(w >> (8 * i));
+    return p;
+}
+
+
+/*************************************************************
+ * private function finding the distance of the road from v to u in the
+ * record of v (where it is never mirrored since u > v)
+ *************************************************************/
+static int mirrored_distance(const Packed * pk, int v, int u){
+    const unsigned char * p = pk->data + pk->offset[v];
+    unsigned degree, code;
+    int target = v;
+    p = get_varint(p, &degree);
+    while (degree--){
+        p = get_varint(p, &code);
+        target += unzigzag(code >> 1);
+        if (code & 1) continue;
+        if (target == u) return get_weight(p, pk->wBytes);
+        p += pk->wBytes;
+    }
+    return -1;
+}
+
+
+/** decoding function of the roads of a node, see GraphStore **/
+static int packed_roads(void * data, int u, int * adj, int * dist){
+    const Packed * pk = (const Packed *)data;
+    const unsigned char * p = pk->data + pk->offset[u];
+    unsigned degree, code;
+    int target = u;
+    p = get_varint(p, &degree);
+    for (unsigned k = 0; k < degree; k++){
+        p = get_varint(p, &code);
+        target += unzigzag(code >> 1);
+        adj[k] = target;
+        if (code & 1) dist[k] = mirrored_distance(pk, target, u);
+        else {
+            dist[k] = get_weight(p, pk->wBytes);
+            p += pk->wBytes;
+        }
+    }
+    return (int)degree;
+}
+
+
+/** private function decoding the name of given rank into buf **/
+static void rank_name(const Packed * pk, int rank, char * buf){
+    const unsigned char * p = pk->pool + pk->blockOffset[rank / NAME_BLOCK];
+    unsigned shared, len;
+    for (int i = rank - rank % NAME_BLOCK; i <= rank; i++){
+        p = get_varint(p, &shared);
+        p = get_varint(p, &len);
+        memcpy(buf + shared, p, len);
+        buf[shared + len] = '\0';
+        p += len;
+    }
+}
+
+/** decoding function of the name of a node, see GraphStore **/
+static void packed_name(void * data, int u, char * buf){
+    const Packed * pk = (const Packed *)data;
+    rank_name(pk, pk->rankOfNode[u], buf);
+}
+
+/** lookup function of a node by its name, see GraphStore **/
+static int packed_find(void * data, char * name){
+    const Packed * pk = (const Packed *)data;
+    char buf[20];
+    
+    /* binary search on the first name of every block, then scan the block */
+    int lo = 0, hi = pk->nBlocks - 1;
+    while (lo < hi){
+        int mid = (lo + hi + 1) / 2;
+        rank_name(pk, mid * NAME_BLOCK, buf);
+        if (strcmp(buf, name) <= 0) lo = mid;
+        else hi = mid - 1;
+    }
+    for (int r = lo * NAME_BLOCK; r < pk->nCities && r < (lo + 1) * NAME_BLOCK; r++){
+        rank_name(pk, r, buf);
+        if (strcmp(buf, name) == 0) return pk->nodeOfRank[r];
+    }
+    return -1;
+}
+
+static void delPacked(void * data){
+    Packed * pk = (Packed *)data;
+    if (!pk) return;
+    size_t nodes = (pk->nCities + 1) * sizeof(int);
+    mem_free(MEM_GRAPH, pk->offset, nodes);
+    mem_free(MEM_GRAPH, pk->data, pk->dataRoom);
+    mem_free(MEM_GRAPH, pk->blockOffset, (pk->nBlocks + 1) * sizeof(unsigned));
+    mem_free(MEM_GRAPH, pk->pool, pk->poolRoom);
+    mem_free(MEM_GRAPH, pk->nodeOfRank, nodes);
+    mem_free(MEM_GRAPH, pk->rankOfNode, nodes);
+    free(pk);
+}
+
+
+/*************************************************************
+ * private function building an empty stored graph of n nodes around
+ * the given packed data (takes ownership of it)
+ *************************************************************/
+static Graph * stored_graph(Packed * pk, int n, int m, int maxDegree){
+    Graph * g = (Graph *) calloc(1, sizeof(Graph));
+    GraphStore * store = (GraphStore *) malloc(sizeof(GraphStore));
+    if (g){
+        g->nodeRoom = n + 1;
+        g->lat = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+        g->lgt = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+        g->component = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+    }
+    if (!g || !store || !g->lat || !g->lgt || !g->component){
+        free(store);
+        delGraph(g);
+        delPacked(pk);
+        return NULL;
+    }
+    store->roads = packed_roads;
+    store->name = packed_name;
+    store->find = packed_find;
+    store->live = NULL;
+    store->del = delPacked;
+    store->data = pk;
+    g->store = store;
+    g->nCities = n;
+    g->nEdges = m;
+    g->hMetric = METRIC_MANHATTAN;
+    g->hScale = DEFAULT_H_SCALE;
+    g->maxDegree = maxDegree;
+    return g;
+}
+
+
+/** private comparison of two nodes by city name, for compress_graph **/
+static Graph * sorted_graph;
+static int compNodeName(const void * a, const void * b){
+    return strcmp(sorted_graph->cities[*(const int *)a]->name,
+                  sorted_graph->cities[*(const int *)b]->name);
+}
+
+/** private comparison of two roads by target **/
+static int compTarget(const void * a, const void * b){
+    return ((const int *)a)[0] - ((const int *)b)[0];
+}
+
+
+/*************************************************************
+ * private function testing whether the road from u to v (v < u) with the
+ * given distance can be mirrored: v has exactly one road to u, with the
+ * same distance
+ *************************************************************/
+static int has_mirror(Graph * g, int u, int v, int distance){
+    int count = 0, same = 0;
+    for (int e = g->first[v]; e < g->first[v+1]; e++)
+        if (g->adj[e] == u){
+            count++;
+            same = g->dist[e] == distance;
+        }
+    return count == 1 && same;
+}
+
+
+/*************************************************************
+ * Build the compressed copy of a plain graph. Renumber the graph for
+ * locality first (see Reorder.h): targets of nearby nodes give small deltas.
+ * @param g the plain graph
+ * @return the compressed graph (independent of g)
+ * @return NULL if g is already stored or memory allocation failed
+ *************************************************************/
+Graph * compress_graph(Graph * g){
+    int n = g->nCities, m = g->nEdges;
+    if (g->store) return NULL;
+    
+    Packed * pk = (Packed *) calloc(1, sizeof(Packed));
+    if (!pk) return NULL;
+    int maxDist = 0;
+    for (int e = 0; e < m; e++) if (g->dist[e] > maxDist) maxDist = g->dist[e];
+    pk->nCities = n;
+    pk->wBytes = maxDist < 256 ? 1 : maxDist < 65536 ? 2 : 4;
+    pk->nBlocks = (n + NAME_BLOCK - 1) / NAME_BLOCK;
+    
+    /* worst cases: 5 bytes per varint, 19 bytes per name */
+    pk->dataRoom = 5 * (size_t)(n + 1) + (5 + pk->wBytes) * (size_t)m;
+    pk->poolRoom = 29 * (size_t)(n + 1);
+    pk->offset = (unsigned *) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(unsigned));
+    pk->data = (unsigned char *) mem_alloc(MEM_GRAPH, pk->dataRoom);
+    pk->blockOffset = (unsigned *) mem_alloc(MEM_GRAPH, (pk->nBlocks + 1) * sizeof(unsigned));
+    pk->pool = (unsigned char *) mem_alloc(MEM_GRAPH, pk->poolRoom);
+    pk->nodeOfRank = (int *) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(int));
+    pk->rankOfNode = (int *) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(int));
+    int (*roads)[2] = (int (*)[2]) malloc((g->maxDegree + 1) * sizeof(*roads));
+    if (!pk->offset || !pk->data || !pk->blockOffset || !pk->pool ||
+        !pk->nodeOfRank || !pk->rankOfNode || !roads){
+        free(roads);
+        delPacked(pk);
+        return NULL;
+    }
+    
+    /* roads */
+    unsigned char * p = pk->data;
+    for (int u = 0; u < n; u++){
+        int degree = g->first[u+1] - g->first[u];
+        for (int k = 0; k < degree; k++){
+            roads[k][0] = g->adj[g->first[u] + k];
+            roads[k][1] = g->dist[g->first[u] + k];
+        }
+        qsort(roads, degree, sizeof(*roads), compTarget);
+        
+        pk->offset[u] = (unsigned)(p - pk->data);
+        p = put_varint(p, degree);
+        int previous = u;
+        for (int k = 0; k < degree; k++){
+            int v = roads[k][0];
+            int mirrored = v < u && has_mirror(g, u, v, roads[k][1]);
+            p = put_varint(p, zigzag(v - previous) << 1 | mirrored);
+            if (!mirrored) p = put_weight(p, roads[k][1], pk->wBytes);
+            previous = v;
+        }
+    }
+    pk->offset[n] = (unsigned)(p - pk->data);
+    pk->nData = pk->offset[n];
+    free(roads);
+    
+    /* names */
+    for (int r = 0; r < n; r++) pk->nodeOfRank[r] = r;
+    sorted_graph = g;
+    qsort(pk->nodeOfRank, n, sizeof(int), compNodeName);
+    p = pk->pool;
+    char * previous = "";
+    for (int r = 0; r < n; r++){
+        char * name = g->cities[pk->nodeOfRank[r]]->name;
+        unsigned shared = 0;
+        if (r % NAME_BLOCK == 0) pk->blockOffset[r / NAME_BLOCK] = (unsigned)(p - pk->pool);
+        else while (name[shared] && name[shared] == previous[shared]) shared++;
+        unsigned len = (unsigned)strlen(name) - shared;
+        p = put_varint(p, shared);
+        p = put_varint(p, len);
+        memcpy(p, name + shared, len);
+        p += len;
+        pk->rankOfNode[pk->nodeOfRank[r]] = r;
+        previous = name;
+    }
+    pk->blockOffset[pk->nBlocks] = (unsigned)(p - pk->pool);
+    pk->nPool = pk->blockOffset[pk->nBlocks];
+    
+    /* give back what the worst cases reserved */
+    unsigned char * shrunk = (unsigned char *) mem_realloc(MEM_GRAPH, pk->data, pk->dataRoom, pk->nData + 1);
+    if (shrunk){
+        pk->data = shrunk;
+        pk->dataRoom = pk->nData + 1;
+    }
+    shrunk = (unsigned char *) mem_realloc(MEM_GRAPH, pk->pool, pk->poolRoom, pk->nPool + 1);
+    if (shrunk){
+        pk->pool = shrunk;
+        pk->poolRoom = pk->nPool + 1;
+    }
+    
+    Graph * c = stored_graph(pk, n, m, g->maxDegree);
+    if (!c) return NULL;
+    memcpy(c->lat, g->lat, n * sizeof(int));
+    memcpy(c->lgt, g->lgt, n * sizeof(int));
+    memcpy(c->component, g->component, n * sizeof(int));
+    c->nComponents = g->nComponents;
+    c->hMetric = g->hMetric;
+    c->hScale = g->hScale;
+    return c;
+}
+
+
+/*************************************************************
+ * Number of bytes used by a compressed graph
+ * @param g the compressed graph
+ * @param roads (out) bytes used by the roads alone (offsets and records), may be NULL
+ * @return total bytes of the roads, names, coordinates and components
+ *************************************************************/
+size_t compressed_bytes(Graph * g, size_t * roads){
+    Packed * pk = (Packed *)g->store->data;
+    size_t r = pk->nData + (pk->nCities + 1) * sizeof(unsigned);
+    if (roads) *roads = r;
+    return r + pk->nPool + (pk->nBlocks + 1) * sizeof(unsigned)
+        + 2 * pk->nCities * sizeof(int)     /* nodeOfRank, rankOfNode */
+        + 3 * pk->nCities * sizeof(int);    /* lat, lgt, component */
+}
+
+
+/*************************************************************
+ * Write a compressed graph to a file: magic, sizes and estimate, then
+ * every array
+ * @param g the compressed graph
+ * @param filepath file to write
+ * @return ERRUNABLE if the graph is not compressed
+ * @return ERROPEN if the file cannot be created
+ * @return ERRCLOSE if writing failed
+ * @return OK otherwise
+ *************************************************************/
+status save_compressed(Graph * g, char * filepath){
+    if (!g->store || g->store->roads != packed_roads) return ERRUNABLE;
+    Packed * pk = (Packed *)g->store->data;
+    FILE * f = fopen(filepath, "wb");
+    if (!f) return ERROPEN;
+    int n = g->nCities;
+    int header[HEADER_INTS] = {n, g->nEdges, g->maxDegree, g->nComponents,
+                               pk->wBytes, pk->nBlocks, (int)pk->nData, (int)pk->nPool, g->hMetric};
+    int ok = fwrite(magic, 1, 4, f) == 4
+        && fwrite(header, sizeof(int), HEADER_INTS, f) == HEADER_INTS
+        && fwrite(&g->hScale, sizeof(double), 1, f) == 1
+        && fwrite(pk->offset, sizeof(unsigned), n + 1, f) == (size_t)n + 1
+        && fwrite(pk->data, 1, pk->nData, f) == pk->nData
+        && fwrite(pk->blockOffset, sizeof(unsigned), pk->nBlocks + 1, f) == (size_t)pk->nBlocks + 1
+        && fwrite(pk->pool, 1, pk->nPool, f) == pk->nPool
+        && fwrite(pk->nodeOfRank, sizeof(int), n, f) == (size_t)n
+        && fwrite(g->lat, sizeof(int), n, f) == (size_t)n
+        && fwrite(g->lgt, sizeof(int), n, f) == (size_t)n
+        && fwrite(g->component, sizeof(int), n, f) == (size_t)n;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? OK : ERRCLOSE;
+}
+
+
+/** private function testing the header of a compressed file: counts
+ * that agree with each other, a known metric and a scale that is a
+ * number, and sections that fill the file exactly **/
+static int valid_header(const int * header, double scale, long size){
+    int n = header[0], m = header[1];
+    if (n < 0 || m < 0 || header[2] < 0 || header[2] > m || header[3] < 0 || header[3] > n
+        || (header[4] != 1 && header[4] != 2 && header[4] != 4)
+        || header[5] != (n + NAME_BLOCK - 1) / NAME_BLOCK || header[6] < 0 || header[7] < 0
+        || header[8] < METRIC_MANHATTAN || header[8] > METRIC_GREAT_CIRCLE || !(scale >= 0 && scale < HUGE_VAL))
+        return 0;
+    long long bytes = 4 + HEADER_INTS * (long long)sizeof(int) + (long long)sizeof(double) + (n + 1LL) * sizeof(unsigned) + header[6]
+        + (header[5] + 1LL) * sizeof(unsigned) + header[7] + 4LL * n * sizeof(int);
+    return bytes == size;
+}
+
+/** private function testing the sections of a compressed graph read from a
+ * file: records and name blocks in order within their buffers, nodes
+ * ranked once each, and components among those counted **/
+static int valid_packed(Packed * pk, Graph * g){
+    int n = pk->nCities;
+    if (pk->offset[n] != pk->nData || pk->blockOffset[0] != 0 || pk->blockOffset[pk->nBlocks] != pk->nPool)
+        return 0;
+    if (n > 0 && pk->offset[0] != 0) return 0;
+    for (int u = 0; u < n; u++)
+        if (pk->offset[u + 1] <= pk->offset[u]) return 0;
+    for (int b = 0; b < pk->nBlocks; b++)
+        if (pk->blockOffset[b + 1] <= pk->blockOffset[b]) return 0;
+    for (int u = 0; u < n; u++) pk->rankOfNode[u] = -1;
+    for (int r = 0; r < n; r++){
+        int u = pk->nodeOfRank[r];
+        if (u < 0 || u >= n || pk->rankOfNode[u] >= 0) return 0;
+        pk->rankOfNode[u] = r;
+    }
+    for (int u = 0; u < n; u++)
+        if (g->component[u] < 0 || g->component[u] >= g->nComponents) return 0;
+    return 1;
+}
+
+
+/*************************************************************
+ * Read a compressed graph written by save_compressed. The counts of the
+ * header are checked against each other and against the size of the
+ * file, and the offsets of the records and name blocks against the
+ * sections they point in (the encoded roads are trusted).
+ * @param filepath file to read
+ * @return the compressed graph
+ * @return NULL if the file cannot be read or is not a well-formed compressed graph
+ *************************************************************/
+Graph * load_compressed(char * filepath){
+    FILE * f = fopen(filepath, "rb");
+    if (!f) return NULL;
+    char m[4];
+    int header[HEADER_INTS];
+    double scale;
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    if (size < 0 || fseek(f, 0, SEEK_SET) != 0 || fread(m, 1, 4, f) != 4 || memcmp(m, magic, 4) != 0 ||
+        fread(header, sizeof(int), HEADER_INTS, f) != HEADER_INTS || fread(&scale, sizeof(double), 1, f) != 1 ||
+        !valid_header(header, scale, size)){
+        fclose(f);
+        return NULL;
+    }
+    int n = header[0];
+    Packed * pk = (Packed *) calloc(1, sizeof(Packed));
+    if (!pk){
+        fclose(f);
+        return NULL;
+    }
+    pk->nCities = n;
+    pk->wBytes = header[4];
+    pk->nBlocks = header[5];
+    pk->nData = (unsigned)header[6];
+    pk->nPool = (unsigned)header[7];
+    pk->dataRoom = (size_t)pk->nData + 1;
+    pk->poolRoom = (size_t)pk->nPool + 1;
+    pk->offset = (unsigned *) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(unsigned));
+    pk->data = (unsigned char *) mem_alloc(MEM_GRAPH, pk->dataRoom);
+    pk->blockOffset = (unsigned *) mem_alloc(MEM_GRAPH, (pk->nBlocks + 1) * sizeof(unsigned));
+    pk->pool = (unsigned char *) mem_alloc(MEM_GRAPH, pk->poolRoom);
+    pk->nodeOfRank = (int *) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(int));
+    pk->rankOfNode = (int *) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(int));
+    Graph * g = NULL;
+    if (pk->offset && pk->data && pk->blockOffset && pk->pool && pk->nodeOfRank && pk->rankOfNode)
+        g = stored_graph(pk, n, header[1], header[2]);
+    else delPacked(pk);
+    if (!g){
+        fclose(f);
+        return NULL;
+    }
+    g->nComponents = header[3];
+    g->hMetric = (metric)header[8];
+    g->hScale = scale;
+    
+    int ok = fread(pk->offset, sizeof(unsigned), n + 1, f) == (size_t)n + 1
+        && fread(pk->data, 1, pk->nData, f) == pk->nData
+        && fread(pk->blockOffset, sizeof(unsigned), pk->nBlocks + 1, f) == (size_t)pk->nBlocks + 1
+        && fread(pk->pool, 1, pk->nPool, f) == pk->nPool
+        && fread(pk->nodeOfRank, sizeof(int), n, f) == (size_t)n
+        && fread(g->lat, sizeof(int), n, f) == (size_t)n
+        && fread(g->lgt, sizeof(int), n, f) == (size_t)n
+        && fread(g->component, sizeof(int), n, f) == (size_t)n;
+    fclose(f);
+    if (!ok || !valid_packed(pk, g)){
+        delGraph(g);
+        return NULL;
+    }
+    return g;
+}
+
+
+/*************************************************************
+ * Test whether a file holds a compressed graph
+ * @param filepath file to test
+ * @return 1 if the file starts with the magic of compressed graphs
+ * @return 0 otherwise
+ *************************************************************/
+int is_compressed(char * filepath){
+    FILE * f = fopen(filepath, "rb");
+    char m[4];
+    if (!f) return 0;
+    int res = fread(m, 1, 4, f) == 4 && memcmp(m, magic, 4) == 0;
+    fclose(f);
+    return res;
+}
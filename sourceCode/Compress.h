@@ -0,0 +1,31 @@
+//
+//  Compress.h
+//  Astar
+//
+//  Compressed storage of a graph, in memory and on disk: delta and varint
+//  encoded roads, narrow distances, roads in both directions with the same
+//  distance stored once, front-coded city names.
+//
+
+#ifndef Compress_h
+#define Compress_h
+
+#include <stddef.h>
+#include "Graph.h"
+
+/** Build the compressed copy of a plain graph **/
+Graph * compress_graph(Graph *);
+
+/** Number of bytes used by a compressed graph, and by its roads alone **/
+size_t compressed_bytes(Graph *, size_t *);
+
+/** Write a compressed graph to a file **/
+status save_compressed(Graph *, char *);
+
+/** Read a compressed graph written by save_compressed **/
+Graph * load_compressed(char *);
+
+/** Test whether a file holds a compressed graph **/
+int is_compressed(char *);
+
+#endif /* Compress_h */
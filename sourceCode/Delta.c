@@ -0,0 +1,661 @@
+//
+//  Delta.c
+//  Astar
+//
+//  Changes to a loaded map held in an overlay over the base graph.
+//
+//  A delta file has one change per line ('#' starts a comment):
+//      add city NAME LAT LGT
+//      remove city NAME
+//      add road FROM TO DISTANCE
+//      remove road FROM TO
+//      set road FROM TO DISTANCE
+//  Roads go one way, as in the map files: a two-way road is two lines.
+//
+//  The overlay is a graph whose store answers from the base graph for the
+//  nodes no change touched, and from its own copy of the roads for the
+//  others (their roads are copied from the base on the first change).
+//  Cities added get the next node indices; a city removed keeps its index
+//  but loses its name and every road to or from it (roads to it are
+//  skipped when read). The base is only ever read, so it may be shared
+//  with other processes or other overlays.
+//
+//  Reading roads through the store costs a call and a copy per node: once
+//  the overlay holds roads of more than 1/COMPACT_RATIO of the nodes,
+//  apply_delta merges it into a new base (compact_overlay), in arrays
+//  again. An overlay without changes reads the arrays of its base
+//  directly. The new base is private to the process: an overlay over a
+//  shared segment, a compressed or a tiled graph holds a full copy in
+//  plain arrays once compacted, and no longer shares anything.
+//
+//  The estimate has one scale for every node and goal: a road added or
+//  set shorter than the estimate lowers that scale for the whole overlay,
+//  and the searches expand more nodes everywhere (Astar -s reports it).
+//
+//  Removed cities are told apart by the live function of the store (and by
+//  that of a compacted base for the ones removed before compaction); adding
+//  or removing a city drops the spatial index of the overlay, so lookups by
+//  coordinates never snap to a removed city.
+//
+//  Node indices only grow: workspaces made before cities were added, or
+//  before a city got more roads than any other had, are too small for the
+//  overlay and must be made again (searches refuse them).
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "Delta.h"
+#include "Spatial.h"
+
+/** compaction when more than 1/COMPACT_RATIO of the nodes have changed **/
+#define COMPACT_RATIO 8
+
+/** Roads of a node held by the overlay **/
+typedef struct Roads{
+    int n;
+    int cap;
+    int * adj;
+    int * dist;
+}Roads;
+
+/** State of an overlay: nodes from nBase on were added by deltas **/
+typedef struct Overlay{
+    Graph * g;
+    Graph * base;
+    int ownBase;
+    int nBase;
+    int cap;
+    Roads * roads;
+    char * removed;
+    int nRemoved;
+    char (*names)[20];
+    int * byName;
+    int nNamed;
+    int * baseByName;
+    int nChanged;
+}Overlay;
+
+/** Names of a compacted base, the live nodes sorted by name **/
+typedef struct Compacted{
+    char (*names)[20];
+    char * removed;
+    int * byName;
+    int nNamed;
+}Compacted;
+
+
+/** decoding function of the roads of a node, see GraphStore **/
+static int overlay_roads(void * data, int u, int * adjBuf, int * distBuf){
+    Overlay * o = (Overlay *)data;
+    const int * adj, * dist;
+    int degree;
+    if (o->roads[u].adj){
+        adj = o->roads[u].adj;
+        dist = o->roads[u].dist;
+        degree = o->roads[u].n;
+    }
+    else degree = graph_roads(o->base, u, adjBuf, distBuf, &adj, &dist);
+
+    /* skip the roads to removed cities (adj may be adjBuf: k never passes i) */
+    int k = 0;
+    for (int i = 0; i < degree; i++){
+        if (o->nRemoved && o->removed[adj[i]]) continue;
+        adjBuf[k] = adj[i];
+        distBuf[k] = dist[i];
+        k++;
+    }
+    return k;
+}
+
+/** decoding function of the name of a node, see GraphStore **/
+static void overlay_name(void * data, int u, char * buf){
+    Overlay * o = (Overlay *)data;
+    if (u >= o->nBase){
+        memcpy(buf, o->names[u - o->nBase], 20);
+        return;
+    }
+    char * name = city_name(o->base, u, buf);
+    if (name != buf) memcpy(buf, name, 20);
+}
+
+/** private comparison of the cities of a plain base by name, for qsort **/
+static City ** sort_cities;
+static int compCity(const void * a, const void * b){
+    return strcmp(sort_cities[*(const int *)a]->name, sort_cities[*(const int *)b]->name);
+}
+
+/** private function finding a city of the base: a plain base is only
+ * searched linearly by find_node, so its cities are sorted by name once **/
+static int find_base(Overlay * o, char * name){
+    Graph * b = o->base;
+    if (b->store) return find_node(b, name);
+    if (!o->baseByName){
+        o->baseByName = (int *) malloc((o->nBase + 1) * sizeof(int));
+        if (!o->baseByName) return find_node(b, name);
+        for (int u = 0; u < o->nBase; u++) o->baseByName[u] = u;
+        sort_cities = b->cities;
+        qsort(o->baseByName, o->nBase, sizeof(int), compCity);
+    }
+    int lo = 0, hi = o->nBase - 1;
+    while (lo <= hi){
+        int mid = (lo + hi) / 2;
+        int c = strcmp(b->cities[o->baseByName[mid]]->name, name);
+        if (c == 0) return o->baseByName[mid];
+        if (c < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/** lookup function of a node by its name, cities added first **/
+static int overlay_find(void * data, char * name){
+    Overlay * o = (Overlay *)data;
+    int u = find_sorted_name((const char (*)[20])o->names, o->byName, o->nNamed, name);
+    if (u >= 0) return o->nBase + u;
+    u = find_base(o, name);
+    return u >= 0 && !o->removed[u] ? u : -1;
+}
+
+/** test function of the nodes still cities: not removed here nor in the base **/
+static int overlay_live(void * data, int u){
+    Overlay * o = (Overlay *)data;
+    return !o->removed[u] && (u >= o->nBase || graph_live(o->base, u));
+}
+
+/** destruction function of the overlay; the arrays of the graph may be
+ * those of the base, so they are cleared before delGraph frees them **/
+static void delOverlay(void * data){
+    Overlay * o = (Overlay *)data;
+    o->g->first = o->g->adj = o->g->dist = NULL;
+    for (int u = 0; u < o->g->nCities; u++){
+        free(o->roads[u].adj);
+        free(o->roads[u].dist);
+    }
+    free(o->roads);
+    free(o->removed);
+    free(o->names);
+    free(o->byName);
+    free(o->baseByName);
+    if (o->ownBase) delGraph(o->base);
+    free(o);
+}
+
+
+/** decoding function of the name of a node of a compacted base **/
+static void compacted_name(void * data, int u, char * buf){
+    memcpy(buf, ((Compacted *)data)->names[u], 20);
+}
+
+/** lookup function of a node by its name in a compacted base **/
+static int compacted_find(void * data, char * name){
+    Compacted * c = (Compacted *)data;
+    return find_sorted_name((const char (*)[20])c->names, c->byName, c->nNamed, name);
+}
+
+/** test function of the nodes still cities in a compacted base **/
+static int compacted_live(void * data, int u){
+    return !((Compacted *)data)->removed[u];
+}
+
+static void delCompacted(void * data){
+    Compacted * c = (Compacted *)data;
+    free(c->names);
+    free(c->removed);
+    free(c->byName);
+    free(c);
+}
+
+
+/** private function reading the arrays of the base directly while nothing has changed **/
+static void route(Overlay * o){
+    int direct = o->nChanged == 0 && o->nRemoved == 0 && o->base->adj;
+    o->g->first = direct ? o->base->first : NULL;
+    o->g->adj = direct ? o->base->adj : NULL;
+    o->g->dist = direct ? o->base->dist : NULL;
+}
+
+
+/*************************************************************
+ * Create an overlay over a base graph: the overlay is a graph that reads
+ * like the base until deltas change it, the base being never written
+ * @param base the base graph (plain, stored or shared)
+ * @param owned set if the overlay destroys the base when it is destroyed
+ * @return the overlay
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Graph * newOverlay(Graph * base, int owned){
+    int n = base->nCities;
+    Graph * g = (Graph *) calloc(1, sizeof(Graph));
+    Overlay * o = (Overlay *) calloc(1, sizeof(Overlay));
+    GraphStore * store = (GraphStore *) malloc(sizeof(GraphStore));
+    if (g){
+        g->nodeRoom = n + 1;
+        g->lat = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+        g->lgt = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+        g->component = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+    }
+    if (o){
+        o->roads = (Roads *) calloc(n + 1, sizeof(Roads));
+        o->removed = (char *) calloc(n + 1, 1);
+        o->names = (char (*)[20]) malloc(20);
+        o->byName = (int *) malloc(sizeof(int));
+    }
+    if (!g || !o || !store || !g->lat || !g->lgt || !g->component || !o->roads || !o->removed
+        || !o->names || !o->byName){
+        delGraph(g);
+        if (o){
+            free(o->roads); free(o->removed); free(o->names); free(o->byName); free(o);
+        }
+        free(store);
+        return NULL;
+    }
+    memcpy(g->lat, base->lat, n * sizeof(int));
+    memcpy(g->lgt, base->lgt, n * sizeof(int));
+    memcpy(g->component, base->component, n * sizeof(int));
+    g->nCities = n;
+    g->nEdges = base->nEdges;
+    g->nComponents = base->nComponents;
+    g->maxDegree = base->maxDegree;
+    g->hMetric = base->hMetric;
+    g->hScale = base->hScale;
+    o->g = g;
+    o->base = base;
+    o->ownBase = owned;
+    o->nBase = n;
+    o->cap = n + 1;
+    store->roads = overlay_roads;
+    store->name = overlay_name;
+    store->find = overlay_find;
+    store->live = overlay_live;
+    store->del = delOverlay;
+    store->data = o;
+    g->store = store;
+    route(o);
+    return g;
+}
+
+
+/** private function returning the overlay of a graph, NULL if it is not one **/
+static Overlay * overlay_of(Graph * g){
+    return g->store && g->store->name == overlay_name ? (Overlay *)g->store->data : NULL;
+}
+
+
+/** Number of nodes whose roads are held by the overlay (cities added included), -1 if g is not an overlay **/
+int overlay_changes(Graph * g){
+    Overlay * o = overlay_of(g);
+    return o ? o->nChanged : -1;
+}
+
+
+/** private function returning the roads of u held by the overlay, copying them from the base first **/
+static Roads * own_roads(Overlay * o, int u){
+    Roads * r = &o->roads[u];
+    if (r->adj) return r;
+    const int * adj = NULL, * dist = NULL;
+    int * adjBuf = (int *) malloc((o->base->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((o->base->maxDegree + 1) * sizeof(int));
+    int degree = adjBuf && distBuf ? graph_roads(o->base, u, adjBuf, distBuf, &adj, &dist) : 0;
+    r->cap = degree + 4;
+    r->adj = (int *) malloc(r->cap * sizeof(int));
+    r->dist = (int *) malloc(r->cap * sizeof(int));
+    if (!adjBuf || !distBuf || !r->adj || !r->dist){
+        free(r->adj);
+        free(r->dist);
+        r->adj = r->dist = NULL;
+        r = NULL;
+    }
+    else {
+        memcpy(r->adj, adj, degree * sizeof(int));
+        memcpy(r->dist, dist, degree * sizeof(int));
+        r->n = degree;
+        o->nChanged++;
+        route(o);
+    }
+    free(adjBuf);
+    free(distBuf);
+    return r;
+}
+
+
+/** private function giving the position of the road from u to v in r, -1 if there is none **/
+static int road_at(Overlay * o, Roads * r, int v){
+    for (int i = 0; i < r->n; i++)
+        if (r->adj[i] == v && !o->removed[v]) return i;
+    return -1;
+}
+
+
+/** private function lowering the scale of the estimate if a road of length d from u to v is shorter **/
+static void keep_consistent(Graph * g, int u, int v, int d){
+    double m = graph_metric(g, g->hMetric, u, v);
+    if (m > 0 && g->hScale * m > d) g->hScale = d / m * (1 - 1e-9);
+}
+
+
+/** private function dropping the spatial index of an overlay whose cities
+ * changed: find_place builds it again when needed **/
+static void drop_spatial(Graph * g){
+    delSpatial(g->spatial);
+    g->spatial = NULL;
+}
+
+
+/** private function adding a city, unnamed roads and all, as the next node **/
+static status add_city(Overlay * o, char * name, int lat, int lgt){
+    Graph * g = o->g;
+    int u = g->nCities;
+    if (u + 1 > o->cap){
+        int cap = 2 * o->cap;
+        Roads * roads = (Roads *) realloc(o->roads, cap * sizeof(Roads));
+        if (roads) o->roads = roads;
+        char * removed = (char *) realloc(o->removed, cap);
+        if (removed) o->removed = removed;
+        char (*names)[20] = (char (*)[20]) realloc(o->names, (cap - o->nBase) * 20);
+        if (names) o->names = names;
+        int * byName = (int *) realloc(o->byName, (cap - o->nBase) * sizeof(int));
+        if (byName) o->byName = byName;
+        /* the node arrays of the graph move only once all three are allocated */
+        int * arrays[3], ** fields[3] = {&g->lat, &g->lgt, &g->component};
+        for (int k = 0; k < 3; k++) arrays[k] = (int *) mem_alloc(MEM_GRAPH, cap * sizeof(int));
+        if (!arrays[0] || !arrays[1] || !arrays[2]){
+            for (int k = 0; k < 3; k++) mem_free(MEM_GRAPH, arrays[k], cap * sizeof(int));
+            return ERRALLOC;
+        }
+        for (int k = 0; k < 3; k++){
+            memcpy(arrays[k], *fields[k], u * sizeof(int));
+            mem_free(MEM_GRAPH, *fields[k], g->nodeRoom * sizeof(int));
+            *fields[k] = arrays[k];
+        }
+        g->nodeRoom = cap;
+        if (!roads || !removed || !names || !byName) return ERRALLOC;
+        memset(o->roads + o->cap, 0, (cap - o->cap) * sizeof(Roads));
+        o->cap = cap;
+    }
+    Roads * r = &o->roads[u];
+    r->n = 0;
+    r->cap = 4;
+    r->adj = (int *) malloc(r->cap * sizeof(int));
+    r->dist = (int *) malloc(r->cap * sizeof(int));
+    if (!r->adj || !r->dist){
+        free(r->adj);
+        free(r->dist);
+        r->adj = r->dist = NULL;
+        return ERRALLOC;
+    }
+
+    /* keep the names of the cities added sorted */
+    int i = u - o->nBase, at = o->nNamed;
+    snprintf(o->names[i], 20, "%s", name);
+    while (at > 0 && strcmp(o->names[o->byName[at - 1]], name) > 0) at--;
+    memmove(o->byName + at + 1, o->byName + at, (o->nNamed - at) * sizeof(int));
+    o->byName[at] = i;
+    o->nNamed++;
+
+    o->removed[u] = 0;
+    g->lat[u] = lat;
+    g->lgt[u] = lgt;
+    g->component[u] = g->nComponents++;
+    g->nCities++;
+    o->nChanged++;
+    drop_spatial(g);
+    route(o);
+    return OK;
+}
+
+
+/** private function removing a city: it keeps its node, without name nor roads **/
+static status remove_city(Overlay * o, int u){
+    Graph * g = o->g;
+    Roads * r = own_roads(o, u);
+    if (!r) return ERRALLOC;
+    g->nEdges -= r->n;
+    r->n = 0;
+    o->removed[u] = 1;
+    o->nRemoved++;
+    if (u >= o->nBase){
+        int at = 0;
+        while (o->byName[at] != u - o->nBase) at++;
+        memmove(o->byName + at, o->byName + at + 1, (o->nNamed - at - 1) * sizeof(int));
+        o->nNamed--;
+    }
+    drop_spatial(g);
+    route(o);
+    return OK;
+}
+
+
+/*************************************************************
+ * private function applying one line of a delta file
+ * @param relabel (out) set if components may have merged
+ * @return ERRUNABLE if the line is not a change
+ * @return ERRABSENT if a city of it does not exist, or the road to remove or set
+ * @return ERREXIST if the city or road to add exists
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ *************************************************************/
+static status apply_line(Overlay * o, char * line, int * relabel){
+    Graph * g = o->g;
+    char op[8], kind[8], a[20], b[20];
+    int x = 0, y = 0;
+    int n = sscanf(line, "%7s %7s %19s %19s %d", op, kind, a, b, &x);
+    if (n < 3) return ERRUNABLE;
+    int isAdd = strcmp(op, "add") == 0, isRemove = strcmp(op, "remove") == 0, isSet = strcmp(op, "set") == 0;
+
+    if (strcmp(kind, "city") == 0){
+        if (isAdd){
+            if (sscanf(line, "%*s %*s %19s %d %d", a, &x, &y) != 3) return ERRUNABLE;
+            return find_node(g, a) >= 0 ? ERREXIST : add_city(o, a, x, y);
+        }
+        if (!isRemove || n != 3) return ERRUNABLE;
+        int u = find_node(g, a);
+        return u < 0 ? ERRABSENT : remove_city(o, u);
+    }
+
+    if (strcmp(kind, "road") != 0 || !(isAdd || isRemove || isSet) || n != (isRemove ? 4 : 5) || x < 0)
+        return ERRUNABLE;
+    int u = find_node(g, a), v = find_node(g, b);
+    if (u < 0 || v < 0) return ERRABSENT;
+    Roads * r = own_roads(o, u);
+    if (!r) return ERRALLOC;
+    int i = road_at(o, r, v);
+    if (isAdd){
+        if (i >= 0) return ERREXIST;
+        if (r->n == r->cap){
+            int * adj = (int *) realloc(r->adj, 2 * r->cap * sizeof(int));
+            if (adj) r->adj = adj;
+            int * dist = (int *) realloc(r->dist, 2 * r->cap * sizeof(int));
+            if (dist) r->dist = dist;
+            if (!adj || !dist) return ERRALLOC;
+            r->cap *= 2;
+        }
+        r->adj[r->n] = v;
+        r->dist[r->n] = x;
+        r->n++;
+        g->nEdges++;
+        if (r->n > g->maxDegree) g->maxDegree = r->n;
+        if (g->component[u] != g->component[v]) *relabel = 1;
+        keep_consistent(g, u, v, x);
+        return OK;
+    }
+    if (i < 0) return ERRABSENT;
+    if (isSet){
+        r->dist[i] = x;
+        keep_consistent(g, u, v, x);
+        return OK;
+    }
+    r->n--;
+    r->adj[i] = r->adj[r->n];
+    r->dist[i] = r->dist[r->n];
+    g->nEdges--;
+    return OK;
+}
+
+
+/*************************************************************
+ * Apply the changes of a delta file to an overlay, in order. The scale
+ * of the estimate is lowered, for every node, if a new road is shorter
+ * than it, so it stays consistent; components are labelled again if roads
+ * joined some.
+ * Removing roads may split components, which are then labelled again by
+ * the next compaction only (a component too large costs searches, it
+ * does not make them wrong). The overlay is compacted when it holds the
+ * roads of more than 1/COMPACT_RATIO of the nodes.
+ * @param g the overlay, see newOverlay
+ * @param filepath the delta file
+ * @param line (out) the line of the change that failed, 0 if none did
+ * @return ERROPEN if the file cannot be opened
+ * @return ERRUNABLE if g is not an overlay or a line is not a change
+ * @return ERRABSENT, ERREXIST as a change cannot be made (see apply_line)
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise; after an error the changes before it are kept
+ *************************************************************/
+status apply_delta(Graph * g, char * filepath, int * line){
+    Overlay * o = overlay_of(g);
+    *line = 0;
+    if (!o) return ERRUNABLE;
+    FILE * f = fopen(filepath, "r");
+    if (!f) return ERROPEN;
+
+    char buf[256];
+    int lineNo = 0, relabel = 0, removed = o->nRemoved;
+    status res = OK;
+    while (res == OK && fgets(buf, sizeof buf, f)){
+        lineNo++;
+        char * s = buf + strspn(buf, " \t");
+        if (*s == '#' || *s == '\n' || *s == '\0') continue;
+        res = apply_line(o, s, &relabel);
+    }
+    fclose(f);
+    if (res != OK) *line = lineNo;
+
+    /* roads to the cities removed are gone too: count the roads again */
+    if (o->nRemoved != removed){
+        int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+        int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+        if (adjBuf && distBuf){
+            const int * adj, * dist;
+            g->nEdges = 0;
+            for (int u = 0; u < g->nCities; u++) g->nEdges += graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        }
+        free(adjBuf);
+        free(distBuf);
+    }
+    if (relabel && label_components(g) < 0 && res == OK) res = ERRALLOC;
+    if (o->nChanged > g->nCities / COMPACT_RATIO && compact_overlay(g) != OK && res == OK) res = ERRALLOC;
+    return res;
+}
+
+
+/** private comparison of nodes by name, for qsort **/
+static char (*sort_names)[20];
+static int compName(const void * a, const void * b){
+    return strcmp(sort_names[*(const int *)a], sort_names[*(const int *)b]);
+}
+
+
+/*************************************************************
+ * Merge the overlay into a new base graph in arrays, with the names of
+ * its cities (cities removed stay as nodes without roads nor name, so no
+ * index changes). The overlay then holds no change and reads the arrays
+ * of the new base directly; the old base is destroyed if it was owned.
+ * The new base is a private copy, whatever the old one was: a shared,
+ * compressed or tiled base is no longer used, nor its memory saved.
+ * @param g the overlay
+ * @return ERRUNABLE if g is not an overlay
+ * @return ERRALLOC if memory allocation failed (the overlay is unchanged)
+ * @return OK otherwise
+ *************************************************************/
+status compact_overlay(Graph * g){
+    Overlay * o = overlay_of(g);
+    if (!o) return ERRUNABLE;
+    int n = g->nCities;
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    Graph * b = (Graph *) calloc(1, sizeof(Graph));
+    Compacted * c = (Compacted *) calloc(1, sizeof(Compacted));
+    GraphStore * store = (GraphStore *) malloc(sizeof(GraphStore));
+    if (b){
+        b->nodeRoom = n + 1;
+        b->edgeRoom = g->nEdges + 1;
+        b->first = (int *) mem_alloc(MEM_GRAPH, (b->nodeRoom + 1) * sizeof(int));
+        b->adj = (int *) mem_alloc(MEM_GRAPH, b->edgeRoom * sizeof(int));
+        b->dist = (int *) mem_alloc(MEM_GRAPH, b->edgeRoom * sizeof(int));
+        b->lat = (int *) mem_alloc(MEM_GRAPH, b->nodeRoom * sizeof(int));
+        b->lgt = (int *) mem_alloc(MEM_GRAPH, b->nodeRoom * sizeof(int));
+        b->component = (int *) mem_alloc(MEM_GRAPH, b->nodeRoom * sizeof(int));
+    }
+    if (c){
+        c->names = (char (*)[20]) malloc((n + 1) * 20);
+        c->removed = (char *) malloc(n + 1);
+        c->byName = (int *) malloc((n + 1) * sizeof(int));
+    }
+    if (!adjBuf || !distBuf || !b || !c || !store || !b->first || !b->adj || !b->dist || !b->lat
+        || !b->lgt || !b->component || !c->names || !c->removed || !c->byName){
+        free(adjBuf);
+        free(distBuf);
+        delGraph(b);
+        if (c) delCompacted(c);
+        free(store);
+        return ERRALLOC;
+    }
+
+    /* roads, names and coordinates of the merged view */
+    int e = 0;
+    for (int u = 0; u < n; u++){
+        const int * adj, * dist;
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        b->first[u] = e;
+        memcpy(b->adj + e, adj, degree * sizeof(int));
+        memcpy(b->dist + e, dist, degree * sizeof(int));
+        e += degree;
+        if (degree > b->maxDegree) b->maxDegree = degree;
+        overlay_name(o, u, c->names[u]);
+        c->removed[u] = !overlay_live(o, u);
+        if (!c->removed[u]) c->byName[c->nNamed++] = u;
+    }
+    b->first[n] = e;
+    free(adjBuf);
+    free(distBuf);
+    sort_names = c->names;
+    qsort(c->byName, c->nNamed, sizeof(int), compName);
+    memcpy(b->lat, g->lat, n * sizeof(int));
+    memcpy(b->lgt, g->lgt, n * sizeof(int));
+    b->nCities = n;
+    b->nEdges = e;
+    b->hMetric = g->hMetric;
+    b->hScale = g->hScale;
+    store->roads = NULL;
+    store->name = compacted_name;
+    store->find = compacted_find;
+    store->live = compacted_live;
+    store->del = delCompacted;
+    store->data = c;
+    b->store = store;
+    if (label_components(b) < 0){
+        delGraph(b);
+        return ERRALLOC;
+    }
+
+    /* the overlay starts again from the new base */
+    for (int u = 0; u < n; u++){
+        free(o->roads[u].adj);
+        free(o->roads[u].dist);
+    }
+    memset(o->roads, 0, o->cap * sizeof(Roads));
+    memset(o->removed, 0, o->cap);
+    if (o->ownBase) delGraph(o->base);
+    free(o->baseByName);
+    o->baseByName = NULL;
+    o->base = b;
+    o->ownBase = 1;
+    o->nBase = n;
+    o->nRemoved = 0;
+    o->nNamed = 0;
+    o->nChanged = 0;
+    memcpy(g->component, b->component, n * sizeof(int));
+    g->nComponents = b->nComponents;
+    g->nEdges = e;
+    route(o);
+    return OK;
+}
@@ -0,0 +1,26 @@
+//
+//  Delta.h
+//  Astar
+//
+//  Changes to a loaded map (cities and roads added, removed or reweighted)
+//  held in an overlay over the base graph, which stays untouched.
+//
+
+#ifndef Delta_h
+#define Delta_h
+
+#include "Graph.h"
+
+/** Create an overlay over a base graph, destroyed with it if owned is set **/
+Graph * newOverlay(Graph *, int);
+
+/** Apply the changes of a delta file to an overlay **/
+status apply_delta(Graph *, char *, int *);
+
+/** Number of nodes whose roads are held by the overlay rather than the base **/
+int overlay_changes(Graph *);
+
+/** Merge the overlay into a new base graph **/
+status compact_overlay(Graph *);
+
+#endif /* Delta_h */
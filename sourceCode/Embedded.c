@@ -0,0 +1,181 @@
+//
+//  Embedded.c
+//  Astar
+//
+//  Map compiled into the program.
+//
+//  write_embedded prints a graph as C source: one static const array per
+//  array of the graph, the names as a table of char[20] with the nodes
+//  sorted by name, and the calibrated estimate, gathered in an EmbeddedMap
+//  named embedded_map. Compiled in, the arrays sit in the read-only data
+//  of the program: embedded_graph only points a graph at them, so the
+//  first query runs without reading a file or allocating the map.
+//
+
+#include <string.h>
+#include "Embedded.h"
+
+/** Graph of an embedded map, to clear its arrays before delGraph frees them **/
+typedef struct Embedding{
+    const EmbeddedMap * map;
+    Graph * g;
+}Embedding;
+
+
+/** decoding function of the name of a node, see GraphStore **/
+static void embedded_name(void * data, int u, char * buf){
+    memcpy(buf, ((Embedding *)data)->map->names[u], 20);
+}
+
+/** lookup function of a node by its name, see GraphStore **/
+static int embedded_find(void * data, char * name){
+    const EmbeddedMap * map = ((Embedding *)data)->map;
+    return find_sorted_name(map->names, map->byName, map->nCities, name);
+}
+
+/** release function of the graph: the arrays are not the graph's to free **/
+static void delEmbedding(void * data){
+    Graph * g = ((Embedding *)data)->g;
+    g->first = g->adj = g->dist = g->lat = g->lgt = g->component = NULL;
+    free(data);
+}
+
+
+/*************************************************************
+ * Build a graph searching an embedded map in place. The arrays are
+ * read-only: the graph cannot be renumbered nor given arc-flags.
+ * @param map the embedded map
+ * @return the graph, with the estimate computed when the map was embedded
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Graph * embedded_graph(const EmbeddedMap * map){
+    Graph * g = (Graph *) calloc(1, sizeof(Graph));
+    GraphStore * store = (GraphStore *) malloc(sizeof(GraphStore));
+    Embedding * e = (Embedding *) malloc(sizeof(Embedding));
+    if (!g || !store || !e){
+        free(g);
+        free(store);
+        free(e);
+        return NULL;
+    }
+    e->map = map;
+    e->g = g;
+    store->roads = NULL;
+    store->name = embedded_name;
+    store->find = embedded_find;
+    store->live = NULL;
+    store->del = delEmbedding;
+    store->data = e;
+    g->store = store;
+    g->nCities = map->nCities;
+    g->nEdges = map->nEdges;
+    g->nComponents = map->nComponents;
+    g->maxDegree = map->maxDegree;
+    g->hMetric = map->hMetric;
+    g->hScale = map->hScale;
+    g->first = (int *)map->first;
+    g->adj = (int *)map->adj;
+    g->dist = (int *)map->dist;
+    g->lat = (int *)map->lat;
+    g->lgt = (int *)map->lgt;
+    g->component = (int *)map->component;
+    return g;
+}
+
+
+/** private function printing an array of ints as a static const array definition **/
+static void put_array(FILE * f, char * name, const int * a, int n){
+    fprintf(f, "\nstatic const int %s[%d] = {", name, n + 1);
+    for (int i = 0; i < n; i++) fprintf(f, "%s%d,", i % 16 ? "" : "\n    ", a[i]);
+    fprintf(f, "%s0\n};\n", n % 16 ? "" : "\n    ");
+}
+
+
+/** private function printing a string as a C string literal **/
+static void put_string(FILE * f, const char * str){
+    fputc('"', f);
+    for (; *str; str++){
+        if (*str == '"' || *str == '\\') fputc('\\', f);
+        fputc(*str, f);
+    }
+    fputc('"', f);
+}
+
+
+/** private comparison of two nodes by name, for write_embedded **/
+static Graph * sorted_graph;
+static int compNodeName(const void * a, const void * b){
+    char x[20], y[20];
+    return strcmp(city_name(sorted_graph, *(const int *)a, x), city_name(sorted_graph, *(const int *)b, y));
+}
+
+
+/*************************************************************
+ * Write a graph as the C source of an embedded map named embedded_map,
+ * with the estimate the graph has (calibrate it first)
+ * @param g the graph (plain or stored)
+ * @param source name of the map it was read from, kept in the map
+ * @param f the file to write
+ * @return ERRALLOC if memory allocation failed
+ * @return ERRCLOSE if writing failed
+ * @return OK otherwise
+ *************************************************************/
+status write_embedded(Graph * g, char * source, FILE * f){
+    int n = g->nCities;
+    int * first = (int *) malloc((n + 1) * sizeof(int));
+    int * adj = (int *) malloc((g->nEdges + 1) * sizeof(int));
+    int * dist = (int *) malloc((g->nEdges + 1) * sizeof(int));
+    int * byName = (int *) malloc((n + 1) * sizeof(int));
+    if (!first || !adj || !dist || !byName){
+        free(first);
+        free(adj);
+        free(dist);
+        free(byName);
+        return ERRALLOC;
+    }
+    
+    /* the roads are decoded into the arrays, so stored graphs can be embedded too */
+    int e = 0;
+    for (int u = 0; u < n; u++){
+        const int * a, * d;
+        first[u] = e;
+        int degree = graph_roads(g, u, adj + e, dist + e, &a, &d);
+        memmove(adj + e, a, degree * sizeof(int));
+        memmove(dist + e, d, degree * sizeof(int));
+        e += degree;
+        byName[u] = u;
+    }
+    first[n] = e;
+    sorted_graph = g;
+    qsort(byName, n, sizeof(int), compNodeName);
+    
+    char * metrics[] = {"METRIC_MANHATTAN", "METRIC_EUCLIDEAN", "METRIC_GREAT_CIRCLE"};
+    fprintf(f, "//\n//  EmbeddedMap.c\n//  Astar\n//\n//  Generated by embedmap from %s: do not edit.\n//\n\n"
+            "#include \"Embedded.h\"\n", source);
+    put_array(f, "first", first, n + 1);
+    put_array(f, "adj", adj, e);
+    put_array(f, "dist", dist, e);
+    put_array(f, "lat", g->lat, n);
+    put_array(f, "lgt", g->lgt, n);
+    put_array(f, "component", g->component, n);
+    put_array(f, "byName", byName, n);
+    fprintf(f, "\nstatic const char names[%d][20] = {", n + 1);
+    for (int u = 0; u < n; u++){
+        char buf[20];
+        fputs("\n    ", f);
+        put_string(f, city_name(g, u, buf));
+        fputc(',', f);
+    }
+    fprintf(f, "\n    \"\"\n};\n");
+    fputs("\nconst EmbeddedMap embedded_map = {\n    ", f);
+    put_string(f, source);
+    fprintf(f, ", %d, %d, %d, %d, %s, %.17g,\n"
+            "    first, adj, dist, lat, lgt, component, names, byName\n};\n",
+            n, e, g->nComponents, g->maxDegree, metrics[g->hMetric], g->hScale);
+    
+    free(first);
+    free(adj);
+    free(dist);
+    free(byName);
+    return ferror(f) ? ERRCLOSE : OK;
+}
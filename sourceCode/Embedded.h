@@ -0,0 +1,43 @@
+//
+//  Embedded.h
+//  Astar
+//
+//  Map compiled into the program: the arrays of the graph as static
+//  const data, generated by embedmap, searched without any loading.
+//
+
+#ifndef Embedded_h
+#define Embedded_h
+
+#include <stdio.h>
+#include "Graph.h"
+
+/** Arrays of a graph in read-only data, names sorted through byName **/
+typedef struct EmbeddedMap{
+    const char * source;
+    int nCities;
+    int nEdges;
+    int nComponents;
+    int maxDegree;
+    metric hMetric;
+    double hScale;
+    const int * first;
+    const int * adj;
+    const int * dist;
+    const int * lat;
+    const int * lgt;
+    const int * component;
+    const char (*names)[20];
+    const int * byName;
+}EmbeddedMap;
+
+/** The map built into the program (EmbeddedMap.c, made by embedmap) **/
+extern const EmbeddedMap embedded_map;
+
+/** Graph searching an embedded map in place **/
+Graph * embedded_graph(const EmbeddedMap *);
+
+/** Write a graph as the C source of an embedded map **/
+status write_embedded(Graph *, char *, FILE *);
+
+#endif /* Embedded_h */
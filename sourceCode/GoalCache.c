@@ -0,0 +1,246 @@
+//
+//  GoalCache.c
+//  Astar
+//
+//  Exact estimates toward hot goals.
+//
+//  Every query toward a goal is counted; at the hotAfter-th one, a slot of
+//  the cache is taken (a free one, or the tree of the goal used least
+//  recently that no search holds) and the distance from every city to the
+//  goal is computed by Dijkstra from the goal over the reversed roads,
+//  outside the lock, by the search that asked for it. Other searches
+//  toward that goal use the coordinate estimate until the tree is ready.
+//  The distances are an exact, hence consistent, estimate: A* then only
+//  expands the cities lying on shortest paths to the goal, and never a
+//  city from which the goal cannot be reached.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "GoalCache.h"
+#include "Search.h"
+#include "Sssp.h"
+#include "Memory.h"
+
+
+/** private function building the graph of the reversed roads of a graph **/
+static Graph * reverse_graph(Graph * g){
+    int n = g->nCities, m = g->nEdges;
+    Graph * r = (Graph *) calloc(1, sizeof(Graph));
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    if (r){
+        r->nodeRoom = n + 1;
+        r->edgeRoom = m + 1;
+        r->first = (int *) mem_calloc(MEM_GRAPH, r->nodeRoom + 1, sizeof(int));
+        r->adj = (int *) mem_alloc(MEM_GRAPH, r->edgeRoom * sizeof(int));
+        r->dist = (int *) mem_alloc(MEM_GRAPH, r->edgeRoom * sizeof(int));
+    }
+    if (!r || !adjBuf || !distBuf || !r->first || !r->adj || !r->dist){
+        delGraph(r);
+        free(adjBuf);
+        free(distBuf);
+        return NULL;
+    }
+    r->nCities = n;
+    r->nEdges = m;
+
+    /* count the roads entering every node, then place them */
+    const int * adj, * dist;
+    for (int u = 0; u < n; u++){
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        for (int i = 0; i < degree; i++) r->first[adj[i] + 2]++;
+    }
+    for (int v = 0; v < n; v++){
+        if (r->first[v + 2] > r->maxDegree) r->maxDegree = r->first[v + 2];
+        r->first[v + 2] += r->first[v + 1];
+    }
+    for (int u = 0; u < n; u++){
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        for (int i = 0; i < degree; i++){
+            int k = r->first[adj[i] + 1]++;
+            r->adj[k] = u;
+            r->dist[k] = dist[i];
+        }
+    }
+    free(adjBuf);
+    free(distBuf);
+    return r;
+}
+
+
+/*************************************************************
+ * Create the goal cache of a graph
+ * @param g the graph, which must not change while the cache is used
+ * @param maxBytes bytes of distances the cache may hold (at least one goal
+ *        is held: a graph of n cities takes 4 (n + 1) bytes per goal)
+ * @param hotAfter number of queries toward a goal after which its
+ *        distances are computed, 0 for GOAL_HOT
+ * @return the cache, to destroy with delGoalCache
+ * @return NULL if memory allocation failed
+ *************************************************************/
+GoalCache * newGoalCache(Graph * g, size_t maxBytes, int hotAfter){
+    GoalCache * c = (GoalCache *) calloc(1, sizeof(GoalCache));
+    if (!c) return NULL;
+    int n = g->nCities;
+    size_t perGoal = (n + 1) * sizeof(int);
+    c->g = g;
+    c->hotAfter = hotAfter > 0 ? hotAfter : GOAL_HOT;
+    size_t fit = maxBytes / perGoal;
+    c->capacity = fit > (size_t)n ? n : (int)fit;
+    if (c->capacity < 1) c->capacity = 1;
+    c->reverse = reverse_graph(g);
+    c->count = (int *) calloc(n + 1, sizeof(int));
+    c->slotOf = (int *) malloc((n + 1) * sizeof(int));
+    c->slots = (GoalTree *) calloc(c->capacity, sizeof(GoalTree));
+    if (!c->reverse || !c->count || !c->slotOf || !c->slots || pthread_mutex_init(&c->lock, NULL) != 0){
+        delGraph(c->reverse);
+        free(c->count);
+        free(c->slotOf);
+        free(c->slots);
+        free(c);
+        return NULL;
+    }
+    for (int u = 0; u < n; u++) c->slotOf[u] = -1;
+    c->stats.capacity = c->capacity;
+    return c;
+}
+
+
+/*************************************************************
+ * Destroy a goal cache, once no search uses it any more
+ * @param c the cache, or NULL
+ *************************************************************/
+void delGoalCache(GoalCache * c){
+    if (!c) return;
+    size_t perGoal = (c->g->nCities + 1) * sizeof(int);
+    for (int s = 0; s < c->nSlots; s++) mem_free(MEM_CACHES, c->slots[s].toGoal, perGoal);
+    delGraph(c->reverse);
+    free(c->count);
+    free(c->slotOf);
+    free(c->slots);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+
+/** private function choosing the slot of a new goal, under lock: a slot
+ * never used, else an empty one or the least recently used tree that no
+ * search holds; -1 if every tree is held **/
+static int take_slot(GoalCache * c){
+    if (c->nSlots < c->capacity){
+        c->slots[c->nSlots].toGoal = NULL;
+        return c->nSlots++;
+    }
+    int s = -1;
+    for (int i = 0; i < c->nSlots; i++){
+        GoalTree * t = &c->slots[i];
+        if (t->refs > 0) continue;
+        if (t->goal < 0) return i;
+        if (s < 0 || t->used < c->slots[s].used) s = i;
+    }
+    if (s >= 0){
+        /* the goal evicted has to become hot again */
+        c->slotOf[c->slots[s].goal] = -1;
+        c->count[c->slots[s].goal] = 0;
+        c->stats.evictions++;
+    }
+    return s;
+}
+
+
+/*************************************************************
+ * Count a query toward a goal and return the distance from every node to
+ * it if the goal is hot: from the cache, or computed now (by the calling
+ * thread, the other ones going on without it meanwhile)
+ * @param c the cache
+ * @param goal the goal of the query
+ * @return the distances (UNREACHED where the goal cannot be reached),
+ *         to give back with goal_cache_release
+ * @return NULL if the goal is not hot, its distances are being computed
+ *         or memory allocation failed
+ *************************************************************/
+const int * goal_cache_acquire(GoalCache * c, int goal){
+    pthread_mutex_lock(&c->lock);
+    c->stats.lookups++;
+    int s = c->slotOf[goal];
+    if (s >= 0){
+        GoalTree * t = &c->slots[s];
+        const int * toGoal = NULL;
+        if (t->ready){
+            t->refs++;
+            t->used = ++c->clock;
+            c->stats.hits++;
+            toGoal = t->toGoal;
+        }
+        pthread_mutex_unlock(&c->lock);
+        return toGoal;
+    }
+    if (++c->count[goal] < c->hotAfter || (s = take_slot(c)) < 0){
+        pthread_mutex_unlock(&c->lock);
+        return NULL;
+    }
+    GoalTree * t = &c->slots[s];
+    t->goal = goal;
+    t->ready = 0;
+    t->refs = 1;
+    t->used = ++c->clock;
+    c->slotOf[goal] = s;
+    int * toGoal = t->toGoal;
+    pthread_mutex_unlock(&c->lock);
+
+    /* the tree of the goal, outside the lock (the slot is held) */
+    int n = c->g->nCities;
+    if (!toGoal) toGoal = (int *) mem_alloc(MEM_CACHES, (n + 1) * sizeof(int));
+    int * parent = (int *) malloc((n + 1) * sizeof(int));
+    double t0 = search_clock();
+    status res = toGoal && parent ? dijkstra(c->reverse, goal, toGoal, parent) : ERRALLOC;
+    double seconds = search_clock() - t0;
+    free(parent);
+
+    pthread_mutex_lock(&c->lock);
+    t->toGoal = toGoal;
+    if (res == OK){
+        t->ready = 1;
+        c->stats.builds++;
+        c->stats.buildSeconds += seconds;
+    }
+    else {
+        t->goal = -1;
+        t->refs = 0;
+        c->slotOf[goal] = -1;
+        toGoal = NULL;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return toGoal;
+}
+
+
+/*************************************************************
+ * Give back the distances to a goal returned by goal_cache_acquire: the
+ * goal may be evicted once no search holds it
+ * @param c the cache
+ * @param goal the goal
+ *************************************************************/
+void goal_cache_release(GoalCache * c, int goal){
+    pthread_mutex_lock(&c->lock);
+    int s = c->slotOf[goal];
+    if (s >= 0 && c->slots[s].refs > 0) c->slots[s].refs--;
+    pthread_mutex_unlock(&c->lock);
+}
+
+
+/*************************************************************
+ * Occupancy and counters of a goal cache
+ * @param c the cache
+ * @param st (out) goals held (capacity, bytes), lookups, hits (lookups
+ *        answered with distances), trees built (and their time), evictions
+ *************************************************************/
+void goal_cache_stats(GoalCache * c, GoalCacheStats * st){
+    pthread_mutex_lock(&c->lock);
+    *st = c->stats;
+    st->held = 0;
+    for (int s = 0; s < c->nSlots; s++) st->held += c->slots[s].ready;
+    st->bytes = (size_t)st->held * (c->g->nCities + 1) * sizeof(int);
+    pthread_mutex_unlock(&c->lock);
+}
@@ -0,0 +1,77 @@
+//
+//  GoalCache.h
+//  Astar
+//
+//  Exact estimates for hot goals: once enough queries have asked for the
+//  same goal, the distance from every city to it is computed by a backward
+//  Dijkstra and kept in a cache of bounded size, and the searches toward
+//  that goal use it in place of the coordinate estimate.
+//
+
+#ifndef GoalCache_h
+#define GoalCache_h
+
+#include <stddef.h>
+#include <pthread.h>
+#include "Graph.h"
+
+/** queries toward a goal after which it is hot, unless given to newGoalCache **/
+#define GOAL_HOT 4
+
+/** A goal of the cache: toGoal[u] is the distance from u to goal (UNREACHED if
+ * none), valid once ready; refs counts the searches using it **/
+typedef struct GoalTree{
+    int goal;
+    int * toGoal;
+    int ready;
+    int refs;
+    unsigned long used;
+}GoalTree;
+
+/** What the cache did, see goal_cache_stats **/
+typedef struct GoalCacheStats{
+    int held;
+    int capacity;
+    size_t bytes;
+    long lookups;
+    long hits;
+    long builds;
+    long evictions;
+    double buildSeconds;
+}GoalCacheStats;
+
+/** GoalCache structure: the queries counted per goal, and the trees of at
+ * most capacity goals, evicted least recently used first. Shared by the
+ * searches of several threads (under lock); the graph must not change. **/
+typedef struct GoalCache{
+    Graph * g;
+    Graph * reverse;
+    int hotAfter;
+    int * count;
+    int * slotOf;
+    GoalTree * slots;
+    int capacity;
+    int nSlots;
+    unsigned long clock;
+    GoalCacheStats stats;
+    pthread_mutex_t lock;
+}GoalCache;
+
+/** Create the cache of a graph holding at most the given bytes of trees,
+ * a goal being hot after the given number of queries (0 for GOAL_HOT) **/
+GoalCache * newGoalCache(Graph *, size_t, int);
+
+/** Destroy a cache, once no search uses it **/
+void delGoalCache(GoalCache *);
+
+/** Count a query toward a goal and return the distances to it if the goal is
+ * hot (building them if needed), NULL otherwise; to release after use **/
+const int * goal_cache_acquire(GoalCache *, int);
+
+/** Release the distances to a goal returned by goal_cache_acquire **/
+void goal_cache_release(GoalCache *, int);
+
+/** Occupancy and counters of a cache **/
+void goal_cache_stats(GoalCache *, GoalCacheStats *);
+
+#endif /* GoalCache_h */
@@ -0,0 +1,265 @@
+//
+//  Graph.c
+//  Astar
+//
+//  Compact array view of the map read by map_to_list: cities are numbered
+//  by their id and neighbours are stored as contiguous edge ranges.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "Graph.h"
+#include "Spatial.h"
+
+
+/*************************************************************
+ * Build the array view of a list of cities
+ * @param all_cities list of cities returned by map_to_list (ids assigned)
+ * @return the graph, with its components already labelled
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Graph * list_to_graph(List * all_cities){
+    Graph * g = (Graph *) calloc(1, sizeof(Graph));
+    if (!g) return NULL;
+    int n = lengthList(all_cities);
+    
+    /* count the edges first, so the edge arrays are allocated once */
+    int m = 0;
+    for (Node * cur = all_cities->head; cur; cur = cur->next)
+        m += lengthList(((City *)cur->val)->neighbours);
+    
+    g->nCities = n;
+    g->nEdges = m;
+    g->hMetric = METRIC_MANHATTAN;
+    g->hScale = DEFAULT_H_SCALE;
+    g->nodeRoom = n + 1;
+    g->edgeRoom = m + 1;
+    g->cities = (City **) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(City *));
+    g->first = (int *) mem_alloc(MEM_GRAPH, (g->nodeRoom + 1) * sizeof(int));
+    g->adj = (int *) mem_alloc(MEM_GRAPH, g->edgeRoom * sizeof(int));
+    g->dist = (int *) mem_alloc(MEM_GRAPH, g->edgeRoom * sizeof(int));
+    g->lat = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+    g->lgt = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+    g->component = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+    if (!g->cities || !g->first || !g->adj || !g->dist || !g->lat || !g->lgt || !g->component){
+        delGraph(g);
+        return NULL;
+    }
+    
+    int e = 0;
+    for (Node * cur = all_cities->head; cur; cur = cur->next){
+        City * c = (City *)cur->val;
+        g->cities[c->id] = c;
+        g->lat[c->id] = c->lat;
+        g->lgt[c->id] = c->lgt;
+        g->first[c->id] = e;
+        if (lengthList(c->neighbours) > g->maxDegree) g->maxDegree = lengthList(c->neighbours);
+        for (Node * nb = c->neighbours->head; nb; nb = nb->next){
+            g->adj[e] = ((neighbour *)nb->val)->city->id;
+            g->dist[e] = ((neighbour *)nb->val)->distance;
+            e++;
+        }
+    }
+    g->first[n] = e;
+    
+    label_components(g);
+    return g;
+}
+
+
+/*************************************************************
+ * Destroy the array view of the graph, or any graph: the arrays it owns
+ * are given back by their room (see Graph.h)
+ * @param g the graph to destroy
+ *************************************************************/
+void delGraph(Graph * g){
+    if (!g) return;
+    if (g->store){
+        g->store->del(g->store->data);
+        free(g->store);
+    }
+    size_t nodes = g->nodeRoom * sizeof(int), edges = g->edgeRoom * sizeof(int);
+    mem_free(MEM_GRAPH, g->cities, g->nodeRoom * sizeof(City *));
+    mem_free(MEM_GRAPH, g->first, nodes + sizeof(int));
+    mem_free(MEM_GRAPH, g->adj, edges);
+    mem_free(MEM_GRAPH, g->dist, edges);
+    mem_free(MEM_GRAPH, g->lat, nodes);
+    mem_free(MEM_GRAPH, g->lgt, nodes);
+    mem_free(MEM_GRAPH, g->component, nodes);
+    delSpatial(g->spatial);
+    free(g);
+}
+
+
+/*************************************************************
+ * private function to find the representative of a node, halving
+ * the path on the way (union-find)
+ *************************************************************/
+static int root(int * parent, int u){
+    while (parent[u] != u){
+        parent[u] = parent[parent[u]];
+        u = parent[u];
+    }
+    return u;
+}
+
+
+/*************************************************************
+ * Label the weakly connected components of the graph (roads are
+ * considered in both directions). Two nodes with different labels
+ * can never be linked by a path, so such queries can be rejected
+ * without any search.
+ * @param g the graph, component[] is filled with labels 0 .. nComponents-1
+ * @return the number of components
+ * @return -1 if memory allocation failed
+ *************************************************************/
+int label_components(Graph * g){
+    int * parent = g->component;
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    const int * adj, * dist;
+    if (!adjBuf || !distBuf){
+        free(adjBuf);
+        free(distBuf);
+        return -1;
+    }
+    for (int u = 0; u < g->nCities; u++) parent[u] = u;
+    
+    for (int u = 0; u < g->nCities; u++){
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        for (int k = 0; k < degree; k++){
+            int a = root(parent, u);
+            int b = root(parent, adj[k]);
+            if (a != b) parent[a < b ? b : a] = a < b ? a : b;
+        }
+    }
+    free(adjBuf);
+    free(distBuf);
+    
+    /* roots have the smallest index of their set: relabel densely in one pass */
+    int count = 0;
+    for (int u = 0; u < g->nCities; u++){
+        if (parent[u] == u) parent[u] = -(++count);
+        else parent[u] = parent[parent[u]];
+    }
+    for (int u = 0; u < g->nCities; u++) parent[u] = -parent[u] - 1;
+    
+    g->nComponents = count;
+    return count;
+}
+
+
+/*************************************************************
+ * Distance between two nodes in the Euclidean metric of the coordinates,
+ * or in the great-circle metric, the coordinates being then read as
+ * hundredths of degrees of latitude and longitude (distance in km)
+ * @param g the graph
+ * @param m the metric
+ * @param u the first node
+ * @param v the second node
+ * @return the distance
+ *************************************************************/
+double graph_metric(const Graph * g, metric m, int u, int v){
+    double dLat = g->lat[u] - g->lat[v], dLgt = g->lgt[u] - g->lgt[v];
+    if (m == METRIC_MANHATTAN) return fabs(dLat) + fabs(dLgt);
+    if (m == METRIC_EUCLIDEAN) return sqrt(dLat * dLat + dLgt * dLgt);
+    
+    /* haversine formula */
+    const double rad = M_PI / 18000;
+    double a = sin(dLat * rad / 2), b = sin(dLgt * rad / 2);
+    double h = a * a + cos(g->lat[u] * rad) * cos(g->lat[v] * rad) * b * b;
+    return 2 * 6371.0 * asin(sqrt(h < 1 ? h : 1));
+}
+
+
+/*************************************************************
+ * Calibrate the estimate of a graph: over all roads, find the largest
+ * scale such that scale * metric never exceeds the length of a road.
+ * As the metric obeys the triangle inequality, the estimate is then
+ * consistent (so admissible) whatever the goal. The scale is lowered by
+ * a relative 1e-9 so rounding cannot break that.
+ * @param g the graph, every road of it is read
+ * @param m the metric
+ * @return ERRALLOC if memory allocation failed (the estimate is unchanged)
+ * @return OK otherwise
+ *************************************************************/
+status calibrate_h(Graph * g, metric m){
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    if (!adjBuf || !distBuf){
+        free(adjBuf);
+        free(distBuf);
+        return ERRALLOC;
+    }
+    
+    /* roads between cities at the same place bound nothing */
+    double scale = HUGE_VAL;
+    for (int u = 0; u < g->nCities; u++){
+        const int * adj, * dist;
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        for (int k = 0; k < degree; k++){
+            double d = graph_metric(g, m, u, adj[k]);
+            if (d > 0 && dist[k] / d < scale) scale = dist[k] / d;
+        }
+    }
+    free(adjBuf);
+    free(distBuf);
+    
+    g->hMetric = m;
+    g->hScale = scale == HUGE_VAL ? 0 : scale * (1 - 1e-9);
+    return OK;
+}
+
+
+/*************************************************************
+ * Find the node index of a city by its name
+ * @param g the graph
+ * @param name name of the city to be found
+ * @return -1 if city is not found
+ * @return index of the city otherwise
+ *************************************************************/
+int find_node(Graph * g, char * name){
+    if (g->store) return g->store->find(g->store->data, name);
+    for (int u = 0; u < g->nCities; u++)
+        if (strcmp(g->cities[u]->name, name) == 0) return u;
+    return -1;
+}
+
+
+/*************************************************************
+ * Find a node by its name in a table of names, by binary search
+ * @param names name of every node
+ * @param byName the nodes sorted by name
+ * @param n number of nodes
+ * @param name name of the city to be found
+ * @return -1 if city is not found
+ * @return index of the city otherwise
+ *************************************************************/
+int find_sorted_name(const char (*names)[20], const int * byName, int n, char * name){
+    int lo = 0, hi = n - 1;
+    while (lo <= hi){
+        int mid = (lo + hi) / 2;
+        int c = strcmp(names[byName[mid]], name);
+        if (c == 0) return byName[mid];
+        if (c < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+
+/*************************************************************
+ * Name of the city of a node
+ * @param g the graph
+ * @param u the node
+ * @param buf buffer the name is decoded into if the graph is stored
+ * @return the name (buf, or the name inside the City)
+ *************************************************************/
+char * city_name(Graph * g, int u, char buf[20]){
+    if (g->store){
+        g->store->name(g->store->data, u, buf);
+        return buf;
+    }
+    return g->cities[u]->name;
+}
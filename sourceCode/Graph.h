@@ -0,0 +1,123 @@
+//
+//  Graph.h
+//  Astar
+//
+//  Compact array view of the map read by map_to_list: cities are numbered
+//  by their id and neighbours are stored as contiguous edge ranges.
+//
+
+#ifndef Graph_h
+#define Graph_h
+
+#include <stdlib.h>
+#include "Map.h"
+#include "Memory.h"
+
+/** Storage of the roads and names of a graph other than plain arrays
+ * (e.g. compressed): decoding functions applied to the data pointer.
+ * roads is NULL if the roads are plain arrays (e.g. shared); live is NULL
+ * if every node is a city, else it tells the nodes of cities removed
+ * (see Delta.h) from the others **/
+typedef struct GraphStore{
+    int (*roads)(void *, int, int *, int *);
+    void (*name)(void *, int, char *);
+    int (*find)(void *, char *);
+    int (*live)(void *, int);
+    void (*del)(void *);
+    void * data;
+}GraphStore;
+
+/** Metrics the coordinate-based estimate can be computed with **/
+typedef enum{
+    METRIC_MANHATTAN,
+    METRIC_EUCLIDEAN,
+    METRIC_GREAT_CIRCLE
+}metric;
+
+/** scale of the Manhattan estimate of h_of_n, used until a graph is calibrated **/
+#define DEFAULT_H_SCALE 0.25
+
+/** Graph structure: adjacency of node u is adj/dist[first[u] .. first[u+1]-1].
+ * When store is set, cities is NULL and the names are decoded on demand
+ * through the store; so are the roads when adj is NULL (first and dist
+ * are then NULL too). A stored graph is read-only.
+ * When arcFlags is set (plain arrays only), searches prune with it.
+ * spatial is the index of the coordinates, built by find_place when needed.
+ * The arrays the graph owns are accounted as MEM_GRAPH: cities, lat, lgt and
+ * component have nodeRoom entries, first nodeRoom + 1, adj and dist edgeRoom.
+ * The estimate between two nodes is hScale times their distance in the
+ * given metric, see calibrate_h. **/
+typedef struct Graph{
+    int nCities;
+    int nEdges;
+    City ** cities;
+    int * first;
+    int * adj;
+    int * dist;
+    int * lat;
+    int * lgt;
+    int * component;
+    int nComponents;
+    int maxDegree;
+    GraphStore * store;
+    struct ArcFlags * arcFlags;
+    struct Spatial * spatial;
+    metric hMetric;
+    double hScale;
+    int nodeRoom;
+    int edgeRoom;
+}Graph;
+
+/** Test whether a node is a city, rather than what is left of a city removed **/
+static inline int graph_live(const Graph * g, int u){
+    return !g->store || !g->store->live || g->store->live(g->store->data, u);
+}
+
+/** Distance between two nodes in the Euclidean or great-circle metric **/
+double graph_metric(const Graph *, metric, int, int);
+
+/** Estimated distance between two nodes: with the default scale, the same
+ * estimate as h_of_n **/
+static inline int graph_h(const Graph * g, int u, int v){
+    if (g->hMetric == METRIC_MANHATTAN)
+        return (int)(g->hScale * (abs(g->lat[u] - g->lat[v]) + abs(g->lgt[u] - g->lgt[v])));
+    return (int)(g->hScale * graph_metric(g, g->hMetric, u, v));
+}
+
+/** Roads leaving node u: sets *adj and *dist to the targets and distances,
+ * decoding them into the given buffers (maxDegree ints) if the roads are stored,
+ * and returns their number **/
+static inline int graph_roads(const Graph * g, int u, int * adjBuf, int * distBuf,
+                              const int ** adj, const int ** dist){
+    if (!g->adj){
+        *adj = adjBuf;
+        *dist = distBuf;
+        return g->store->roads(g->store->data, u, adjBuf, distBuf);
+    }
+    *adj = g->adj + g->first[u];
+    *dist = g->dist + g->first[u];
+    return g->first[u+1] - g->first[u];
+}
+
+/** Build the array view of a list of cities returned by map_to_list **/
+Graph * list_to_graph(List *);
+
+/** Destroy the array view (the cities themselves are left untouched) **/
+void delGraph(Graph *);
+
+/** Label the (weakly) connected components of the graph **/
+int label_components(Graph *);
+
+/** Set the estimate of a graph to the tightest admissible scale of a metric **/
+status calibrate_h(Graph *, metric);
+
+/** Find the node index of a city by its name **/
+int find_node(Graph *, char *);
+
+/** Find a node by its name in a table of names sorted through an index **/
+int find_sorted_name(const char (*)[20], const int *, int, char *);
+
+/** Name of the city of a node **/
+char * city_name(Graph *, int, char[20]);
+
+#endif /* Graph_h */
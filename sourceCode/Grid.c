@@ -0,0 +1,509 @@
+//
+//  Grid.c
+//  Astar
+//
+//  Uniform-cost grid maps and their search.
+//
+//  Text files use the octile format of the grid benchmarks:
+//    type octile
+//    height H
+//    width W
+//    map
+//    H lines of W cells, '.' 'G' and 'S' are free, anything else is blocked
+//
+//  Packed files (native int sizes and byte order):
+//    "AGR1", width, height
+//    rows[(height+2) * rowWords]   (uint64) the framed occupancy bits
+//
+//  Moves go to the 8 neighbours of a cell; a diagonal move needs both cells
+//  it passes between to be free (no corner cutting). Jump Point Search
+//  only expands the cells where an optimal path may turn: from a cell it
+//  keeps moving in the same direction while every cell reached is also
+//  reached at least as cheaply by a path that does not go through it.
+//  Straight jumps test 64 cells at a time on the occupancy bits of the
+//  line and of its two neighbouring lines.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Grid.h"
+#include "Trace.h"
+
+static const char magic[4] = {'A', 'G', 'R', '1'};
+
+/** the 8 directions: straight ones first **/
+static const int DX[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int DY[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+
+/*************************************************************
+ * private function creating a grid whose cells are all blocked
+ * @param width number of columns
+ * @param height number of rows
+ * @return the grid
+ * @return NULL if memory allocation failed
+ *************************************************************/
+static Grid * new_grid(int width, int height){
+    Grid * g = (Grid *) calloc(1, sizeof(Grid));
+    if (!g) return NULL;
+    g->width = width;
+    g->height = height;
+    g->rowWords = (width + 2 + 63) / 64;
+    g->colWords = (height + 2 + 63) / 64;
+    size_t rowBytes = (size_t)(height + 2) * g->rowWords * sizeof(uint64_t);
+    size_t colBytes = (size_t)(width + 2) * g->colWords * sizeof(uint64_t);
+    g->rows = (uint64_t *) malloc(rowBytes);
+    g->cols = (uint64_t *) malloc(colBytes);
+    if (!g->rows || !g->cols){
+        delGrid(g);
+        return NULL;
+    }
+    memset(g->rows, 0xff, rowBytes);
+    memset(g->cols, 0xff, colBytes);
+    return g;
+}
+
+
+/** private function marking cell (x, y) as free in both bit arrays **/
+static void set_free(Grid * g, int x, int y){
+    g->rows[(size_t)(y + 1) * g->rowWords + ((x + 1) >> 6)] &= ~(1ULL << ((x + 1) & 63));
+    g->cols[(size_t)(x + 1) * g->colWords + ((y + 1) >> 6)] &= ~(1ULL << ((y + 1) & 63));
+    g->nFree++;
+}
+
+
+/*************************************************************
+ * Destroy a grid by deallocating used memory
+ * @param g the grid to destroy
+ *************************************************************/
+void delGrid(Grid * g){
+    if (!g) return;
+    free(g->rows);
+    free(g->cols);
+    free(g);
+}
+
+
+/** private function reading a grid in the octile text format **/
+static Grid * read_text(FILE * f){
+    int width = 0, height = 0;
+    char word[16];
+    if (fscanf(f, "type %15s height %d width %d map", word, &height, &width) != 3
+        || width < 1 || height < 1) return NULL;
+    Grid * g = new_grid(width, height);
+    if (!g) return NULL;
+
+    int c = getc(f);
+    for (int y = 0; y < height && c != EOF; y++){
+        while (c == '\n' || c == '\r') c = getc(f);
+        for (int x = 0; x < width && c != EOF && c != '\n'; x++, c = getc(f))
+            if (c == '.' || c == 'G' || c == 'S') set_free(g, x, y);
+        while (c != EOF && c != '\n') c = getc(f);
+    }
+    return g;
+}
+
+
+/** private function reading a grid in the packed format, after its magic **/
+static Grid * read_packed(FILE * f){
+    int size[2];
+    if (fread(size, sizeof(int), 2, f) != 2 || size[0] < 1 || size[1] < 1) return NULL;
+    Grid * g = new_grid(size[0], size[1]);
+    if (!g) return NULL;
+    size_t n = (size_t)(g->height + 2) * g->rowWords;
+    if (fread(g->rows, sizeof(uint64_t), n, f) != n){
+        delGrid(g);
+        return NULL;
+    }
+
+    /* the transposed bits are not stored: rebuild them from the rows */
+    for (int y = 0; y < g->height; y++)
+        for (int x = 0; x < g->width; x++)
+            if (!grid_blocked(g, x, y)){
+                g->cols[(size_t)(x + 1) * g->colWords + ((y + 1) >> 6)] &= ~(1ULL << ((y + 1) & 63));
+                g->nFree++;
+            }
+    return g;
+}
+
+
+/*************************************************************
+ * Read a grid from a file, either in the octile text format or packed
+ * @param filepath the file
+ * @return the grid
+ * @return NULL if the file cannot be read or is not a grid
+ *************************************************************/
+Grid * load_grid(char * filepath){
+    FILE * f = fopen(filepath, "rb");
+    if (!f) return NULL;
+    char m[4];
+    Grid * g = NULL;
+    if (fread(m, 1, 4, f) == 4){
+        if (memcmp(m, magic, 4) == 0) g = read_packed(f);
+        else {
+            rewind(f);
+            g = read_text(f);
+        }
+    }
+    fclose(f);
+    return g;
+}
+
+
+/*************************************************************
+ * Write a grid as a packed file: one bit per cell
+ * @param g the grid
+ * @param filepath the file to write
+ * @return ERROPEN if the file cannot be written
+ * @return OK otherwise
+ *************************************************************/
+status save_grid(Grid * g, char * filepath){
+    FILE * f = fopen(filepath, "wb");
+    if (!f) return ERROPEN;
+    int size[2] = {g->width, g->height};
+    size_t n = (size_t)(g->height + 2) * g->rowWords;
+    int ok = fwrite(magic, 1, 4, f) == 4 && fwrite(size, sizeof(int), 2, f) == 2
+        && fwrite(g->rows, sizeof(uint64_t), n, f) == n;
+    if (fclose(f) != 0 || !ok) return ERROPEN;
+    return OK;
+}
+
+
+/*************************************************************
+ * Test whether a file holds a grid, packed or as text
+ * @param filepath the file
+ * @return 1 if it does, 0 otherwise
+ *************************************************************/
+int is_grid(char * filepath){
+    FILE * f = fopen(filepath, "rb");
+    char m[4];
+    if (!f) return 0;
+    int res = fread(m, 1, 4, f) == 4 && (memcmp(m, magic, 4) == 0 || memcmp(m, "type", 4) == 0);
+    fclose(f);
+    return res;
+}
+
+
+/*************************************************************
+ * Find the node of a free cell
+ * @param g the grid
+ * @param cell the cell, written "x,y"
+ * @return the node, y * width + x
+ * @return -1 if cell is malformed, outside the grid or blocked
+ *************************************************************/
+int grid_node(Grid * g, char * cell){
+    int x, y;
+    char end;
+    if (sscanf(cell, "%d,%d%c", &x, &y, &end) != 2) return -1;
+    if (x < 0 || x >= g->width || y < 0 || y >= g->height || grid_blocked(g, x, y)) return -1;
+    return y * g->width + x;
+}
+
+
+/*************************************************************
+ * Estimated cost between two nodes: the octile distance, which is
+ * the exact cost on a grid without obstacles, the counterpart of h_of_n
+ * @param g the grid
+ * @param u the first node
+ * @param v the second node
+ * @return the estimated cost
+ *************************************************************/
+int grid_h(Grid * g, int u, int v){
+    int dx = abs(u % g->width - v % g->width);
+    int dy = abs(u / g->width - v / g->width);
+    return dx > dy ? GRID_STRAIGHT * dx + (GRID_DIAGONAL - GRID_STRAIGHT) * dy
+                   : GRID_STRAIGHT * dy + (GRID_DIAGONAL - GRID_STRAIGHT) * dx;
+}
+
+
+/*************************************************************
+ * Create a workspace for searches on the given grid
+ * @param g the grid
+ * @return the workspace
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Workspace * newGridWorkspace(Grid * g){
+    return newWorkspaceFor(g->width * g->height, 8);
+}
+
+
+/*************************************************************
+ * private function scanning a line of cells (a row or a column) from
+ * position p in direction dir, 64 positions at a time, for the first
+ * position that is blocked or that has a forced neighbour: a free cell
+ * on a side line whose predecessor on that side line is blocked
+ * @param line bits of the line
+ * @param a bits of the line on one side
+ * @param b bits of the line on the other side
+ * @param words number of words of each line
+ * @param p position to start from (not tested itself)
+ * @param dir 1 or -1
+ * @param blocked (out) 1 if the position found is blocked
+ * @return the position found, the frame of the grid ensures there is one
+ *************************************************************/
+static int scan(const uint64_t * line, const uint64_t * a, const uint64_t * b,
+                int words, int p, int dir, int * blocked){
+    int w = p >> 6, bit = p & 63;
+    if (dir > 0){
+        uint64_t mask = bit == 63 ? 0 : ~0ULL << (bit + 1);
+        for (;; w++, mask = ~0ULL){
+            uint64_t ca = w ? a[w-1] >> 63 : 0, cb = w ? b[w-1] >> 63 : 0;
+            uint64_t forced = (~a[w] & (a[w] << 1 | ca)) | (~b[w] & (b[w] << 1 | cb));
+            uint64_t stop = (line[w] | forced) & mask;
+            if (stop){
+                bit = __builtin_ctzll(stop);
+                *blocked = (int)(line[w] >> bit) & 1;
+                return (w << 6) + bit;
+            }
+        }
+    }
+    uint64_t mask = (1ULL << bit) - 1;
+    for (;; w--, mask = ~0ULL){
+        uint64_t ca = w + 1 < words ? a[w+1] << 63 : 0, cb = w + 1 < words ? b[w+1] << 63 : 0;
+        uint64_t forced = (~a[w] & (a[w] >> 1 | ca)) | (~b[w] & (b[w] >> 1 | cb));
+        uint64_t stop = (line[w] | forced) & mask;
+        if (stop){
+            bit = 63 - __builtin_clzll(stop);
+            *blocked = (int)(line[w] >> bit) & 1;
+            return (w << 6) + bit;
+        }
+    }
+}
+
+
+/*************************************************************
+ * private function jumping from (x, y) along a row (dy = 0) or a column
+ * (dx = 0)
+ * @return 1 if a jump point was found, stored in jump
+ * @return 0 if the jump ends on an obstacle
+ *************************************************************/
+static int jump_straight(Grid * g, int x, int y, int dx, int dy, int goal, int * jump){
+    int gx = goal % g->width, gy = goal / g->width, blocked, c;
+    if (dy == 0){
+        const uint64_t * r = g->rows + (size_t)(y + 1) * g->rowWords;
+        c = scan(r, r - g->rowWords, r + g->rowWords, g->rowWords, x + 1, dx, &blocked) - 1;
+        if (gy == y && (gx - x) * dx > 0 && (c - gx) * dx >= 0) *jump = goal;
+        else if (blocked) return 0;
+        else *jump = y * g->width + c;
+        return 1;
+    }
+    const uint64_t * col = g->cols + (size_t)(x + 1) * g->colWords;
+    c = scan(col, col - g->colWords, col + g->colWords, g->colWords, y + 1, dy, &blocked) - 1;
+    if (gx == x && (gy - y) * dy > 0 && (c - gy) * dy >= 0) *jump = goal;
+    else if (blocked) return 0;
+    else *jump = c * g->width + x;
+    return 1;
+}
+
+
+/*************************************************************
+ * private function jumping diagonally from (x, y): a cell is a jump point
+ * if it is the goal or if a straight jump from it finds one
+ * @return 1 if a jump point was found, stored in jump
+ * @return 0 if the jump ends on an obstacle
+ *************************************************************/
+static int jump_diagonal(Grid * g, int x, int y, int dx, int dy, int goal, int * jump){
+    int found;
+    while (!grid_blocked(g, x + dx, y) && !grid_blocked(g, x, y + dy) && !grid_blocked(g, x + dx, y + dy)){
+        x += dx;
+        y += dy;
+        if (y * g->width + x == goal || jump_straight(g, x, y, dx, 0, goal, &found)
+            || jump_straight(g, x, y, 0, dy, goal, &found)){
+            *jump = y * g->width + x;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/*************************************************************
+ * private function listing the successors of node n with their cost
+ * @param g the grid
+ * @param n the node
+ * @param parent the node n was reached from, -1 for the start
+ * @param goal the goal node
+ * @param jps 1 for the jump points, 0 for the 8 neighbours
+ * @param adj (out) the successors
+ * @param dist (out) the cost of reaching every successor from n
+ * @return the number of successors
+ *************************************************************/
+static int successors(Grid * g, int n, int parent, int goal, int jps, int * adj, int * dist){
+    int x = n % g->width, y = n / g->width, count = 0;
+
+    if (!jps){
+        for (int d = 0; d < 8; d++){
+            int nx = x + DX[d], ny = y + DY[d];
+            if (grid_blocked(g, nx, ny)) continue;
+            if (d >= 4 && (grid_blocked(g, nx, y) || grid_blocked(g, x, ny))) continue;
+            adj[count] = ny * g->width + nx;
+            dist[count++] = d < 4 ? GRID_STRAIGHT : GRID_DIAGONAL;
+        }
+        return count;
+    }
+
+    /* directions left once the symmetric moves are pruned: all of them from
+     * the start, on along a diagonal and its two components, and on along a
+     * line, sideways and diagonally forward after a straight move */
+    int ddx[8], ddy[8], nDirs = 0;
+    int dx = parent < 0 ? 0 : (x > parent % g->width) - (x < parent % g->width);
+    int dy = parent < 0 ? 0 : (y > parent / g->width) - (y < parent / g->width);
+    if (parent < 0)
+        for (nDirs = 0; nDirs < 8; nDirs++){
+            ddx[nDirs] = DX[nDirs];
+            ddy[nDirs] = DY[nDirs];
+        }
+    else if (dx && dy){
+        int d3x[3] = {dx, dx, 0}, d3y[3] = {dy, 0, dy};
+        for (nDirs = 0; nDirs < 3; nDirs++){
+            ddx[nDirs] = d3x[nDirs];
+            ddy[nDirs] = d3y[nDirs];
+        }
+    }
+    else {
+        /* (px, py) is perpendicular to the move (dx, dy) */
+        int px = dy ? 1 : 0, py = dx ? 1 : 0;
+        int d5x[5] = {dx, dx + px, dx - px, px, -px}, d5y[5] = {dy, dy + py, dy - py, py, -py};
+        for (nDirs = 0; nDirs < 5; nDirs++){
+            ddx[nDirs] = d5x[nDirs];
+            ddy[nDirs] = d5y[nDirs];
+        }
+    }
+
+    for (int d = 0; d < nDirs; d++){
+        int jump;
+        int found = ddx[d] && ddy[d] ? jump_diagonal(g, x, y, ddx[d], ddy[d], goal, &jump)
+                                     : jump_straight(g, x, y, ddx[d], ddy[d], goal, &jump);
+        if (!found) continue;
+        adj[count] = jump;
+        dist[count++] = grid_h(g, n, jump);
+    }
+    return count;
+}
+
+
+/*************************************************************
+ * Search the shortest path between two free cells of a grid, with the
+ * same budget and result rules as astar. With jump points, the nodes of
+ * the path are the cells where it turns, linked by straight or diagonal
+ * segments.
+ * @param g the grid
+ * @param start node of the start cell
+ * @param goal node of the goal cell
+ * @param jps 1 for Jump Point Search, 0 for A* over the 8 neighbours
+ * @param b limits of the query, NULL for none
+ * @param ws workspace of the query, from newGridWorkspace
+ * @param st (out) statistics of the query, may be NULL
+ * @return OK if a path was found, ws->reached is goal
+ * @return ERRNOPATH if goal cannot be reached from start
+ * @return ERRBUDGET if the budget was exhausted, ws->reached is the best partial end
+ * @return ERRINDEX if start or goal is not a free cell
+ * @return ERRALLOC if memory allocation failed
+ *************************************************************/
+status grid_search(Grid * g, int start, int goal, int jps, const Budget * b, Workspace * ws, SearchStats * st){
+    SearchStats local;
+    Budget none = {0, 0, 0};
+    if (!st) st = &local;
+    if (!b) b = &none;
+    memset(st, 0, sizeof(SearchStats));
+
+    int n = g->width * g->height;
+    if (start < 0 || start >= n || goal < 0 || goal >= n
+        || grid_blocked(g, start % g->width, start / g->width)
+        || grid_blocked(g, goal % g->width, goal / g->width))
+        return ERRINDEX;
+
+    resetWorkspace(ws);
+    double t0 = search_clock();
+    TRACE_POINT(TRACE_SEARCH_BEGIN, start, goal);
+    unsigned epoch = ws->epoch;
+    int best = start;
+    int bestH = grid_h(g, start, goal);
+    status res = ERRNOPATH;
+
+    ws->seen[start] = epoch;
+    ws->g[start] = 0;
+    ws->parent[start] = -1;
+    ws->closed[start] = 0;
+    ws->touched = 1;
+    if (pushHeap(ws->open, bestH, start) != OK){
+        TRACE_POINT(TRACE_SEARCH_END, 0, ERRALLOC);
+        return ERRALLOC;
+    }
+
+    HeapItem top;
+    while (popHeap(ws->open, &top) == OK){
+        int u = top.node;
+        if (ws->closed[u]) continue;
+        ws->closed[u] = 1;
+        TRACE_POINT(TRACE_POP, u, top.key);
+
+        if (u == goal){
+            TRACE_POINT(TRACE_FOUND, goal, ws->g[goal]);
+            best = goal;
+            res = OK;
+            break;
+        }
+
+        st->bytes = ws->touched * BYTES_PER_NODE + ws->open->capacity * sizeof(HeapItem);
+        if (budget_exceeded(b, st, t0)){
+            res = ERRBUDGET;
+            break;
+        }
+
+        st->expanded++;
+        int h = top.key - ws->g[u];
+        if (h < bestH || (h == bestH && ws->g[u] < ws->g[best])){
+            best = u;
+            bestH = h;
+        }
+
+        int degree = successors(g, u, ws->parent[u], goal, jps, ws->adjBuf, ws->distBuf);
+        for (int k = 0; k < degree; k++){
+            int succ = ws->adjBuf[k];
+            int distance_so_far = ws->g[u] + ws->distBuf[k];
+            st->relaxed++;
+
+            if (ws->seen[succ] != epoch){
+                ws->seen[succ] = epoch;
+                ws->closed[succ] = 0;
+                ws->touched++;
+            }
+            else if (distance_so_far >= ws->g[succ]) continue;
+            else if (ws->closed[succ]){
+                ws->closed[succ] = 0;
+                st->reopened++;
+                TRACE_POINT(TRACE_REOPEN, succ, distance_so_far);
+            }
+            TRACE_POINT(TRACE_RELAX, succ, distance_so_far);
+
+            ws->g[succ] = distance_so_far;
+            ws->parent[succ] = u;
+            if (pushHeap(ws->open, distance_so_far + grid_h(g, succ, goal), succ) != OK){
+                res = ERRALLOC;
+                break;
+            }
+        }
+        if (res == ERRALLOC) break;
+    }
+
+    ws->reached = best;
+    st->bytes = ws->touched * BYTES_PER_NODE + ws->open->capacity * sizeof(HeapItem);
+    st->seconds = search_clock() - t0;
+    TRACE_POINT(TRACE_SEARCH_END, (int)st->expanded, res);
+    return res;
+}
+
+
+/*************************************************************
+ * Display function to display a path found on a grid as
+ * "(x,y)->...->(x,y)" followed by its total cost
+ * @param g the grid the path was found in
+ * @param p the path to display
+ *************************************************************/
+void prGridPath(Grid * g, Path * p){
+    for (int i = 0; i < p->nNodes; i++)
+        printf("(%d,%d)%s", p->nodes[i] % g->width, p->nodes[i] / g->width, i + 1 < p->nNodes ? "->" : "\n");
+    printf("Total distance: %d\n", p->total);
+}
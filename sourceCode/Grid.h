@@ -0,0 +1,67 @@
+//
+//  Grid.h
+//  Astar
+//
+//  Uniform-cost grid maps (floor plans) kept as bit-packed occupancy, and
+//  their search by A* over the 8 neighbours of a cell or by Jump Point Search.
+//
+
+#ifndef Grid_h
+#define Grid_h
+
+#include <stdint.h>
+#include "status.h"
+#include "Search.h"
+#include "Path.h"
+
+/** cost of a straight and of a diagonal move **/
+#define GRID_STRAIGHT 100
+#define GRID_DIAGONAL 141
+
+/** Grid structure: bit x+1 of row y+1 is set when cell (x, y) is blocked.
+ * A frame of blocked cells surrounds the map, so scans need no bound check.
+ * cols holds the transposed bits (bit y+1 of column x+1), so that columns
+ * are scanned the same way as rows. Cell (x, y) is node y * width + x. **/
+typedef struct Grid{
+    int width;
+    int height;
+    int rowWords;
+    int colWords;
+    uint64_t * rows;
+    uint64_t * cols;
+    int nFree;
+}Grid;
+
+/** Read a grid from a text (octile) or packed file **/
+Grid * load_grid(char *);
+
+/** Write a grid as a packed file **/
+status save_grid(Grid *, char *);
+
+/** Test whether a file holds a grid **/
+int is_grid(char *);
+
+/** Destroy a grid by deallocating used memory **/
+void delGrid(Grid *);
+
+/** Test whether cell (x, y) is blocked, cells outside the grid are **/
+static inline int grid_blocked(const Grid * g, int x, int y){
+    return (g->rows[(size_t)(y + 1) * g->rowWords + ((x + 1) >> 6)] >> ((x + 1) & 63)) & 1;
+}
+
+/** Node of the free cell written "x,y", -1 if there is none **/
+int grid_node(Grid *, char *);
+
+/** Estimated cost between two nodes (octile distance) **/
+int grid_h(Grid *, int, int);
+
+/** Create a workspace for searches on the given grid **/
+Workspace * newGridWorkspace(Grid *);
+
+/** Search the shortest path between two nodes, with jump points if the flag is set **/
+status grid_search(Grid *, int, int, int, const Budget *, Workspace *, SearchStats *);
+
+/** Display function to display a path found on a grid **/
+void prGridPath(Grid *, Path *);
+
+#endif /* Grid_h */
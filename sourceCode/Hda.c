@@ -0,0 +1,349 @@
+//
+//  Hda.c
+//  Astar
+//
+//  Hash-distributed A* (HDA*).
+//
+//  Every node is owned by one thread, chosen by a hash of its index: only
+//  the owner keeps its distance, its parent and whether it is closed, and
+//  only the owner's OPEN holds it. A thread expands its own nodes in the
+//  order of its OPEN; a road to a node of another thread becomes a message
+//  (node, distance, parent) to the owner. Messages are gathered per owner
+//  in batches, pushed on the owner's inbox, a lock-free stack the owner
+//  empties in one exchange, so no thread ever waits on a lock.
+//
+//  As threads do not expand nodes in the global order of the estimate, a
+//  node may be reached again with a smaller distance once closed: it is
+//  then reopened. The first path to the goal is not final: its cost is
+//  kept as the incumbent, nodes whose estimate reaches it are pruned, and
+//  the search stops when no thread has a node below it and no message is
+//  in flight. The estimate being admissible, the incumbent is then the
+//  shortest distance.
+//
+//  Termination is counted in a single atomic counter, work: the number of
+//  busy threads plus the number of messages sent and not yet processed.
+//  A thread counts the messages it sends before sending them (it is busy,
+//  so work is positive) and counts itself busy again before processing a
+//  batch it received (whose messages are still counted). Work is thus 0
+//  only when every thread is idle with nothing in flight, and can never
+//  rise again from 0.
+//
+
+#include <limits.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "Hda.h"
+
+/** messages gathered for an owner before they are sent **/
+#define BATCH 128
+
+/** expansions between two sendings of the batches not full yet **/
+#define FLUSH_PERIOD 16
+
+/** A relaxation sent to the owner of a node **/
+typedef struct Message{
+    int node;
+    int g;
+    int parent;
+}Message;
+
+/** Messages sent together, linked in the inbox of their owner **/
+typedef struct Batch{
+    struct Batch * next;
+    int count;
+    Message msgs[BATCH];
+}Batch;
+
+/** State of the search shared by all threads **/
+typedef struct Hda{
+    Graph * g;
+    int goal;
+    int nThreads;
+    int oversubscribed;
+    int * dist;
+    int * parent;
+    char * closed;
+    _Atomic(Batch *) * inbox;
+    atomic_int incumbent;
+    atomic_long work;
+    atomic_int failed;
+}Hda;
+
+/** State of one thread **/
+typedef struct Owner{
+    Hda * s;
+    int id;
+    Heap * open;
+    Batch ** out;
+    int * adjBuf;
+    int * distBuf;
+    SearchStats st;
+}Owner;
+
+
+/** private function giving the thread owning a node **/
+static inline int owner_of(const Hda * s, int u){
+    return (int)(((unsigned)u * 2654435761u) % (unsigned)s->nThreads);
+}
+
+
+/** private function lowering the incumbent to the given cost of a path to the goal **/
+static void improve_incumbent(Hda * s, int cost){
+    int cur = atomic_load(&s->incumbent);
+    while (cost < cur && !atomic_compare_exchange_weak(&s->incumbent, &cur, cost));
+}
+
+
+/** private function relaxing a node owned by the calling thread **/
+static void relax(Owner * o, int v, int d, int parent){
+    Hda * s = o->s;
+    if (d >= s->dist[v]) return;
+    int f = d + graph_h(s->g, v, s->goal);
+    if (f >= atomic_load_explicit(&s->incumbent, memory_order_relaxed)) return;
+    if (s->closed[v]){
+        s->closed[v] = 0;
+        o->st.reopened++;
+    }
+    s->dist[v] = d;
+    s->parent[v] = parent;
+    if (v == s->goal) improve_incumbent(s, d);
+    if (pushHeap(o->open, f, v) != OK) atomic_store(&s->failed, 1);
+}
+
+
+/** private function sending the batch of messages gathered for a thread **/
+static void flush(Owner * o, int to){
+    Batch * b = o->out[to];
+    if (!b || b->count == 0) return;
+    Hda * s = o->s;
+    atomic_fetch_add(&s->work, b->count);
+    b->next = atomic_load(&s->inbox[to]);
+    while (!atomic_compare_exchange_weak(&s->inbox[to], &b->next, b));
+    o->out[to] = NULL;
+}
+
+
+/** private function sending a relaxation to the owner of a node **/
+static void send(Owner * o, int to, int v, int d, int parent){
+    Batch * b = o->out[to];
+    if (!b){
+        b = o->out[to] = (Batch *) malloc(sizeof(Batch));
+        if (!b){
+            atomic_store(&o->s->failed, 1);
+            return;
+        }
+        b->count = 0;
+    }
+    b->msgs[b->count++] = (Message){v, d, parent};
+    if (b->count == BATCH) flush(o, to);
+}
+
+
+/** private function processing the messages received by a thread, returns their number **/
+static long receive(Owner * o, int * idle){
+    Hda * s = o->s;
+    Batch * b = atomic_exchange(&s->inbox[o->id], NULL);
+    if (!b) return 0;
+    if (*idle){
+        atomic_fetch_add(&s->work, 1);
+        *idle = 0;
+    }
+    long count = 0;
+    while (b){
+        Batch * next = b->next;
+        for (int i = 0; i < b->count; i++) relax(o, b->msgs[i].node, b->msgs[i].g, b->msgs[i].parent);
+        count += b->count;
+        free(b);
+        b = next;
+    }
+    atomic_fetch_sub(&s->work, count);
+    return count;
+}
+
+
+/** private function run by every thread until the search is over **/
+static void * hda_worker(void * arg){
+    Owner * o = (Owner *)arg;
+    Hda * s = o->s;
+    int idle = 0;
+    
+    while (!atomic_load(&s->failed)){
+        receive(o, &idle);
+        
+        /* expand the best own node, unless it cannot lead below the incumbent */
+        HeapItem top;
+        int incumbent = atomic_load_explicit(&s->incumbent, memory_order_relaxed);
+        if (o->open->size > 0 && o->open->items[0].key < incumbent){
+            popHeap(o->open, &top);
+            int n = top.node;
+            if (s->closed[n]) continue;
+            s->closed[n] = 1;
+            if (n == s->goal) continue;
+            o->st.expanded++;
+            
+            const int * adj, * dist;
+            int degree = graph_roads(s->g, n, o->adjBuf, o->distBuf, &adj, &dist);
+            for (int k = 0; k < degree; k++){
+                int v = adj[k], d = s->dist[n] + dist[k];
+                o->st.relaxed++;
+                int to = owner_of(s, v);
+                if (to == o->id) relax(o, v, d, n);
+                else if (d + graph_h(s->g, v, s->goal) < incumbent) send(o, to, v, d, n);
+            }
+            
+            /* partial batches too, so the other threads are not left without
+             * work; with more threads than processors, let them process it
+             * now, as a thread running ahead alone expands nodes whose
+             * distance is not final and reopens them later */
+            if (o->st.expanded % FLUSH_PERIOD == 0){
+                for (int t = 0; t < s->nThreads; t++) flush(o, t);
+                if (s->oversubscribed) sched_yield();
+            }
+            continue;
+        }
+        
+        /* nothing to expand: hand out what was gathered, then wait */
+        for (int t = 0; t < s->nThreads; t++) flush(o, t);
+        if (!idle){
+            idle = 1;
+            atomic_fetch_sub(&s->work, 1);
+        }
+        if (atomic_load(&s->work) == 0) break;
+        sched_yield();
+    }
+    return NULL;
+}
+
+
+/** private function copying the path to the goal out of the parents, the
+ * legs being the lengths of the roads taken **/
+static status parent_path(Hda * s, Path * p){
+    int count = 0;
+    for (int n = s->goal; n != -1; n = s->parent[n])
+        if (++count > p->capacity) return ERRFULL;
+    int i = count;
+    int * adjBuf = (int *) malloc((s->g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((s->g->maxDegree + 1) * sizeof(int));
+    if (!adjBuf || !distBuf){
+        free(adjBuf);
+        free(distBuf);
+        return ERRALLOC;
+    }
+    p->total = 0;
+    for (int n = s->goal; n != -1; n = s->parent[n]){
+        p->nodes[--i] = n;
+        p->legs[i] = 0;
+        if (i + 1 < count){
+            const int * adj, * dist;
+            int degree = graph_roads(s->g, n, adjBuf, distBuf, &adj, &dist), leg = INT_MAX;
+            for (int k = 0; k < degree; k++)
+                if (adj[k] == p->nodes[i + 1] && dist[k] < leg) leg = dist[k];
+            p->legs[i] = leg;
+            p->total += leg;
+        }
+    }
+    p->nNodes = count;
+    free(adjBuf);
+    free(distBuf);
+    return OK;
+}
+
+
+/*************************************************************
+ * Search the shortest path from start to goal with HDA* on several
+ * threads. The estimate must be admissible (see calibrate_h); arc-flags
+ * and budgets are not used.
+ * @param g the graph
+ * @param start index of the start city
+ * @param goal index of the goal city
+ * @param nThreads number of threads, 0 for one per processor
+ * @param path (out) the shortest path, of capacity nCities
+ * @param st (out) statistics summed over the threads (reopened nodes
+ * included), may be NULL
+ * @return ERRNOPATH if goal cannot be reached from start
+ * @return ERRINDEX if start or goal is not a node of the graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ *************************************************************/
+status hda_star(Graph * g, int start, int goal, int nThreads, Path * path, SearchStats * st){
+    SearchStats local;
+    if (!st) st = &local;
+    memset(st, 0, sizeof(SearchStats));
+    path->nNodes = 0;
+    path->total = 0;
+    if (start < 0 || start >= g->nCities || goal < 0 || goal >= g->nCities) return ERRINDEX;
+    if (g->component[start] != g->component[goal]) return ERRNOPATH;
+    int procs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads <= 0) nThreads = procs;
+    if (nThreads < 1) nThreads = 1;
+    double t0 = search_clock();
+    
+    int n = g->nCities;
+    Hda s = {g, goal, nThreads, nThreads > procs};
+    s.dist = (int *) malloc((n + 1) * sizeof(int));
+    s.parent = (int *) malloc((n + 1) * sizeof(int));
+    s.closed = (char *) calloc(n + 1, 1);
+    s.inbox = (_Atomic(Batch *) *) calloc(nThreads, sizeof(_Atomic(Batch *)));
+    Owner * owners = (Owner *) calloc(nThreads, sizeof(Owner));
+    pthread_t * threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
+    atomic_init(&s.incumbent, INT_MAX);
+    atomic_init(&s.work, nThreads);
+    atomic_init(&s.failed, 0);
+    status res = ERRALLOC;
+    int started = 0;
+    if (!s.dist || !s.parent || !s.closed || !s.inbox || !owners || !threads) goto done;
+    for (int u = 0; u < n; u++) s.dist[u] = INT_MAX;
+    for (int t = 0; t < nThreads; t++){
+        owners[t].s = &s;
+        owners[t].id = t;
+        owners[t].open = newHeap(1024);
+        owners[t].out = (Batch **) calloc(nThreads, sizeof(Batch *));
+        owners[t].adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+        owners[t].distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+        if (!owners[t].open || !owners[t].out || !owners[t].adjBuf || !owners[t].distBuf) goto done;
+    }
+    
+    /* the owner of start begins, the other threads wait for its messages */
+    relax(&owners[owner_of(&s, start)], start, 0, -1);
+    for (; started < nThreads; started++)
+        if (pthread_create(&threads[started], NULL, hda_worker, &owners[started]) != 0) break;
+    if (started < nThreads) atomic_store(&s.failed, 1);
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    
+    if (atomic_load(&s.failed)) res = ERRALLOC;
+    else if (atomic_load(&s.incumbent) == INT_MAX) res = ERRNOPATH;
+    else res = parent_path(&s, path);
+    
+done:
+    for (int t = 0; owners && t < nThreads; t++){
+        st->expanded += owners[t].st.expanded;
+        st->relaxed += owners[t].st.relaxed;
+        st->reopened += owners[t].st.reopened;
+        if (owners[t].open) st->bytes += owners[t].open->capacity * sizeof(HeapItem);
+        delHeap(owners[t].open);
+        for (int k = 0; owners[t].out && k < nThreads; k++) free(owners[t].out[k]);
+        free(owners[t].out);
+        free(owners[t].adjBuf);
+        free(owners[t].distBuf);
+    }
+    for (int t = 0; s.inbox && t < nThreads; t++){
+        Batch * b = atomic_load(&s.inbox[t]);
+        while (b){
+            Batch * next = b->next;
+            free(b);
+            b = next;
+        }
+    }
+    st->bytes += (size_t)(n + 1) * (2 * sizeof(int) + 1);
+    st->seconds = search_clock() - t0;
+    free(s.dist);
+    free(s.parent);
+    free(s.closed);
+    free(s.inbox);
+    free(owners);
+    free(threads);
+    return res;
+}
@@ -0,0 +1,19 @@
+//
+//  Hda.h
+//  Astar
+//
+//  Hash-distributed A* (HDA*): one query searched by several threads, each
+//  owning the nodes its hash designates.
+//
+
+#ifndef Hda_h
+#define Hda_h
+
+#include "Graph.h"
+#include "Search.h"
+#include "Path.h"
+
+/** Search the shortest path from start to goal on several threads **/
+status hda_star(Graph *, int, int, int, Path *, SearchStats *);
+
+#endif /* Hda_h */
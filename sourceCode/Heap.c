@@ -0,0 +1,132 @@
+//
+//  Heap.c
+//  Astar
+//
+//  Binary min-heap of (key, node) pairs used as the OPEN set of the searches.
+//
+
+#include <stdlib.h>
+#include "Heap.h"
+#include "Memory.h"
+
+
+/*************************************************************
+ * Create a new, empty heap
+ * @param capacity number of items to reserve room for (at least 1)
+ * @return the new heap
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Heap * newHeap(int capacity){
+    Heap * h = (Heap *) mem_alloc(MEM_OPEN, sizeof(Heap));
+    if (!h) return NULL;
+    if (capacity < 1) capacity = 1;
+    h->items = (HeapItem *) mem_alloc(MEM_OPEN, capacity * sizeof(HeapItem));
+    if (!h->items){
+        mem_free(MEM_OPEN, h, sizeof(Heap));
+        return NULL;
+    }
+    h->size = 0;
+    h->capacity = capacity;
+    return h;
+}
+
+
+/*************************************************************
+ * Destroy the heap by deallocating used memory
+ * @param h the heap to destroy
+ *************************************************************/
+void delHeap(Heap * h){
+    if (!h) return;
+    mem_free(MEM_OPEN, h->items, h->capacity * sizeof(HeapItem));
+    mem_free(MEM_OPEN, h, sizeof(Heap));
+}
+
+
+/*************************************************************
+ * Remove all items, keeping the allocated storage for reuse
+ * @param h the heap to empty
+ *************************************************************/
+void clearHeap(Heap * h){
+    h->size = 0;
+}
+
+
+/*************************************************************
+ * Insert a node with the given key (O(log N))
+ * @param h the heap
+ * @param key priority of the node, smallest comes out first
+ * @param node the node to insert
+ * @return ERRALLOC if the heap had to grow and memory allocation failed
+ * @return OK otherwise
+ *************************************************************/
+status pushHeap(Heap * h, int key, int node){
+    if (h->size == h->capacity){
+        HeapItem * bigger = (HeapItem *) mem_realloc(MEM_OPEN, h->items, h->capacity * sizeof(HeapItem),
+                                                      2 * h->capacity * sizeof(HeapItem));
+        if (!bigger) return ERRALLOC;
+        h->items = bigger;
+        h->capacity *= 2;
+    }
+    
+    /* sift the hole up until the parent is not greater than key */
+    int i = h->size++;
+    while (i > 0){
+        int parent = (i - 1) / 2;
+        if (h->items[parent].key <= key) break;
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i].key = key;
+    h->items[i].node = node;
+    return OK;
+}
+
+
+/*************************************************************
+ * Remove the item with the smallest key (O(log N))
+ * @param h the heap
+ * @param res (out) the removed item
+ * @return ERREMPTY if the heap is empty
+ * @return OK otherwise
+ *************************************************************/
+status popHeap(Heap * h, HeapItem * res){
+    if (h->size == 0) return ERREMPTY;
+    *res = h->items[0];
+    
+    /* move the last item into the hole at the root and sift it down */
+    HeapItem last = h->items[--h->size];
+    int i = 0;
+    for (;;){
+        int child = 2 * i + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && h->items[child + 1].key < h->items[child].key) child++;
+        if (last.key <= h->items[child].key) break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = last;
+    return OK;
+}
+
+
+/*************************************************************
+ * Restore the heap order after the keys of the items were changed in
+ * place, by sifting down every internal node from the last one (linear
+ * time, cheaper than pushing every item again)
+ * @param h the heap
+ *************************************************************/
+void heapifyHeap(Heap * h){
+    for (int start = h->size / 2 - 1; start >= 0; start--){
+        HeapItem moved = h->items[start];
+        int i = start;
+        for (;;){
+            int child = 2 * i + 1;
+            if (child >= h->size) break;
+            if (child + 1 < h->size && h->items[child + 1].key < h->items[child].key) child++;
+            if (moved.key <= h->items[child].key) break;
+            h->items[i] = h->items[child];
+            i = child;
+        }
+        h->items[i] = moved;
+    }
+}
@@ -0,0 +1,44 @@
+//
+//  Heap.h
+//  Astar
+//
+//  Binary min-heap of (key, node) pairs used as the OPEN set of the searches.
+//
+
+#ifndef Heap_h
+#define Heap_h
+
+#include "status.h"
+
+/** Heap item: a node index together with its priority **/
+typedef struct HeapItem{
+    int key;
+    int node;
+}HeapItem;
+
+/** Growable array-based binary heap, smallest key on top **/
+typedef struct Heap{
+    int size;
+    int capacity;
+    HeapItem * items;
+}Heap;
+
+/** Create a new, empty heap able to hold the given number of items before growing **/
+Heap * newHeap(int);
+
+/** Destroy the heap by deallocating used memory **/
+void delHeap(Heap *);
+
+/** Remove all items, keeping the allocated storage **/
+void clearHeap(Heap *);
+
+/** Insert a node with the given key **/
+status pushHeap(Heap *, int, int);
+
+/** Remove the item with the smallest key **/
+status popHeap(Heap *, HeapItem *);
+
+/** Restore the heap order after keys were changed in place **/
+void heapifyHeap(Heap *);
+
+#endif /* Heap_h */
@@ -0,0 +1,488 @@
+//
+//  Hub.c
+//  Astar
+//
+//  Hub labels built by pruned landmark labeling.
+//
+//  Nodes are taken as hubs one at a time, the most important first. From
+//  each hub v, a forward Dijkstra adds (v, d(v, u)) to the in label of every
+//  node u it settles, and a backward one adds (v, d(u, v)) to the out label
+//  of u; a node whose distance is already given by the labels built so far
+//  is neither labelled nor expanded, which keeps both searches and labels
+//  small once the important nodes are hubs. The labels of the hubs taken
+//  first cover most shortest paths, so importance matters: it is the number
+//  of nodes below a node in shortest path trees from SAMPLES random
+//  sources, which puts the junctions of main roads first.
+//
+//  Labels are filled in rank order, so they come out sorted and a query is
+//  a merge of two arrays. Labels have a few hundred entries on road maps
+//  (137 to 335 on average on the generated maps): the merge is scalar,
+//  advancing both sides without a branch on the order.
+//
+//  The file holds the labels with the number of cities and roads and a
+//  fingerprint of the roads: labels are only loaded for the graph (and the
+//  node order) they were built on.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "Hub.h"
+#include "Heap.h"
+#include "Sssp.h"
+
+/** number of shortest path trees the importance of the nodes is sampled from **/
+#define SAMPLES 16
+
+/** distance standing for "none" in the pruning tests, so that sums do not overflow **/
+#define FAR (UNREACHED / 2)
+
+static const char magic[4] = {'A', 'H', 'L', '1'};
+
+/** Label of a node while it is built **/
+typedef struct Label{
+    int n;
+    int cap;
+    HubEntry * e;
+}Label;
+
+/** State of the construction **/
+typedef struct Builder{
+    Graph * g;
+    int * rfirst;
+    int * radj;
+    int * rdist;
+    Label * out;
+    Label * in;
+    int * dist;
+    int * parent;
+    int * settled;
+    int nSettled;
+    int * touched;
+    int nTouched;
+    int * rootDist;
+    int * adjBuf;
+    int * distBuf;
+    Heap * open;
+}Builder;
+
+
+static double clock_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/** private function computing the fingerprint of the roads of a graph (FNV-1a) **/
+static unsigned roads_fingerprint(Graph * g){
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    unsigned h = 2166136261u;
+    if (!adjBuf || !distBuf){
+        free(adjBuf);
+        free(distBuf);
+        return 0;
+    }
+    for (int u = 0; u < g->nCities; u++){
+        const int * adj, * dist;
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &dist);
+        h = (h ^ (unsigned)degree) * 16777619u;
+        for (int i = 0; i < degree; i++){
+            h = (h ^ (unsigned)adj[i]) * 16777619u;
+            h = (h ^ (unsigned)dist[i]) * 16777619u;
+        }
+    }
+    free(adjBuf);
+    free(distBuf);
+    return h;
+}
+
+
+/** private function building the reverse roads of any graph **/
+static status reverse_roads(Builder * b){
+    Graph * g = b->g;
+    int n = g->nCities, m = g->nEdges;
+    b->rfirst = (int *) calloc(n + 2, sizeof(int));
+    b->radj = (int *) malloc((m + 1) * sizeof(int));
+    b->rdist = (int *) malloc((m + 1) * sizeof(int));
+    if (!b->rfirst || !b->radj || !b->rdist) return ERRALLOC;
+    const int * adj, * dist;
+    for (int u = 0; u < n; u++){
+        int degree = graph_roads(g, u, b->adjBuf, b->distBuf, &adj, &dist);
+        for (int i = 0; i < degree; i++) b->rfirst[adj[i] + 2]++;
+    }
+    for (int v = 0; v < n; v++) b->rfirst[v + 2] += b->rfirst[v + 1];
+    for (int u = 0; u < n; u++){
+        int degree = graph_roads(g, u, b->adjBuf, b->distBuf, &adj, &dist);
+        for (int i = 0; i < degree; i++){
+            int k = b->rfirst[adj[i] + 1]++;
+            b->radj[k] = u;
+            b->rdist[k] = dist[i];
+        }
+    }
+    return OK;
+}
+
+
+/** private function returning the roads of u, backward ones if reverse is set **/
+static int roads_of(Builder * b, int u, int reverse, const int ** adj, const int ** dist){
+    if (!reverse) return graph_roads(b->g, u, b->adjBuf, b->distBuf, adj, dist);
+    *adj = b->radj + b->rfirst[u];
+    *dist = b->rdist + b->rfirst[u];
+    return b->rfirst[u+1] - b->rfirst[u];
+}
+
+
+/** private function appending an entry to a label **/
+static status add_entry(Label * l, int hub, int dist){
+    if (l->n == l->cap){
+        int cap = l->cap ? 2 * l->cap : 4;
+        HubEntry * bigger = (HubEntry *) realloc(l->e, cap * sizeof(HubEntry));
+        if (!bigger) return ERRALLOC;
+        l->e = bigger;
+        l->cap = cap;
+    }
+    l->e[l->n].hub = hub;
+    l->e[l->n].dist = dist;
+    l->n++;
+    return OK;
+}
+
+
+/*************************************************************
+ * private function running a Dijkstra from root, forward or backward
+ * (reverse set). Without labels, the nodes settled are recorded in
+ * settled[0 .. nSettled-1] with their parent in the tree. With labels
+ * (root being the hub of the given rank), a settled node whose distance
+ * the labels already give is skipped, the others get an entry for the hub.
+ * @return ERRALLOC if memory allocation failed, OK otherwise
+ *************************************************************/
+static status search_from(Builder * b, int root, int reverse, int labels, int rank){
+    Label * mine = reverse ? b->out : b->in;
+    Label * other = reverse ? b->in : b->out;
+    status res = OK;
+
+    /* distances from the root to the hubs it already has */
+    for (int i = 0; labels && i < other[root].n; i++) b->rootDist[other[root].e[i].hub] = other[root].e[i].dist;
+
+    b->nSettled = 0;
+    b->nTouched = 1;
+    b->touched[0] = root;
+    b->dist[root] = 0;
+    b->parent[root] = -1;
+    clearHeap(b->open);
+    if (pushHeap(b->open, 0, root) != OK) res = ERRALLOC;
+    HeapItem it;
+    while (res == OK && popHeap(b->open, &it) == OK){
+        int u = it.node;
+        if (it.key > b->dist[u]) continue;
+
+        if (labels){
+            int known = FAR;
+            for (int i = 0; i < mine[u].n; i++){
+                int d = b->rootDist[mine[u].e[i].hub] + mine[u].e[i].dist;
+                if (d < known) known = d;
+            }
+            if (known <= it.key) continue;
+            if (add_entry(&mine[u], rank, it.key) != OK){
+                res = ERRALLOC;
+                break;
+            }
+        }
+        else b->settled[b->nSettled++] = u;
+
+        const int * adj, * dist;
+        int degree = roads_of(b, u, reverse, &adj, &dist);
+        for (int i = 0; i < degree && res == OK; i++){
+            int v = adj[i], d = it.key + dist[i];
+            if (d >= b->dist[v]) continue;
+            if (b->dist[v] == UNREACHED) b->touched[b->nTouched++] = v;
+            b->dist[v] = d;
+            b->parent[v] = u;
+            if (pushHeap(b->open, d, v) != OK) res = ERRALLOC;
+        }
+    }
+
+    /* put back the distances of the nodes reached and of the root's hubs */
+    for (int i = 0; i < b->nTouched; i++) b->dist[b->touched[i]] = UNREACHED;
+    for (int i = 0; labels && i < other[root].n; i++) b->rootDist[other[root].e[i].hub] = FAR;
+    return res;
+}
+
+
+/** private comparison of nodes by decreasing importance, for qsort **/
+static const double * sort_importance;
+static int compImportance(const void * a, const void * b){
+    int u = *(const int *)a, v = *(const int *)b;
+    if (sort_importance[u] != sort_importance[v]) return sort_importance[u] < sort_importance[v] ? 1 : -1;
+    return u - v;
+}
+
+
+/*************************************************************
+ * private function ordering the nodes by importance: the number of nodes
+ * below them in the shortest path trees of random sources, plus their
+ * degree to order the nodes no tree goes through
+ *************************************************************/
+static status importance_order(Builder * b, int * nodeOfRank){
+    Graph * g = b->g;
+    int n = g->nCities;
+    double * importance = (double *) calloc(n + 1, sizeof(double));
+    int * below = (int *) malloc((n + 1) * sizeof(int));
+    if (!importance || !below){
+        free(importance);
+        free(below);
+        return ERRALLOC;
+    }
+    unsigned long long seed = 0x9e3779b97f4a7c15ULL ^ (unsigned)n;
+    status res = OK;
+    for (int s = 0; s < SAMPLES && s < n && res == OK; s++){
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        res = search_from(b, (int)((seed >> 33) % n), 0, 0, 0);
+
+        /* children are settled after their parent: count from the last one */
+        for (int i = 0; i < b->nSettled; i++) below[b->settled[i]] = 0;
+        for (int i = b->nSettled - 1; i >= 0; i--){
+            int u = b->settled[i];
+            importance[u] += below[u];
+            if (i > 0) below[b->parent[u]] += below[u] + 1;
+        }
+    }
+    for (int u = 0; u < n; u++){
+        const int * adj, * dist;
+        importance[u] += roads_of(b, u, 0, &adj, &dist) + b->rfirst[u+1] - b->rfirst[u];
+        nodeOfRank[u] = u;
+    }
+    sort_importance = importance;
+    qsort(nodeOfRank, n, sizeof(int), compImportance);
+    free(importance);
+    free(below);
+    return res;
+}
+
+
+/** private function packing the labels of one direction into an array, each closed by HUB_END **/
+static status pack_labels(Label * l, int n, long ** first, HubEntry ** entries){
+    long total = 0;
+    for (int u = 0; u < n; u++) total += l[u].n + 1;
+    *first = (long *) malloc((n + 1) * sizeof(long));
+    *entries = (HubEntry *) malloc((total + 1) * sizeof(HubEntry));
+    if (!*first || !*entries) return ERRALLOC;
+    long k = 0;
+    for (int u = 0; u < n; u++){
+        (*first)[u] = k;
+        memcpy(*entries + k, l[u].e, l[u].n * sizeof(HubEntry));
+        k += l[u].n;
+        (*entries)[k].hub = HUB_END;
+        (*entries)[k].dist = 0;
+        k++;
+    }
+    (*first)[n] = k;
+    return OK;
+}
+
+
+/*************************************************************
+ * Build the hub labels of a graph, of any kind (plain, stored or shared)
+ * @param g the graph
+ * @return the labels
+ * @return NULL if memory allocation failed
+ *************************************************************/
+HubLabels * build_hub_labels(Graph * g){
+    double t0 = clock_seconds();
+    int n = g->nCities;
+    HubLabels * hl = (HubLabels *) calloc(1, sizeof(HubLabels));
+    Builder b = {g};
+    b.out = (Label *) calloc(n + 1, sizeof(Label));
+    b.in = (Label *) calloc(n + 1, sizeof(Label));
+    b.dist = (int *) malloc((n + 1) * sizeof(int));
+    b.parent = (int *) malloc((n + 1) * sizeof(int));
+    b.settled = (int *) malloc((n + 1) * sizeof(int));
+    b.touched = (int *) malloc((n + 1) * sizeof(int));
+    b.rootDist = (int *) malloc((n + 1) * sizeof(int));
+    b.adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    b.distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    b.open = newHeap(1024);
+    status res = ERRALLOC;
+    if (!hl || !b.out || !b.in || !b.dist || !b.parent || !b.settled || !b.touched || !b.rootDist
+        || !b.adjBuf || !b.distBuf || !b.open) goto done;
+    hl->nCities = n;
+    hl->nEdges = g->nEdges;
+    hl->nodeOfRank = (int *) malloc((n + 1) * sizeof(int));
+    if (!hl->nodeOfRank || reverse_roads(&b) != OK) goto done;
+    for (int u = 0; u < n; u++){
+        b.dist[u] = UNREACHED;
+        b.rootDist[u] = FAR;
+    }
+
+    res = importance_order(&b, hl->nodeOfRank);
+    for (int r = 0; r < n && res == OK; r++){
+        res = search_from(&b, hl->nodeOfRank[r], 0, 1, r);
+        if (res == OK) res = search_from(&b, hl->nodeOfRank[r], 1, 1, r);
+    }
+    if (res == OK) res = pack_labels(b.out, n, &hl->outFirst, &hl->out);
+    if (res == OK) res = pack_labels(b.in, n, &hl->inFirst, &hl->in);
+    hl->fingerprint = roads_fingerprint(g);
+    hl->buildSeconds = clock_seconds() - t0;
+
+done:
+    for (int u = 0; u < n && b.out && b.in; u++){
+        free(b.out[u].e);
+        free(b.in[u].e);
+    }
+    free(b.out); free(b.in); free(b.dist); free(b.parent); free(b.settled); free(b.touched); free(b.rootDist);
+    free(b.adjBuf); free(b.distBuf); free(b.rfirst); free(b.radj); free(b.rdist);
+    delHeap(b.open);
+    if (res != OK){
+        delHubLabels(hl);
+        return NULL;
+    }
+    return hl;
+}
+
+
+/*************************************************************
+ * Destroy hub labels by deallocating used memory
+ * @param hl the labels, may be NULL
+ *************************************************************/
+void delHubLabels(HubLabels * hl){
+    if (!hl) return;
+    free(hl->nodeOfRank);
+    free(hl->outFirst);
+    free(hl->out);
+    free(hl->inFirst);
+    free(hl->in);
+    free(hl);
+}
+
+
+/*************************************************************
+ * Distance from a node to another one: merge of the out label of the
+ * first and the in label of the second
+ * @param hl the labels
+ * @param from index of the start node
+ * @param to index of the goal node
+ * @return the distance, UNREACHED if to cannot be reached from from
+ *************************************************************/
+int hub_distance(const HubLabels * hl, int from, int to){
+    const HubEntry * a = hl->out + hl->outFirst[from];
+    const HubEntry * b = hl->in + hl->inFirst[to];
+    int best = UNREACHED;
+    for (;;){
+        int ha = a->hub, hb = b->hub;
+        if (ha == hb){
+            if (ha == HUB_END) break;
+            int d = a->dist + b->dist;
+            if (d < best) best = d;
+        }
+        a += ha <= hb;
+        b += hb <= ha;
+    }
+    return best;
+}
+
+
+/** Number of bytes used by the labels, with their offsets and the order **/
+size_t hub_labels_bytes(const HubLabels * hl){
+    size_t n = hl->nCities;
+    return (hl->outFirst[n] + hl->inFirst[n]) * sizeof(HubEntry) + 2 * (n + 1) * sizeof(long) + n * sizeof(int);
+}
+
+
+/** private function checking labels read from a file before any merge runs
+ * on them: offsets increasing from 0 to total, and every label made of
+ * ranks of nodes, increasing, then HUB_END **/
+static int valid_labels(const long * first, const HubEntry * e, long total, int n){
+    if (first[0] != 0 || first[n] != total) return 0;
+    for (int u = 0; u < n; u++){
+        if (first[u + 1] <= first[u] || first[u + 1] > total) return 0;
+        long last = first[u + 1] - 1;
+        if (e[last].hub != HUB_END) return 0;
+        for (long k = first[u]; k < last; k++)
+            if (e[k].hub < 0 || e[k].hub >= n || e[k].dist < 0 || e[k].dist >= FAR
+                || (k > first[u] && e[k].hub <= e[k - 1].hub))
+                return 0;
+    }
+    return 1;
+}
+
+
+/*************************************************************
+ * Write hub labels to a file
+ * @param hl the labels
+ * @param filepath file to write
+ * @return ERROPEN if the file cannot be opened
+ * @return ERRCLOSE if writing failed
+ * @return OK otherwise
+ *************************************************************/
+status save_hub_labels(HubLabels * hl, char * filepath){
+    FILE * f = fopen(filepath, "wb");
+    if (!f) return ERROPEN;
+    size_t n = hl->nCities;
+    long nOut = hl->outFirst[n], nIn = hl->inFirst[n];
+    int header[3] = {hl->nCities, hl->nEdges, (int)hl->fingerprint};
+    int ok = fwrite(magic, 1, 4, f) == 4
+        && fwrite(header, sizeof(int), 3, f) == 3
+        && fwrite(&nOut, sizeof(long), 1, f) == 1
+        && fwrite(&nIn, sizeof(long), 1, f) == 1
+        && fwrite(hl->nodeOfRank, sizeof(int), n, f) == n
+        && fwrite(hl->outFirst, sizeof(long), n + 1, f) == n + 1
+        && fwrite(hl->out, sizeof(HubEntry), nOut, f) == (size_t)nOut
+        && fwrite(hl->inFirst, sizeof(long), n + 1, f) == n + 1
+        && fwrite(hl->in, sizeof(HubEntry), nIn, f) == (size_t)nIn;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? OK : ERRCLOSE;
+}
+
+
+/*************************************************************
+ * Read the hub labels of a graph written by save_hub_labels
+ * @param g the graph the labels were built on
+ * @param filepath file to read
+ * @return the labels
+ * @return NULL if the file cannot be read, does not hold well-formed hub
+ * labels or holds the labels of another graph (or of another order of its nodes)
+ *************************************************************/
+HubLabels * load_hub_labels(Graph * g, char * filepath){
+    FILE * f = fopen(filepath, "rb");
+    if (!f) return NULL;
+    char m[4];
+    int header[3];
+    long nOut, nIn;
+    HubLabels * hl = NULL;
+    if (fread(m, 1, 4, f) != 4 || memcmp(m, magic, 4) != 0 || fread(header, sizeof(int), 3, f) != 3
+        || fread(&nOut, sizeof(long), 1, f) != 1 || fread(&nIn, sizeof(long), 1, f) != 1
+        || header[0] != g->nCities || header[1] != g->nEdges || (unsigned)header[2] != roads_fingerprint(g)
+        || nOut < g->nCities || nIn < g->nCities)
+        goto fail;
+    hl = (HubLabels *) calloc(1, sizeof(HubLabels));
+    if (!hl) goto fail;
+    size_t n = g->nCities;
+    hl->nCities = g->nCities;
+    hl->nEdges = g->nEdges;
+    hl->fingerprint = (unsigned)header[2];
+    hl->nodeOfRank = (int *) malloc((n + 1) * sizeof(int));
+    hl->outFirst = (long *) malloc((n + 1) * sizeof(long));
+    hl->out = (HubEntry *) malloc(nOut * sizeof(HubEntry));
+    hl->inFirst = (long *) malloc((n + 1) * sizeof(long));
+    hl->in = (HubEntry *) malloc(nIn * sizeof(HubEntry));
+    if (!hl->nodeOfRank || !hl->outFirst || !hl->out || !hl->inFirst || !hl->in
+        || fread(hl->nodeOfRank, sizeof(int), n, f) != n
+        || fread(hl->outFirst, sizeof(long), n + 1, f) != n + 1
+        || fread(hl->out, sizeof(HubEntry), nOut, f) != (size_t)nOut
+        || fread(hl->inFirst, sizeof(long), n + 1, f) != n + 1
+        || fread(hl->in, sizeof(HubEntry), nIn, f) != (size_t)nIn
+        || !valid_labels(hl->outFirst, hl->out, nOut, hl->nCities)
+        || !valid_labels(hl->inFirst, hl->in, nIn, hl->nCities))
+        goto fail;
+    for (size_t r = 0; r < n; r++)
+        if (hl->nodeOfRank[r] < 0 || hl->nodeOfRank[r] >= hl->nCities) goto fail;
+    fclose(f);
+    return hl;
+
+fail:
+    fclose(f);
+    delHubLabels(hl);
+    return NULL;
+}
@@ -0,0 +1,59 @@
+//
+//  Hub.h
+//  Astar
+//
+//  Hub labels: the distance between any two cities from two short sorted
+//  arrays, built offline by pruned landmark labeling.
+//
+
+#ifndef Hub_h
+#define Hub_h
+
+#include <stddef.h>
+#include "Graph.h"
+
+/** rank closing every label **/
+#define HUB_END 0x7fffffff
+
+/** Entry of a label: a hub, by rank, and the distance to (or from) it **/
+typedef struct HubEntry{
+    int hub;
+    int dist;
+}HubEntry;
+
+/** Hub labels of a graph: out[outFirst[u] ..] are the hubs reachable from
+ * u and in[inFirst[u] ..] the hubs reaching u, by increasing rank and
+ * closed by HUB_END. The distance from s to t is the smallest sum over the
+ * hubs common to the out label of s and the in label of t. nodeOfRank[r]
+ * is the node of rank r, the most important first. **/
+typedef struct HubLabels{
+    int nCities;
+    int nEdges;
+    unsigned fingerprint;
+    int * nodeOfRank;
+    long * outFirst;
+    HubEntry * out;
+    long * inFirst;
+    HubEntry * in;
+    double buildSeconds;
+}HubLabels;
+
+/** Build the hub labels of a graph **/
+HubLabels * build_hub_labels(Graph *);
+
+/** Destroy hub labels by deallocating used memory **/
+void delHubLabels(HubLabels *);
+
+/** Distance from a node to another one, UNREACHED if there is no path **/
+int hub_distance(const HubLabels *, int, int);
+
+/** Number of bytes used by the labels **/
+size_t hub_labels_bytes(const HubLabels *);
+
+/** Write hub labels to a file **/
+status save_hub_labels(HubLabels *, char *);
+
+/** Read the hub labels of a graph written by save_hub_labels **/
+HubLabels * load_hub_labels(Graph *, char *);
+
+#endif /* Hub_h */
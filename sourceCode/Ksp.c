@@ -0,0 +1,273 @@
+//
+//  Ksp.c
+//  Astar
+//
+//  K shortest loopless paths between two cities (Yen's algorithm).
+//
+//  The i-th path is found among candidates made from the (i-1)-th one: for
+//  each of its nodes (the spur node), the part of the path before it (the
+//  root) is kept and continued by the shortest path from the spur node to
+//  the goal that avoids the nodes of the root and the roads taken from the
+//  spur node by the paths already found with the same root. The cheapest
+//  candidate not found yet is the next path.
+//
+//  The spur searches of one round are independent: they are shared among
+//  threads, each with its own workspace, path buffer and marks of the
+//  avoided nodes, allocated once and reused by all its searches (marks
+//  are stamped like the workspace, so they are never cleared).
+//
+
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "Ksp.h"
+
+/** State of a thread running spur searches, reused from one search to the next **/
+typedef struct Spur{
+    Workspace * ws;
+    Path * buf;
+    unsigned * mark;
+    unsigned stamp;
+    int * targets;
+    SearchStats st;
+}Spur;
+
+/** A round of spur searches from the nodes of the last path found **/
+typedef struct Round{
+    Graph * g;
+    int goal;
+    Path ** found;
+    int nFound;
+    Path ** cand;
+    int nSpurs;
+    atomic_int next;
+    atomic_int failed;
+}Round;
+
+/** Argument of a thread of a round **/
+typedef struct Worker{
+    Round * r;
+    Spur * spur;
+}Worker;
+
+
+/** private function creating the state of a thread for paths of at most k alternatives **/
+static Spur * newSpur(Graph * g, int k){
+    Spur * s = (Spur *) calloc(1, sizeof(Spur));
+    if (!s) return NULL;
+    s->ws = newWorkspace(g);
+    s->buf = newPath(g->nCities);
+    s->mark = (unsigned *) calloc(g->nCities + 1, sizeof(unsigned));
+    s->targets = (int *) malloc((k + 1) * sizeof(int));
+    return s;
+}
+
+
+/** private function destroying the state of a thread **/
+static void delSpur(Spur * s){
+    if (!s) return;
+    delWorkspace(s->ws);
+    delPath(s->buf);
+    free(s->mark);
+    free(s->targets);
+    free(s);
+}
+
+
+/** private function copying a path into a new path of the exact size, after
+ * the first nRoot nodes (and legs) of root **/
+static Path * join_paths(Path * root, int nRoot, Path * tail){
+    Path * p = newPath(nRoot + tail->nNodes);
+    if (!p) return NULL;
+    p->total = tail->total;
+    for (int i = 0; i < nRoot; i++){
+        p->nodes[i] = root->nodes[i];
+        p->legs[i] = root->legs[i];
+        p->total += root->legs[i];
+    }
+    memcpy(p->nodes + nRoot, tail->nodes, tail->nNodes * sizeof(int));
+    memcpy(p->legs + nRoot, tail->legs, tail->nNodes * sizeof(int));
+    p->nNodes = nRoot + tail->nNodes;
+    return p;
+}
+
+
+/*************************************************************
+ * private function computing the candidate of spur node i of the last
+ * path found
+ * @param r the round
+ * @param s state of the calling thread
+ * @param i index of the spur node in the last path
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise, r->cand[i] being NULL if there is no candidate
+ *************************************************************/
+static status spur_search(Round * r, Spur * s, int i){
+    Path * last = r->found[r->nFound - 1];
+
+    /* avoid the root nodes and the roads the paths with the same root take */
+    if (++s->stamp == 0){
+        memset(s->mark, 0, (r->g->nCities + 1) * sizeof(unsigned));
+        s->stamp = 1;
+    }
+    for (int j = 0; j < i; j++) s->mark[last->nodes[j]] = s->stamp;
+    Avoid avoid = {s->mark, s->stamp, last->nodes[i], s->targets, 0};
+    for (int f = 0; f < r->nFound; f++){
+        Path * p = r->found[f];
+        if (p->nNodes > i + 1 && memcmp(p->nodes, last->nodes, (i + 1) * sizeof(int)) == 0)
+            s->targets[avoid.nTargets++] = p->nodes[i + 1];
+    }
+
+    SearchStats st;
+    status res = astar_avoiding(r->g, last->nodes[i], r->goal, &avoid, NULL, s->ws, &st);
+    s->st.expanded += st.expanded;
+    s->st.relaxed += st.relaxed;
+    s->st.reopened += st.reopened;
+    if (st.bytes > s->st.bytes) s->st.bytes = st.bytes;
+    r->cand[i] = NULL;
+    if (res == ERRNOPATH) return OK;
+    if (res != OK || extract_path(s->ws, s->buf) != OK) return ERRALLOC;
+    r->cand[i] = join_paths(last, i, s->buf);
+    return r->cand[i] ? OK : ERRALLOC;
+}
+
+
+/** private function run by every thread of a round: takes spur nodes until none is left **/
+static void * spur_worker(void * arg){
+    Worker * w = (Worker *)arg;
+    int i;
+    while ((i = atomic_fetch_add(&w->r->next, 1)) < w->r->nSpurs)
+        if (spur_search(w->r, w->spur, i) != OK) atomic_store(&w->r->failed, 1);
+    return NULL;
+}
+
+
+/** private function testing whether two paths go through the same nodes **/
+static int same_path(Path * a, Path * b){
+    return a->total == b->total && a->nNodes == b->nNodes
+        && memcmp(a->nodes, b->nodes, a->nNodes * sizeof(int)) == 0;
+}
+
+
+/*************************************************************
+ * Search the k shortest loopless paths from start to goal, with the
+ * spur searches of every round shared among threads
+ * @param g the graph
+ * @param start index of the start city
+ * @param goal index of the goal city
+ * @param k number of paths wanted
+ * @param nThreads number of threads, 0 for one per processor
+ * @param paths (out) array of k paths, shortest first, to destroy with delPath
+ * @param nPaths (out) number of paths found, fewer than k if there are no more
+ * @param st (out) statistics summed over all searches, may be NULL
+ * @return OK if at least one path was found
+ * @return ERRNOPATH if goal cannot be reached from start
+ * @return ERRINDEX if start or goal is not a node of the graph
+ * @return ERRALLOC if memory allocation failed (paths found so far are kept)
+ *************************************************************/
+status k_shortest_paths(Graph * g, int start, int goal, int k, int nThreads,
+                        Path ** paths, int * nPaths, SearchStats * st){
+    *nPaths = 0;
+    if (start < 0 || start >= g->nCities || goal < 0 || goal >= g->nCities) return ERRINDEX;
+    if (k < 1) return OK;
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads < 1) nThreads = 1;
+    double t0 = search_clock();
+
+    Spur ** spurs = (Spur **) calloc(nThreads, sizeof(Spur *));
+    Worker * workers = (Worker *) malloc(nThreads * sizeof(Worker));
+    pthread_t * threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
+    Path ** cand = (Path **) malloc((g->nCities + 1) * sizeof(Path *));
+    Path ** pending = NULL;
+    int nPending = 0, maxPending = 0;
+    status res = ERRALLOC;
+    if (!spurs || !workers || !threads || !cand) goto done;
+    for (int t = 0; t < nThreads; t++){
+        spurs[t] = newSpur(g, k);
+        if (!spurs[t] || !spurs[t]->ws || !spurs[t]->buf || !spurs[t]->mark || !spurs[t]->targets) goto done;
+    }
+
+    /* the first path is the shortest one */
+    res = astar(g, start, goal, NULL, spurs[0]->ws, &spurs[0]->st);
+    if (res != OK) goto done;
+    if (extract_path(spurs[0]->ws, spurs[0]->buf) != OK || !(paths[0] = join_paths(spurs[0]->buf, 0, spurs[0]->buf))){
+        res = ERRALLOC;
+        goto done;
+    }
+    *nPaths = 1;
+
+    while (*nPaths < k){
+        Round r = {g, goal, paths, *nPaths, cand, paths[*nPaths - 1]->nNodes - 1};
+        atomic_init(&r.next, 0);
+        atomic_init(&r.failed, 0);
+
+        /* threads are only worth starting for several spur searches */
+        int started = 1;
+        for (int t = 0; t < nThreads; t++){
+            workers[t].r = &r;
+            workers[t].spur = spurs[t];
+        }
+        while (started < nThreads && started < r.nSpurs &&
+               pthread_create(&threads[started], NULL, spur_worker, &workers[started]) == 0)
+            started++;
+        spur_worker(&workers[0]);
+        for (int t = 1; t < started; t++) pthread_join(threads[t], NULL);
+
+        /* candidates in spur order, so the result does not depend on the threads */
+        for (int i = 0; i < r.nSpurs; i++){
+            if (!cand[i]) continue;
+            int dup = 0;
+            for (int j = 0; j < nPending && !dup; j++) dup = same_path(cand[i], pending[j]);
+            if (dup){
+                delPath(cand[i]);
+                continue;
+            }
+            if (nPending == maxPending){
+                maxPending = maxPending ? 2 * maxPending : 64;
+                Path ** bigger = (Path **) realloc(pending, maxPending * sizeof(Path *));
+                if (!bigger){
+                    for (; i < r.nSpurs; i++) delPath(cand[i]);
+                    atomic_store(&r.failed, 1);
+                    break;
+                }
+                pending = bigger;
+            }
+            pending[nPending++] = cand[i];
+        }
+        if (atomic_load(&r.failed)){
+            res = ERRALLOC;
+            goto done;
+        }
+        if (nPending == 0) break;
+
+        /* the cheapest candidate (the first one on ties) is the next path */
+        int best = 0;
+        for (int j = 1; j < nPending; j++)
+            if (pending[j]->total < pending[best]->total) best = j;
+        paths[(*nPaths)++] = pending[best];
+        memmove(pending + best, pending + best + 1, (nPending - best - 1) * sizeof(Path *));
+        nPending--;
+    }
+    res = OK;
+
+done:
+    if (st){
+        memset(st, 0, sizeof(SearchStats));
+        for (int t = 0; spurs && t < nThreads; t++){
+            if (!spurs[t]) continue;
+            st->expanded += spurs[t]->st.expanded;
+            st->relaxed += spurs[t]->st.relaxed;
+            st->reopened += spurs[t]->st.reopened;
+            st->bytes += spurs[t]->st.bytes;
+        }
+        st->seconds = search_clock() - t0;
+    }
+    for (int t = 0; spurs && t < nThreads; t++) delSpur(spurs[t]);
+    for (int j = 0; j < nPending; j++) delPath(pending[j]);
+    free(pending);
+    free(spurs);
+    free(workers);
+    free(threads);
+    free(cand);
+    return res;
+}
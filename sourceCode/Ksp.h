@@ -0,0 +1,19 @@
+//
+//  Ksp.h
+//  Astar
+//
+//  K shortest loopless paths between two cities (Yen's algorithm), as
+//  alternatives to the shortest one.
+//
+
+#ifndef Ksp_h
+#define Ksp_h
+
+#include "Graph.h"
+#include "Search.h"
+#include "Path.h"
+
+/** Search the k shortest loopless paths from start to goal **/
+status k_shortest_paths(Graph *, int, int, int, int, Path **, int *, SearchStats *);
+
+#endif /* Ksp_h */
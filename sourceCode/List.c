@@ -15,11 +15,15 @@
 
 #include <stdio.h>
 #include "List.h"
+#include "Memory.h"
 
 /** stores the list of available Nodes instead of deallocating / reallocating
  * them all the time */
 static Node* available = 0;
 
+/** number of Nodes in the available list */
+static int nAvailable = 0;
+
 
 
 /** Empty List creation by dynamic memory allocation (O(1)).
@@ -31,7 +35,7 @@ static Node* available = 0;
 
 List * newList (compFun comp, prFun pr) {
     List * l;
-    l = (List*) malloc(sizeof(List));
+    l = (List*) mem_alloc(MEM_LISTS, sizeof(List));
     if (! l) return 0;
     l->nelts	= 0;
     l->head	= 0;
@@ -49,6 +53,7 @@ void delList (List* l) {
         l->head = tmp->next;
         tmp->next = available;
         available = tmp;
+        nAvailable++;
         tmp = l->head;
     }
     
@@ -56,7 +61,7 @@ void delList (List* l) {
     
     l->head = 0;
     l->nelts = 0;
-    free(l);
+    mem_free(MEM_LISTS, l, sizeof(List));
 }
 
 
@@ -93,8 +98,8 @@ status addListAt (List* l, int pos, void* elt) {
         
         /* get a new Node and increment length */
         Node * toAdd = available;
-        if (!toAdd) toAdd = (Node*) malloc(sizeof(Node));
-        else available = available->next;
+        if (!toAdd) toAdd = (Node*) mem_alloc(MEM_LIST_NODES, sizeof(Node));
+        else { available = available->next; nAvailable--; }
         if (!toAdd) return ERRALLOC;
         l->nelts++;
         toAdd->val = elt;
@@ -149,6 +154,7 @@ status remFromListAt	(List* l,int pos, void** res) {
     *res = toRem->val;
     toRem->next = available;
     available = toRem;
+    nAvailable++;
     l->nelts--;
     return OK;
 }
@@ -188,6 +194,7 @@ status remFromList (List* l, void* elt) {
         prec->next = toRem->next;
         toRem->next = available;
         available = toRem;
+        nAvailable++;
         //free(toRem);
         l->nelts--;
         return OK;
@@ -234,6 +241,25 @@ void forEach (List* l, void(*f)(void*)) {
 int lengthList (List* l) { return l->nelts; }
 
 
+/** compute and return the number of Nodes kept for reuse by all lists (O(1)).
+ * @return the number of available Nodes
+ */
+int lengthAvailable (void) { return nAvailable; }
+
+
+/** give the Nodes kept for reuse back to the system (O(N)).
+ * The next insertions in any list will allocate new Nodes.
+ */
+void freeAvailable (void) {
+    while (available) {
+        Node * tmp = available;
+        available = tmp->next;
+        mem_free(MEM_LIST_NODES, tmp, sizeof(Node));
+    }
+    nAvailable = 0;
+}
+
+
 /** private function to get the node preceding the one we're looking for
  * @param e the searched element
  * @return 0 if element is not found (typically, list is empty)
@@ -280,8 +306,8 @@ status addList (List* l, void* e) {
         prec = prec->next;
     
     toAdd = available;
-    if (!toAdd) toAdd = (Node*) malloc(sizeof(Node));
-    else available = available->next;
+    if (!toAdd) toAdd = (Node*) mem_alloc(MEM_LIST_NODES, sizeof(Node));
+    else { available = available->next; nAvailable--; }
     if (!toAdd) return ERRALLOC;
     toAdd->next = prec->next;
     toAdd->val = e;
@@ -307,3 +333,55 @@ Node* isInList (List* l, void* e) {
         return prec;
     return 0;
 }
+
+
+/** private function to merge two sorted chains of nodes into one
+ * @param a the first chain
+ * @param b the second chain
+ * @param comp the comparison function
+ * @return the head of the merged chain (stable: a first on ties)
+ */
+static Node* merge(Node* a, Node* b, compFun comp) {
+    Node head, *tail = &head;
+    while (a && b) {
+        if ((comp)(b->val,a->val) < 0) { tail->next = b; b = b->next; }
+        else { tail->next = a; a = a->next; }
+        tail = tail->next;
+    }
+    tail->next = a ? a : b;
+    return head.next;
+}
+
+
+/** sort list elements according to compFun function (O(N log N)).
+ * Useful to build a sorted list by cheap insertions at the head followed
+ * by a single sort, instead of repeated addList calls (O(N) each).
+ * @param l the list
+ * @return ERRUNABLE if no comparison function has been provided
+ * @return OK otherwise
+ */
+status sortList (List* l) {
+    Node *runs[64] = { 0 };
+    Node *tmp = l->head;
+    int i;
+    
+    if (l->comp == 0) return ERRUNABLE;
+    
+    /* bottom-up merge sort: runs[i] holds a sorted chain of 2^i nodes */
+    while (tmp) {
+        Node * carry = tmp;
+        tmp = tmp->next;
+        carry->next = 0;
+        for (i = 0; runs[i]; i++) {
+            carry = merge(runs[i], carry, l->comp);
+            runs[i] = 0;
+        }
+        runs[i] = carry;
+    }
+    
+    tmp = 0;
+    for (i = 0; i < 64; i++)
+        if (runs[i]) tmp = merge(runs[i], tmp, l->comp);
+    l->head = tmp;
+    return OK;
+}
@@ -68,10 +68,19 @@ void	forEach		(List*,void(*)(void*));
 /* compute and return the number of elements in given list */
 int	lengthList	(List*);
 
+/* compute and return the number of Nodes kept for reuse by all lists */
+int	lengthAvailable	(void);
+
+/* give the Nodes kept for reuse back to the system */
+void	freeAvailable	(void);
+
 /* add given element to given list according to compFun function */
 status	addList	(List*,void*);
 
 /* test whether the list contains given element */
 Node*	isInList	(List*,void*);
 
+/* sort list elements according to compFun function */
+status	sortList	(List*);
+
 #endif
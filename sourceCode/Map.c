@@ -7,11 +7,17 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 #include "Map.h"
+#include "Trace.h"
+#include "Memory.h"
 
 /** constant infinity number set to 9999 **/
 int infinity = 9999;
 
+/** when set (Astar -v), map_to_list displays every city it has read **/
+int verbose_load = 0;
+
 
 /*************************************************************
  * Part of the estimation function of cost, to calculate the estimated distance from current city to goal city
@@ -117,11 +123,13 @@ void prNeighbours(void * e){
  * @return the initialized city, with distanceFromStart of infinity
  *************************************************************/
 City * init_City(char* name, int lat, int lgt){
-    City * c = (City *) malloc(sizeof(City));
+    City * c = (City *) mem_alloc(MEM_CITIES, sizeof(City));
     strcpy(c->name,name);
     c->lat = lat;
     c->lgt = lgt;
     c->distFromStart = infinity;
+    c->ptr = NULL;
+    c->id = -1;
     c->neighbours = newList(compDistance, prCities);
     c->neighbours->comp=compDistance;
     return c;
@@ -136,7 +144,7 @@ City * init_City(char* name, int lat, int lgt){
  *************************************************************/
 neighbour * init_neighbour(City * city, int distance){
     
-    neighbour * n = (neighbour *) malloc(sizeof(neighbour));
+    neighbour * n = (neighbour *) mem_alloc(MEM_NEIGHBOURS, sizeof(neighbour));
     n->city = city;
     n->distance = distance;
     return n;
@@ -165,8 +173,53 @@ City * find_city(List * l,char name[20]){
 }
 
 
+/** Name index used while reading a map: open addressing table of cities **/
+typedef struct NameIndex{
+    int size;
+    int count;
+    City ** slots;
+}NameIndex;
+
+
+/** private function hashing a city name (FNV-1a) **/
+static unsigned hash_name(char * name){
+    unsigned h = 2166136261u;
+    while (*name) h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h;
+}
+
+
+/** private function returning the slot of the given name: either the slot
+ * holding that city or the empty slot where it would be inserted **/
+static City ** index_slot(NameIndex * idx, char * name){
+    unsigned i = hash_name(name) & (idx->size - 1);
+    while (idx->slots[i] && strcmp(idx->slots[i]->name, name) != 0)
+        i = (i + 1) & (idx->size - 1);
+    return &idx->slots[i];
+}
+
+
+/** private function adding a city to the index, doubling the table when half full **/
+static status index_add(NameIndex * idx, City * c){
+    if (2 * (idx->count + 1) > idx->size){
+        NameIndex bigger = {idx->size ? 2 * idx->size : 1024, 0, NULL};
+        bigger.slots = (City **) mem_calloc(MEM_CITIES, bigger.size, sizeof(City *));
+        if (!bigger.slots) return ERRALLOC;
+        for (int i = 0; i < idx->size; i++)
+            if (idx->slots[i]) index_add(&bigger, idx->slots[i]);
+        mem_free(MEM_CITIES, idx->slots, idx->size * sizeof(City *));
+        *idx = bigger;
+    }
+    *index_slot(idx, c->name) = c;
+    idx->count++;
+    return OK;
+}
+
+
 /*************************************************************
  * From the given map filename, store the corresponding file into a map implemented by a list of cities with lists of neighbours
+ * Cities are looked up by name through a hash index while reading and
+ * the list is sorted once at the end, so loading is O(N log N).
  * @param filepath filepath of the file to be read
  * @return a list of cities read from the file 
  * @return NULL if error
@@ -177,24 +230,29 @@ List * map_to_list(char filepath[200]){
     FILE * fPointer;
     fPointer = fopen(filepath, "r");
     if (!fPointer) return NULL;
+    TRACE_POINT(TRACE_LOAD_BEGIN, 0, 0);
     char str_1[20];
     int num_1;
     int num_2;
-    City * tmp_city = (City *)malloc(sizeof(City));
+    City * tmp_city = NULL;
     List * all_cities = newList(compString, prCities);
+    NameIndex index = {0, 0, NULL};
     
     rewind(fPointer);
     int nItems = 0;
     
     while(nItems!=-1){
         
-        nItems = fscanf(fPointer,"%s %d %d\n", str_1, &num_1, &num_2);
-        City * existing = find_city(all_cities, str_1);
+        nItems = fscanf(fPointer,"%19s %d %d\n", str_1, &num_1, &num_2);
+        if (nItems < 2) continue;
+        City * existing = index.count ? *index_slot(&index, str_1) : NULL;
         
         if (nItems == 3){
             if(existing == 0){
                 tmp_city = init_City(str_1, num_1, num_2);
-                addList(all_cities, tmp_city);
+                addListAt(all_cities, 1, tmp_city);
+                index_add(&index, tmp_city);
+                TRACE_POINT(TRACE_CITY, index.count, 0);
             }else{
                 tmp_city = existing;
                 tmp_city->lat = num_1;
@@ -202,11 +260,13 @@ List * map_to_list(char filepath[200]){
             }
         }
         
-        else if (nItems == 2){
-            neighbour * tmp_nb = (neighbour *)malloc(sizeof(neighbour));
+        else if (nItems == 2 && tmp_city){
+            neighbour * tmp_nb;
             if (existing==0){
                 City * nb_city = init_City(str_1, -1, -1); //if city is not inside list yet, initial a temp one
-                addList(all_cities, nb_city);
+                addListAt(all_cities, 1, nb_city);
+                index_add(&index, nb_city);
+                TRACE_POINT(TRACE_CITY, index.count, 0);
                 tmp_nb = init_neighbour(nb_city,num_1);
                 addList(tmp_city->neighbours, tmp_nb);//add the read neighbour to list of neighbours
                 
@@ -218,10 +278,37 @@ List * map_to_list(char filepath[200]){
     }
     
     fclose(fPointer);
-    puts("For Each: cityname, lat, lgt, number of neighbours\n");
-    forEach(all_cities, prCities);
+    mem_free(MEM_CITIES, index.slots, index.size * sizeof(City *));
+    sortList(all_cities);
+    
+    /* number the cities in list order, so they can be addressed by index */
+    int id = 0;
+    for (Node * cur = all_cities->head; cur; cur = cur->next)
+        ((City *)cur->val)->id = id++;
+    TRACE_POINT(TRACE_LOAD_END, id, 0);
+    
+    if (verbose_load){
+        puts("For Each: cityname, lat, lgt, number of neighbours\n");
+        forEach(all_cities, prCities);
+    }
     
     return all_cities;
 }
 
 
+/*************************************************************
+ * Destroy a list of cities returned by map_to_list, with their lists of
+ * neighbours, and give the nodes of the lists back to the system
+ * @param all_cities the list of cities
+ *************************************************************/
+void delCities(List * all_cities){
+    if (!all_cities) return;
+    for (Node * cur = all_cities->head; cur; cur = cur->next){
+        City * c = (City *)cur->val;
+        for (Node * nb = c->neighbours->head; nb; nb = nb->next) mem_free(MEM_NEIGHBOURS, nb->val, sizeof(neighbour));
+        delList(c->neighbours);
+        mem_free(MEM_CITIES, c, sizeof(City));
+    }
+    delList(all_cities);
+    freeAvailable();
+}
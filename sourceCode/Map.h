@@ -20,6 +20,7 @@ typedef struct City{
     int lgt;
     struct City * ptr;
     List * neighbours;
+    int id;
 }City;
 
 /** Neighbour structure: neighbour city with its distance from current city **/
@@ -28,6 +29,9 @@ typedef struct neighbour{
     int distance;
 }neighbour;
 
+/** When set, map_to_list displays every city it has read (off by default, -v) **/
+extern int verbose_load;
+
 /** Part of the estimation function of cost, to calculate the estimated distance from current city to goal city **/
 int h_of_n(City *, City *);
 
@@ -64,4 +68,7 @@ City * find_city(List * l, char[20]);
 /** From the given map filename, store the corresponding file into a map implemented by a list of cities with lists of neighbours **/
 List * map_to_list(char [200]);
 
+/** Destroy a list of cities returned by map_to_list **/
+void delCities(List *);
+
 #endif /* Map_h */
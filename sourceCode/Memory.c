@@ -0,0 +1,167 @@
+//
+//  Memory.c
+//  Astar
+//
+//  Accounting of the memory allocated by the map, the lists, the graphs
+//  and the A* searches, by category.
+//
+//  Allocations go through wrappers that count the bytes and objects of
+//  their category. Callers give the size back when they free or resize, so
+//  no header is added to the blocks (list nodes are 16 bytes). Counters are
+//  atomic, as searches allocate from several threads; peaks are raised with
+//  compare-and-swap, the peak of MEM_ALL being the most memory used at
+//  once, not the sum of the peaks.
+//
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "Memory.h"
+#include "List.h"
+
+/** Counters of a category **/
+typedef struct Counter{
+    atomic_size_t bytes;
+    atomic_size_t peak;
+    atomic_long objects;
+}Counter;
+
+static Counter counters[MEM_ALL + 1];
+
+static const char * names[] = {"cities", "neighbours", "lists", "list nodes", "graph", "OPEN", "CLOSED", "caches", "total"};
+
+
+/** private function raising a peak to the given number of bytes **/
+static void raise_peak(atomic_size_t * peak, size_t bytes){
+    size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (bytes > seen && !atomic_compare_exchange_weak_explicit(peak, &seen, bytes,
+                                                                  memory_order_relaxed, memory_order_relaxed));
+}
+
+
+/** private function counting bytes and objects allocated (or freed, when negative) **/
+static void account(memCategory c, size_t bytes, int grow, long objects){
+    for (int k = 0; k < 2; k++){
+        Counter * cnt = &counters[k ? MEM_ALL : c];
+        atomic_fetch_add_explicit(&cnt->objects, objects, memory_order_relaxed);
+        if (!grow){
+            atomic_fetch_sub_explicit(&cnt->bytes, bytes, memory_order_relaxed);
+            continue;
+        }
+        size_t now = atomic_fetch_add_explicit(&cnt->bytes, bytes, memory_order_relaxed) + bytes;
+        raise_peak(&cnt->peak, now);
+    }
+}
+
+
+/*************************************************************
+ * Allocate memory on behalf of a category, like malloc
+ * @param c the category
+ * @param size number of bytes
+ * @return the memory, NULL if allocation failed
+ *************************************************************/
+void * mem_alloc(memCategory c, size_t size){
+    void * p = malloc(size);
+    if (p) account(c, size, 1, 1);
+    return p;
+}
+
+
+/*************************************************************
+ * Allocate zeroed memory on behalf of a category, like calloc
+ * @param c the category
+ * @param n number of elements
+ * @param size size of an element
+ * @return the memory, NULL if allocation failed
+ *************************************************************/
+void * mem_calloc(memCategory c, size_t n, size_t size){
+    void * p = calloc(n, size);
+    if (p) account(c, n * size, 1, 1);
+    return p;
+}
+
+
+/*************************************************************
+ * Resize memory of a category, like realloc
+ * @param c the category
+ * @param p the memory, NULL to allocate
+ * @param oldSize its current size
+ * @param size the new size
+ * @return the resized memory, NULL if allocation failed (p is kept)
+ *************************************************************/
+void * mem_realloc(memCategory c, void * p, size_t oldSize, size_t size){
+    void * q = realloc(p, size);
+    if (!q) return NULL;
+    if (!p) account(c, size, 1, 1);
+    else if (size >= oldSize) account(c, size - oldSize, 1, 0);
+    else account(c, oldSize - size, 0, 0);
+    return q;
+}
+
+
+/*************************************************************
+ * Free memory of a category
+ * @param c the category
+ * @param p the memory, may be NULL
+ * @param size its size, as allocated or last resized
+ *************************************************************/
+void mem_free(memCategory c, void * p, size_t size){
+    if (!p) return;
+    free(p);
+    account(c, size, 0, -1);
+}
+
+
+/*************************************************************
+ * Count memory of a category that was not obtained from these wrappers,
+ * such as a mapped segment, as one object
+ * @param c the category
+ * @param size its size
+ * @param grow 1 when it is obtained, 0 when it is given back
+ *************************************************************/
+void mem_track(memCategory c, size_t size, int grow){
+    account(c, size, grow, grow ? 1 : -1);
+}
+
+
+/*************************************************************
+ * Memory used by a category
+ * @param c the category, MEM_ALL for all of them
+ * @param u (out) bytes and objects allocated now, and peak bytes
+ *************************************************************/
+void mem_usage(memCategory c, MemUsage * u){
+    u->bytes = atomic_load(&counters[c].bytes);
+    u->peak = atomic_load(&counters[c].peak);
+    u->objects = atomic_load(&counters[c].objects);
+}
+
+
+/** Name of a category, "total" for MEM_ALL **/
+const char * mem_name(memCategory c){
+    return names[c];
+}
+
+
+/*************************************************************
+ * Restart the peaks from the memory used now, to measure the peak of
+ * one phase (a query, say) after the map is loaded
+ *************************************************************/
+void mem_reset_peaks(void){
+    for (int c = 0; c <= MEM_ALL; c++)
+        atomic_store(&counters[c].peak, atomic_load(&counters[c].bytes));
+}
+
+
+/*************************************************************
+ * Display the memory used by every category, with the list nodes kept for
+ * reuse by the lists (still allocated, so counted in "list nodes")
+ * @param out where to write
+ *************************************************************/
+void mem_report(FILE * out){
+    MemUsage u;
+    fprintf(out, "%-12s %14s %14s %10s\n", "memory", "bytes", "peak bytes", "objects");
+    for (int c = 0; c <= MEM_ALL; c++){
+        mem_usage(c, &u);
+        fprintf(out, "%-12s %14zu %14zu %10ld\n", names[c], u.bytes, u.peak, u.objects);
+    }
+    fprintf(out, "%d list nodes available for reuse\n", lengthAvailable());
+}
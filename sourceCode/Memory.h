@@ -0,0 +1,63 @@
+//
+//  Memory.h
+//  Astar
+//
+//  Accounting of the memory allocated by the map, the lists, the graphs
+//  and the A* searches, by category.
+//
+
+#ifndef Memory_h
+#define Memory_h
+
+#include <stdio.h>
+#include <stddef.h>
+
+/** What an allocation is for; MEM_ALL stands for all of them together **/
+typedef enum{
+    MEM_CITIES,
+    MEM_NEIGHBOURS,
+    MEM_LISTS,
+    MEM_LIST_NODES,
+    MEM_GRAPH,
+    MEM_OPEN,
+    MEM_CLOSED,
+    MEM_CACHES,
+    MEM_ALL
+}memCategory;
+
+/** Memory of a category: bytes and objects allocated now, and the most
+ * bytes allocated at once since the start (or the last mem_reset_peaks) **/
+typedef struct MemUsage{
+    size_t bytes;
+    size_t peak;
+    long objects;
+}MemUsage;
+
+/** Allocate memory on behalf of a category, like malloc **/
+void * mem_alloc(memCategory, size_t);
+
+/** Allocate zeroed memory on behalf of a category, like calloc **/
+void * mem_calloc(memCategory, size_t, size_t);
+
+/** Resize memory of a category, given its current size, like realloc **/
+void * mem_realloc(memCategory, void *, size_t, size_t);
+
+/** Free memory of a category, given its size **/
+void mem_free(memCategory, void *, size_t);
+
+/** Count memory of a category obtained otherwise (mapped), or given back **/
+void mem_track(memCategory, size_t, int);
+
+/** Memory used by a category, or by all of them with MEM_ALL **/
+void mem_usage(memCategory, MemUsage *);
+
+/** Name of a category **/
+const char * mem_name(memCategory);
+
+/** Restart the peaks from the memory used now **/
+void mem_reset_peaks(void);
+
+/** Display the memory used by every category **/
+void mem_report(FILE *);
+
+#endif /* Memory_h */
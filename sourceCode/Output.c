@@ -0,0 +1,455 @@
+//
+//  Output.c
+//  Astar
+//
+//  Results formatted into one buffer and written with a single fwrite when
+//  it is full, instead of a printf per city: numbers are converted by hand
+//  and names copied, so a batch of thousands of paths costs a few writes.
+//
+//  Formats, one record per answer or per node of a tree:
+//    human   the text of Astar: "1) Rennes->Nantes->Lyon", "Total distance: 825"
+//    csv     query,start,goal,status,distance,path  (path: names joined by ';')
+//            city,distance,parent                   (trees)
+//            origin,city,distance,parent            (ranges)
+//            a field holding ',', ';', '"' or a line break is quoted (RFC 4180)
+//    json    one object per line: {"query":1,"start":"Rennes",...,"path":[...]}
+//    binary  native ints and byte order: "AOR1", "AOT1" or "AOI1", then
+//            records of query, status, start, goal, distance, nNodes,
+//            nodes[nNodes], of node, distance, parent or of origin, node,
+//            distance, parent (-1 for none, cities by number)
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "Output.h"
+#include "Sssp.h"
+
+static char * formats[] = {"human", "csv", "json", "binary"};
+
+
+/*************************************************************
+ * Format named by a string
+ * @param name human, csv, json or binary
+ * @return the format
+ * @return -1 if the name is none of them
+ *************************************************************/
+int parse_format(char * name){
+    for (int i = 0; i < 4; i++)
+        if (strcmp(name, formats[i]) == 0) return i;
+    return -1;
+}
+
+
+/*************************************************************
+ * Create a writer
+ * @param f the file to write to
+ * @param fmt the format of the records
+ * @param bytes size of the buffer, 0 for OUT_BUFFER
+ * @return the writer, to destroy with delWriter
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Writer * newWriter(FILE * f, format fmt, size_t bytes){
+    Writer * w = (Writer *) malloc(sizeof(Writer));
+    if (!w) return NULL;
+    w->cap = bytes >= 256 ? bytes : bytes ? 256 : OUT_BUFFER;
+    w->buf = (char *) malloc(w->cap);
+    if (!w->buf){
+        free(w);
+        return NULL;
+    }
+    w->f = f;
+    w->fmt = fmt;
+    w->len = 0;
+    w->header = 0;
+    w->err = OK;
+    return w;
+}
+
+
+/*************************************************************
+ * Write the bytes kept so far to the file, after what was written to it
+ * with stdio
+ * @param w the writer
+ * @return OK
+ * @return ERRCLOSE if the file refused some bytes (now or before)
+ *************************************************************/
+status flush_writer(Writer * w){
+    if (w->len && fwrite(w->buf, 1, w->len, w->f) != w->len) w->err = ERRCLOSE;
+    w->len = 0;
+    if (fflush(w->f) != 0) w->err = ERRCLOSE;
+    return w->err;
+}
+
+
+/*************************************************************
+ * Write what is left and destroy a writer
+ * @param w the writer, or NULL
+ * @return OK
+ * @return ERRCLOSE if some bytes could not be written
+ *************************************************************/
+status delWriter(Writer * w){
+    if (!w) return OK;
+    status s = flush_writer(w);
+    free(w->buf);
+    free(w);
+    return s;
+}
+
+
+/** private function making room for n more bytes (n at most 256) **/
+static inline char * room(Writer * w, size_t n){
+    if (w->len + n > w->cap){
+        if (fwrite(w->buf, 1, w->len, w->f) != w->len) w->err = ERRCLOSE;
+        w->len = 0;
+    }
+    return w->buf + w->len;
+}
+
+static inline void put_char(Writer * w, char c){
+    *room(w, 1) = c;
+    w->len++;
+}
+
+/** private function writing a short string (a name, a word) **/
+static void put_str(Writer * w, const char * s){
+    size_t n = strlen(s);
+    memcpy(room(w, n), s, n);
+    w->len += n;
+}
+
+/** private function writing an int in decimal **/
+static void put_int(Writer * w, int v){
+    char tmp[12];
+    int k = 0;
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    do tmp[k++] = '0' + u % 10; while (u /= 10);
+    char * p = room(w, 12);
+    if (v < 0) *p++ = '-';
+    while (k) *p++ = tmp[--k];
+    w->len = p - w->buf;
+}
+
+/** private function writing an int in binary **/
+static void put_bin(Writer * w, int v){
+    memcpy(room(w, sizeof(int)), &v, sizeof(int));
+    w->len += sizeof(int);
+}
+
+/** private function writing a name as a JSON string (names are short) **/
+static void put_json(Writer * w, const char * s){
+    put_char(w, '"');
+    for (; *s; s++){
+        if (*s == '"' || *s == '\\') put_char(w, '\\');
+        if ((unsigned char)*s >= ' ') put_char(w, *s);
+    }
+    put_char(w, '"');
+}
+
+/** private function testing whether a name must be quoted in a CSV field;
+ * ';' is included as it separates the names of a path **/
+static int csv_quoted(const char * s){
+    return strpbrk(s, ",;\"\r\n") != NULL;
+}
+
+/** private function writing a name inside a quoted CSV field, quotes doubled **/
+static void put_csv_inside(Writer * w, const char * s){
+    for (; *s; s++){
+        if (*s == '"') put_char(w, '"');
+        put_char(w, *s);
+    }
+}
+
+/** private function writing a name as a CSV field, quoted if needed **/
+static void put_csv(Writer * w, const char * s){
+    if (!csv_quoted(s)){
+        put_str(w, s);
+        return;
+    }
+    put_char(w, '"');
+    put_csv_inside(w, s);
+    put_char(w, '"');
+}
+
+/** private function writing a place: the name of node u or, if it is not a
+ * node (-1), the name typed for it, or the absence of one **/
+static void put_place(Writer * w, Graph * g, int u, const char * typed){
+    char buf[20];
+    const char * name = u >= 0 ? city_name(g, u, buf) : typed;
+    if (w->fmt == FORMAT_JSON){
+        if (!name) put_str(w, "null");
+        else put_json(w, name);
+    }
+    else if (name){
+        if (w->fmt == FORMAT_CSV) put_csv(w, name);
+        else put_str(w, name);
+    }
+}
+
+/** private function writing the name of a node, or the absence of one **/
+static void put_node(Writer * w, Graph * g, int u){
+    put_place(w, g, u, NULL);
+}
+
+/** private function writing a path as one CSV field, names joined by ';',
+ * the whole field quoted if one of them needs it **/
+static void put_csv_path(Writer * w, Graph * g, Path * path){
+    char buf[20];
+    int quoted = 0;
+    for (int i = 0; !quoted && i < path->nNodes; i++) quoted = csv_quoted(city_name(g, path->nodes[i], buf));
+    if (quoted) put_char(w, '"');
+    for (int i = 0; i < path->nNodes; i++){
+        if (i) put_char(w, ';');
+        if (quoted) put_csv_inside(w, city_name(g, path->nodes[i], buf));
+        else put_str(w, city_name(g, path->nodes[i], buf));
+    }
+    if (quoted) put_char(w, '"');
+}
+
+/** private function writing a distance, or the absence of one **/
+static void put_distance(Writer * w, int d){
+    if (d != UNREACHED) put_int(w, d);
+    else if (w->fmt == FORMAT_JSON) put_str(w, "null");
+}
+
+/** private name of the outcome of a query in the structured formats **/
+static const char * outcome(status res){
+    switch (res){
+        case OK: return "ok";
+        case ERRBUDGET: return "budget";
+        case ERRNOPATH: return "nopath";
+        case ERRABSENT: return "absent";
+        default: return "error";
+    }
+}
+
+
+/*************************************************************
+ * Text for people, such as the titles of the results of Astar; the
+ * other formats only hold records
+ * @param w the writer
+ * @param text the text
+ *************************************************************/
+void write_text(Writer * w, const char * text){
+    if (w->fmt != FORMAT_HUMAN) return;
+    while (*text){
+        size_t n = strlen(text);
+        if (n > 256) n = 256;
+        memcpy(room(w, n), text, n);
+        w->len += n;
+        text += n;
+    }
+}
+
+
+/*************************************************************
+ * Header of the records of a kind: the names of the columns in CSV, a
+ * magic number in binary. Written once, so a writer sharing a file with
+ * others (workers) may skip it.
+ * @param w the writer
+ * @param kind the kind of the records to follow
+ *************************************************************/
+void write_header(Writer * w, record kind){
+    if (w->header) return;
+    w->header = 1;
+    static const char * columns[] = {"query,start,goal,status,distance,path\n", "city,distance,parent\n",
+                                     "origin,city,distance,parent\n"};
+    static const char * magic[] = {"AOR1", "AOT1", "AOI1"};
+    if (w->fmt == FORMAT_CSV) put_str(w, columns[kind]);
+    else if (w->fmt == FORMAT_BINARY) put_str(w, magic[kind]);
+}
+
+
+/*************************************************************
+ * Record of the answer of a query. In human form, a numbered query shows
+ * its number and outcome before the path, a single query (number 0) the
+ * path alone, its outcome having been told by write_text. An unknown
+ * start or goal is written in CSV and JSON as the name typed for it.
+ * @param w the writer
+ * @param g the graph searched
+ * @param query number of the query, from 1, or 0 for a single query
+ * @param start start node, -1 if unknown
+ * @param goal goal node, -1 if unknown
+ * @param startName name typed for an unknown start, or NULL
+ * @param goalName name typed for an unknown goal, or NULL
+ * @param res outcome: OK, ERRBUDGET (partial path), ERRNOPATH or another error
+ * @param distance the distance when path is NULL, UNREACHED for none
+ * @param path the path found (or partial), or NULL
+ *************************************************************/
+void write_route(Writer * w, Graph * g, int query, int start, int goal, const char * startName,
+                 const char * goalName, status res, int distance, Path * path){
+    char buf[20];
+    if (path) distance = path->total;
+    else if (res != OK) distance = UNREACHED;
+    int hasPath = path && (res == OK || res == ERRBUDGET);
+
+    switch (w->fmt){
+        case FORMAT_HUMAN:
+            if (query > 0){
+                put_int(w, query);
+                put_str(w, ") ");
+                if (res == ERRBUDGET){
+                    put_str(w, message(res));
+                    put_str(w, ", best partial path: ");
+                }
+            }
+            if (res == OK || res == ERRBUDGET){
+                if (!hasPath){
+                    put_distance(w, distance);
+                    put_char(w, '\n');
+                    break;
+                }
+                for (int i = 0; i < path->nNodes; i++){
+                    put_str(w, city_name(g, path->nodes[i], buf));
+                    put_str(w, i + 1 < path->nNodes ? "->" : "\n");
+                }
+                put_str(w, "Total distance: ");
+                put_int(w, path->total);
+                put_char(w, '\n');
+            }
+            else {
+                put_str(w, res == ERRNOPATH ? "failure" : message(res));
+                put_char(w, '\n');
+            }
+            break;
+
+        case FORMAT_CSV:
+            put_int(w, query > 0 ? query : 1);
+            put_char(w, ',');
+            put_place(w, g, start, startName);
+            put_char(w, ',');
+            put_place(w, g, goal, goalName);
+            put_char(w, ',');
+            put_str(w, outcome(res));
+            put_char(w, ',');
+            put_distance(w, distance);
+            put_char(w, ',');
+            if (hasPath) put_csv_path(w, g, path);
+            put_char(w, '\n');
+            break;
+
+        case FORMAT_JSON:
+            put_str(w, "{\"query\":");
+            put_int(w, query > 0 ? query : 1);
+            put_str(w, ",\"start\":");
+            put_place(w, g, start, startName);
+            put_str(w, ",\"goal\":");
+            put_place(w, g, goal, goalName);
+            put_str(w, ",\"status\":\"");
+            put_str(w, outcome(res));
+            put_str(w, "\",\"distance\":");
+            put_distance(w, distance);
+            if (hasPath){
+                put_str(w, ",\"path\":[");
+                for (int i = 0; i < path->nNodes; i++){
+                    if (i) put_char(w, ',');
+                    put_node(w, g, path->nodes[i]);
+                }
+                put_char(w, ']');
+            }
+            put_str(w, "}\n");
+            break;
+
+        case FORMAT_BINARY:
+            put_bin(w, query > 0 ? query : 1);
+            put_bin(w, res);
+            put_bin(w, start);
+            put_bin(w, goal);
+            put_bin(w, distance == UNREACHED ? -1 : distance);
+            put_bin(w, hasPath ? path->nNodes : 0);
+            for (int i = 0; hasPath && i < path->nNodes; i++) put_bin(w, path->nodes[i]);
+            break;
+    }
+}
+
+
+/*************************************************************
+ * Record of a node of a shortest path tree
+ * @param w the writer
+ * @param g the graph
+ * @param u the node
+ * @param dist its distance from the root, UNREACHED if none
+ * @param parent its predecessor, -1 for the root or an unreached node
+ *************************************************************/
+void write_tree(Writer * w, Graph * g, int u, int dist, int parent){
+    switch (w->fmt){
+        case FORMAT_HUMAN:
+            put_node(w, g, u);
+            if (dist == UNREACHED) put_str(w, " unreachable\n");
+            else {
+                put_char(w, ' ');
+                put_int(w, dist);
+                put_char(w, ' ');
+                if (parent < 0) put_char(w, '-');
+                else put_node(w, g, parent);
+                put_char(w, '\n');
+            }
+            break;
+
+        case FORMAT_CSV:
+            put_node(w, g, u);
+            put_char(w, ',');
+            put_distance(w, dist);
+            put_char(w, ',');
+            put_node(w, g, dist == UNREACHED ? -1 : parent);
+            put_char(w, '\n');
+            break;
+
+        case FORMAT_JSON:
+            put_str(w, "{\"city\":");
+            put_node(w, g, u);
+            put_str(w, ",\"distance\":");
+            put_distance(w, dist);
+            put_str(w, ",\"parent\":");
+            put_node(w, g, dist == UNREACHED ? -1 : parent);
+            put_str(w, "}\n");
+            break;
+
+        case FORMAT_BINARY:
+            put_bin(w, u);
+            put_bin(w, dist == UNREACHED ? -1 : dist);
+            put_bin(w, dist == UNREACHED ? -1 : parent);
+            break;
+    }
+}
+
+
+/*************************************************************
+ * Record of a city reached by a range search. In human form, as a node of
+ * a tree, the origin being told by write_text before its cities.
+ * @param w the writer
+ * @param g the graph searched
+ * @param origin the origin of the search
+ * @param u the city
+ * @param dist its distance from the origin
+ * @param parent the city it is reached from, -1 for the origin
+ *************************************************************/
+void write_reach(Writer * w, Graph * g, int origin, int u, int dist, int parent){
+    switch (w->fmt){
+        case FORMAT_HUMAN:
+            write_tree(w, g, u, dist, parent);
+            break;
+
+        case FORMAT_CSV:
+            put_node(w, g, origin);
+            put_char(w, ',');
+            write_tree(w, g, u, dist, parent);
+            break;
+
+        case FORMAT_JSON:
+            put_str(w, "{\"origin\":");
+            put_node(w, g, origin);
+            put_str(w, ",\"city\":");
+            put_node(w, g, u);
+            put_str(w, ",\"distance\":");
+            put_int(w, dist);
+            put_str(w, ",\"parent\":");
+            put_node(w, g, parent);
+            put_str(w, "}\n");
+            break;
+
+        case FORMAT_BINARY:
+            put_bin(w, origin);
+            write_tree(w, g, u, dist, parent);
+            break;
+    }
+}
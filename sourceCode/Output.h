@@ -0,0 +1,75 @@
+//
+//  Output.h
+//  Astar
+//
+//  Results written through one buffer, in large blocks, as text for people
+//  (human), CSV, JSON lines or fixed binary records.
+//
+
+#ifndef Output_h
+#define Output_h
+
+#include <stdio.h>
+#include "Graph.h"
+#include "Path.h"
+
+/** bytes kept before writing, unless given to newWriter **/
+#define OUT_BUFFER (1 << 20)
+
+/** formats of the results **/
+typedef enum format{
+    FORMAT_HUMAN,
+    FORMAT_CSV,
+    FORMAT_JSON,
+    FORMAT_BINARY
+}format;
+
+/** kinds of records: answers of queries, the nodes of a shortest path tree,
+ * or the cities reached by range searches **/
+typedef enum record{
+    RECORD_ROUTE,
+    RECORD_TREE,
+    RECORD_RANGE
+}record;
+
+/** Writer structure: the bytes not written yet to f, and the first error met **/
+typedef struct Writer{
+    FILE * f;
+    format fmt;
+    char * buf;
+    size_t len;
+    size_t cap;
+    int header;
+    status err;
+}Writer;
+
+/** Format named by a string (human, csv, json or binary), -1 if none **/
+int parse_format(char *);
+
+/** Create a writer to a file in a format, with a buffer of the given bytes (0 for OUT_BUFFER) **/
+Writer * newWriter(FILE *, format, size_t);
+
+/** Write what is left and destroy a writer, returning its first error **/
+status delWriter(Writer *);
+
+/** Write the bytes kept so far **/
+status flush_writer(Writer *);
+
+/** Text for people, ignored by the other formats **/
+void write_text(Writer *, const char *);
+
+/** Header of the records of a kind (CSV columns, binary magic), written once **/
+void write_header(Writer *, record);
+
+/** Record of the answer of a query: number (0 for a single query), start, goal,
+ * names typed for them when unknown (or NULL), status, distance when there is
+ * no path, path or NULL **/
+void write_route(Writer *, Graph *, int, int, int, const char *, const char *, status, int, Path *);
+
+/** Record of a node of a shortest path tree: node, distance, parent **/
+void write_tree(Writer *, Graph *, int, int, int);
+
+/** Record of a city reached by a range search: origin, node, distance, parent **/
+void write_reach(Writer *, Graph *, int, int, int, int);
+
+#endif /* Output_h */
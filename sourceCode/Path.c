@@ -0,0 +1,113 @@
+//
+//  Path.c
+//  Astar
+//
+//  Result of a search: the path as forward-ordered node indices with the
+//  distance of every leg, stored in one block of memory.
+//
+
+#include <stdlib.h>
+#include "Path.h"
+
+
+/*************************************************************
+ * Number of bytes needed to hold a path: the header followed by
+ * the node and leg arrays
+ * @param capacity maximum number of nodes of the path
+ * @return the size in bytes
+ *************************************************************/
+size_t pathBytes(int capacity){
+    return sizeof(Path) + (2 * (size_t)capacity) * sizeof(int);
+}
+
+
+/*************************************************************
+ * Build an empty path inside a caller-supplied buffer, the capacity
+ * is deduced from the size of the buffer
+ * @param buf the buffer, aligned for int and pointers
+ * @param bytes size of the buffer
+ * @return the path, located at the beginning of buf
+ * @return NULL if the buffer is too small to hold even the header
+ *************************************************************/
+Path * initPath(void * buf, size_t bytes){
+    if (!buf || bytes < sizeof(Path)) return NULL;
+    Path * p = (Path *)buf;
+    p->capacity = (int)((bytes - sizeof(Path)) / (2 * sizeof(int)));
+    p->nNodes = 0;
+    p->total = 0;
+    p->nodes = (int *)(p + 1);
+    p->legs = p->nodes + p->capacity;
+    return p;
+}
+
+
+/*************************************************************
+ * Create a path able to hold the given number of nodes
+ * @param capacity maximum number of nodes of the path
+ * @return the path
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Path * newPath(int capacity){
+    if (capacity < 1) capacity = 1;
+    size_t bytes = pathBytes(capacity);
+    return initPath(malloc(bytes), bytes);
+}
+
+
+/*************************************************************
+ * Destroy a path created by newPath
+ * @param p the path to destroy
+ *************************************************************/
+void delPath(Path * p){
+    free(p);
+}
+
+
+/*************************************************************
+ * Copy the path ending at ws->reached out of the workspace of the last
+ * search (the goal, or the best partial end when the budget ran out)
+ * @param ws the workspace of the last search
+ * @param p (out) the path, from the start to ws->reached
+ * @return ERRABSENT if the last search reached nothing
+ * @return ERRFULL if the path has more nodes than p can hold (p is left empty)
+ * @return OK otherwise
+ *************************************************************/
+status extract_path(Workspace * ws, Path * p){
+    p->nNodes = 0;
+    p->total = 0;
+    if (ws->reached < 0) return ERRABSENT;
+    
+    int count = 0;
+    for (int n = ws->reached; n != -1; n = ws->parent[n]) count++;
+    if (count > p->capacity) return ERRFULL;
+    
+    /* the parent chain goes backward: fill the arrays from their end */
+    int i = count;
+    for (int n = ws->reached; n != -1; n = ws->parent[n]){
+        p->nodes[--i] = n;
+        if (ws->parent[n] != -1) p->legs[i-1] = ws->g[n] - ws->g[ws->parent[n]];
+    }
+    p->legs[count-1] = 0;
+    p->nNodes = count;
+    p->total = ws->g[ws->reached];
+    return OK;
+}
+
+
+/*************************************************************
+ * Create a path of the exact size holding the path ending at ws->reached
+ * in the workspace of the last search, to keep it beyond the next one
+ * @param ws the workspace of the last search
+ * @return the path, to destroy with delPath
+ * @return NULL if the last search reached nothing or memory allocation failed
+ *************************************************************/
+Path * newReachedPath(Workspace * ws){
+    int count = 0;
+    for (int n = ws->reached; n >= 0; n = ws->parent[n]) count++;
+    Path * p = newPath(count);
+    if (p && extract_path(ws, p) != OK){
+        delPath(p);
+        return NULL;
+    }
+    return p;
+}
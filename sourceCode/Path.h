@@ -0,0 +1,44 @@
+//
+//  Path.h
+//  Astar
+//
+//  Result of a search: the path as forward-ordered node indices with the
+//  distance of every leg, stored in one block of memory.
+//
+
+#ifndef Path_h
+#define Path_h
+
+#include <stddef.h>
+#include "Graph.h"
+#include "Search.h"
+
+/** Path structure: nodes[0] is the start, nodes[nNodes-1] the end of the path,
+ * legs[i] is the distance from nodes[i] to nodes[i+1] **/
+typedef struct Path{
+    int nNodes;
+    int capacity;
+    int total;
+    int * nodes;
+    int * legs;
+}Path;
+
+/** Number of bytes needed to hold a path of the given number of nodes **/
+size_t pathBytes(int);
+
+/** Create a path able to hold the given number of nodes, in a single allocation **/
+Path * newPath(int);
+
+/** Build an empty path inside a caller-supplied buffer **/
+Path * initPath(void *, size_t);
+
+/** Destroy a path created by newPath **/
+void delPath(Path *);
+
+/** Copy the path ending at ws->reached out of the workspace of the last search **/
+status extract_path(Workspace *, Path *);
+
+/** Create a path of the exact size holding the path ending at ws->reached **/
+Path * newReachedPath(Workspace *);
+
+#endif /* Path_h */
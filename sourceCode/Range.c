@@ -0,0 +1,266 @@
+//
+//  Range.c
+//  Astar
+//
+//  Range searches (isochrones): Dijkstra from the origin, stopped at the
+//  distance limit. A road leading beyond the limit is never pushed, so the
+//  heap only holds cities that will be reached, and the search ends when
+//  it is empty. The cities are appended to a Reach as they are settled,
+//  hence nearest first, in three compact arrays.
+//
+//  The search runs on a Workspace, whose arrays are valid by epoch, and the
+//  arrays of a Reach are kept from one search to the next: repeated
+//  searches allocate nothing once both are large enough; like the arrays
+//  of the workspace, they are accounted as search state (MEM_CLOSED). Many
+//  origins are shared among threads, each searching on its own workspace,
+//  into the Reach of every origin.
+//
+
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "Range.h"
+
+
+/*************************************************************
+ * Create an empty set of reached cities
+ * @param capacity cities it has room for before growing, 0 for a default
+ * @return the set, to destroy with delReach
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Reach * newReach(int capacity){
+    Reach * r = (Reach *) mem_calloc(MEM_CLOSED, 1, sizeof(Reach));
+    if (!r) return NULL;
+    r->capacity = capacity > 0 ? capacity : 64;
+    r->node = (int *) mem_alloc(MEM_CLOSED, r->capacity * sizeof(int));
+    r->dist = (int *) mem_alloc(MEM_CLOSED, r->capacity * sizeof(int));
+    r->parent = (int *) mem_alloc(MEM_CLOSED, r->capacity * sizeof(int));
+    if (!r->node || !r->dist || !r->parent){
+        delReach(r);
+        return NULL;
+    }
+    r->origin = -1;
+    return r;
+}
+
+
+/*************************************************************
+ * Destroy a set of reached cities
+ * @param r the set, or NULL
+ *************************************************************/
+void delReach(Reach * r){
+    if (!r) return;
+    size_t bytes = r->capacity * sizeof(int);
+    mem_free(MEM_CLOSED, r->node, bytes);
+    mem_free(MEM_CLOSED, r->dist, bytes);
+    mem_free(MEM_CLOSED, r->parent, bytes);
+    mem_free(MEM_CLOSED, r, sizeof(Reach));
+}
+
+
+/** private function doubling the room of a set of reached cities; the
+ * arrays move only once all three are allocated, so the room stays that
+ * of every array **/
+static status grow_reach(Reach * r){
+    int capacity = 2 * r->capacity;
+    size_t bytes = r->capacity * sizeof(int), size = capacity * sizeof(int);
+    int * node = (int *) mem_alloc(MEM_CLOSED, size);
+    int * dist = (int *) mem_alloc(MEM_CLOSED, size);
+    int * parent = (int *) mem_alloc(MEM_CLOSED, size);
+    if (!node || !dist || !parent){
+        mem_free(MEM_CLOSED, node, size);
+        mem_free(MEM_CLOSED, dist, size);
+        mem_free(MEM_CLOSED, parent, size);
+        return ERRALLOC;
+    }
+    memcpy(node, r->node, r->n * sizeof(int));
+    memcpy(dist, r->dist, r->n * sizeof(int));
+    memcpy(parent, r->parent, r->n * sizeof(int));
+    mem_free(MEM_CLOSED, r->node, bytes);
+    mem_free(MEM_CLOSED, r->dist, bytes);
+    mem_free(MEM_CLOSED, r->parent, bytes);
+    r->node = node;
+    r->dist = dist;
+    r->parent = parent;
+    r->capacity = capacity;
+    return OK;
+}
+
+
+/*************************************************************
+ * Search the cities within a distance of an origin
+ * @param g the graph
+ * @param origin index of the origin city
+ * @param maxDist largest distance of a city reached (none if negative)
+ * @param ws workspace of the search, ws->reached is the farthest city on return
+ * @param r (out) the cities reached, nearest first, from the origin itself
+ * @param st (out) statistics of the search (roads beyond the limit are
+ *        counted as pruned), may be NULL
+ * @return ERRINDEX if origin is not a node of the graph
+ * @return ERRUNABLE if the workspace was made for a smaller graph
+ * @return ERRALLOC if memory allocation failed (r holds the cities reached so far)
+ * @return OK otherwise
+ *************************************************************/
+status range_search(Graph * g, int origin, int maxDist, Workspace * ws, Reach * r, SearchStats * st){
+    SearchStats local;
+    if (!st) st = &local;
+    memset(st, 0, sizeof(SearchStats));
+    r->origin = origin;
+    r->n = 0;
+    if (origin < 0 || origin >= g->nCities) return ERRINDEX;
+    if (ws->nCities < g->nCities || ws->maxDegree < g->maxDegree) return ERRUNABLE;
+    double t0 = search_clock();
+    resetWorkspace(ws);
+    ws->source = origin;
+    if (maxDist < 0) return OK;
+
+    unsigned epoch = ws->epoch;
+    ws->seen[origin] = epoch;
+    ws->g[origin] = 0;
+    ws->parent[origin] = -1;
+    ws->closed[origin] = 0;
+    ws->touched = 1;
+    status res = pushHeap(ws->open, 0, origin);
+
+    HeapItem top;
+    while (res == OK && popHeap(ws->open, &top) == OK){
+        int u = top.node;
+        if (ws->closed[u]) continue;
+        ws->closed[u] = 1;
+        st->expanded++;
+        if (r->n == r->capacity && (res = grow_reach(r)) != OK) break;
+        r->node[r->n] = u;
+        r->dist[r->n] = top.key;
+        r->parent[r->n] = ws->parent[u];
+        r->n++;
+
+        const int * adj, * dist;
+        int degree = graph_roads(g, u, ws->adjBuf, ws->distBuf, &adj, &dist);
+        for (int k = 0; k < degree; k++){
+            /* written so that a limit close to INT_MAX cannot overflow */
+            if (dist[k] > maxDist - top.key){
+                st->pruned++;
+                continue;
+            }
+            int v = adj[k], d = top.key + dist[k];
+            st->relaxed++;
+            if (ws->seen[v] != epoch){
+                ws->seen[v] = epoch;
+                ws->closed[v] = 0;
+                ws->touched++;
+            }
+            else if (d >= ws->g[v]) continue;
+            ws->g[v] = d;
+            ws->parent[v] = u;
+            if (pushHeap(ws->open, d, v) != OK){
+                res = ERRALLOC;
+                break;
+            }
+        }
+    }
+
+    ws->reached = r->n ? r->node[r->n - 1] : -1;
+    st->bytes = ws->touched * BYTES_PER_NODE + ws->open->capacity * sizeof(HeapItem)
+        + (size_t)r->capacity * 3 * sizeof(int);
+    st->seconds = search_clock() - t0;
+    return res;
+}
+
+
+/** Range searches shared among threads **/
+typedef struct RangeRun{
+    Graph * g;
+    const int * origins;
+    int nOrigins;
+    int maxDist;
+    Reach ** out;
+    atomic_int next;
+    atomic_int failed;
+}RangeRun;
+
+/** Argument of a thread of a run: its workspace and what its searches did **/
+typedef struct RangeWorker{
+    RangeRun * run;
+    Workspace * ws;
+    SearchStats st;
+}RangeWorker;
+
+
+/** private function run by every thread: takes origins until none is left,
+ * keeping the first error met **/
+static void * range_worker(void * arg){
+    RangeWorker * w = (RangeWorker *)arg;
+    RangeRun * run = w->run;
+    int i;
+    while ((i = atomic_fetch_add(&run->next, 1)) < run->nOrigins){
+        SearchStats st;
+        status res = range_search(run->g, run->origins[i], run->maxDist, w->ws, run->out[i], &st);
+        int none = OK;
+        if (res != OK) atomic_compare_exchange_strong(&run->failed, &none, res);
+        w->st.expanded += st.expanded;
+        w->st.relaxed += st.relaxed;
+        w->st.pruned += st.pruned;
+        if (st.bytes > w->st.bytes) w->st.bytes = st.bytes;
+    }
+    return NULL;
+}
+
+
+/*************************************************************
+ * Search the cities within a distance of each of many origins, the origins
+ * being shared among threads: one per workspace, the calling thread
+ * searching on the first one
+ * @param g the graph
+ * @param origins indices of the origin cities
+ * @param nOrigins number of origins
+ * @param maxDist largest distance of a city reached
+ * @param ws the workspaces, one per thread
+ * @param nWs number of workspaces (at least 1)
+ * @param out (out) the cities reached from origins[i] in out[i]
+ * @param st (out) statistics summed over all searches (bytes: the most of
+ *        one search, seconds: the whole time), may be NULL
+ * @return the first error met by a search (see range_search), that origin's
+ *         set being empty or partial
+ * @return ERRALLOC if the threads could not be prepared
+ * @return OK otherwise
+ *************************************************************/
+status range_searches(Graph * g, const int * origins, int nOrigins, int maxDist,
+                      Workspace ** ws, int nWs, Reach ** out, SearchStats * st){
+    double t0 = search_clock();
+    RangeWorker * workers = (RangeWorker *) calloc(nWs, sizeof(RangeWorker));
+    pthread_t * threads = (pthread_t *) malloc(nWs * sizeof(pthread_t));
+    if (!workers || !threads){
+        free(workers);
+        free(threads);
+        return ERRALLOC;
+    }
+    RangeRun run = {g, origins, nOrigins, maxDist, out};
+    atomic_init(&run.next, 0);
+    atomic_init(&run.failed, OK);
+    for (int t = 0; t < nWs; t++){
+        workers[t].run = &run;
+        workers[t].ws = ws[t];
+    }
+
+    /* threads are only worth starting for several origins */
+    int started = 1;
+    while (started < nWs && started < nOrigins &&
+           pthread_create(&threads[started], NULL, range_worker, &workers[started]) == 0)
+        started++;
+    range_worker(&workers[0]);
+    for (int t = 1; t < started; t++) pthread_join(threads[t], NULL);
+
+    if (st){
+        memset(st, 0, sizeof(SearchStats));
+        for (int t = 0; t < started; t++){
+            st->expanded += workers[t].st.expanded;
+            st->relaxed += workers[t].st.relaxed;
+            st->pruned += workers[t].st.pruned;
+            if (workers[t].st.bytes > st->bytes) st->bytes = workers[t].st.bytes;
+        }
+        st->seconds = search_clock() - t0;
+    }
+    free(workers);
+    free(threads);
+    return (status) atomic_load(&run.failed);
+}
@@ -0,0 +1,39 @@
+//
+//  Range.h
+//  Astar
+//
+//  Range searches (isochrones): the cities within a distance of an origin,
+//  with their distance, for one origin or for many origins at once.
+//
+
+#ifndef Range_h
+#define Range_h
+
+#include "Graph.h"
+#include "Search.h"
+
+/** Cities reached by a range search, nearest first: node[i] at distance
+ * dist[i], reached from parent[i] (-1 for the origin). The arrays only
+ * grow, so a Reach reused for similar searches allocates nothing more. **/
+typedef struct Reach{
+    int origin;
+    int n;
+    int capacity;
+    int * node;
+    int * dist;
+    int * parent;
+}Reach;
+
+/** Create an empty set of reached cities, with room for the given number **/
+Reach * newReach(int);
+
+/** Destroy a set of reached cities **/
+void delReach(Reach *);
+
+/** Cities within a distance of an origin, searched on a workspace **/
+status range_search(Graph *, int, int, Workspace *, Reach *, SearchStats *);
+
+/** Range searches from many origins, shared among threads (one per workspace) **/
+status range_searches(Graph *, const int *, int, int, Workspace **, int, Reach **, SearchStats *);
+
+#endif /* Range_h */
@@ -0,0 +1,312 @@
+//
+//  Reorder.c
+//  Astar
+//
+//  Renumbering of the nodes of a graph so that nodes that are expanded
+//  together by a search are stored close to each other in memory.
+//  A permutation perm gives for every node u its new index perm[u].
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "Reorder.h"
+
+/** side of the Hilbert grid the coordinates are scaled to (a power of 2) **/
+#define HILBERT_SIDE 65536u
+
+/** sort key of a node: a Hilbert index or the node itself **/
+typedef struct Keyed{
+    unsigned long long key;
+    int node;
+}Keyed;
+
+static int compKeyed(const void * a, const void * b){
+    const Keyed * k1 = (const Keyed *)a, * k2 = (const Keyed *)b;
+    if (k1->key != k2->key) return k1->key < k2->key ? -1 : 1;
+    return k1->node - k2->node;
+}
+
+
+/*************************************************************
+ * private function computing the distance along the Hilbert curve of
+ * a point of the HILBERT_SIDE x HILBERT_SIDE grid
+ *************************************************************/
+static unsigned long long hilbert_index(unsigned x, unsigned y){
+    unsigned long long d = 0;
+    for (unsigned s = HILBERT_SIDE / 2; s > 0; s /= 2){
+        unsigned rx = (x & s) > 0;
+        unsigned ry = (y & s) > 0;
+        d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+        
+        /* rotate the quadrant so the curve stays continuous */
+        if (ry == 0){
+            if (rx == 1){
+                x = HILBERT_SIDE - 1 - x;
+                y = HILBERT_SIDE - 1 - y;
+            }
+            unsigned t = x; x = y; y = t;
+        }
+    }
+    return d;
+}
+
+
+/*************************************************************
+ * Permutation sorting nodes along a Hilbert curve over their coordinates:
+ * cities that are close on the map get close indices
+ * @param g the graph
+ * @return the permutation (to be freed by the caller)
+ * @return NULL if memory allocation failed
+ *************************************************************/
+int * hilbert_order(Graph * g){
+    int n = g->nCities;
+    Keyed * keys = (Keyed *) malloc((n + 1) * sizeof(Keyed));
+    int * perm = (int *) malloc((n + 1) * sizeof(int));
+    if (!keys || !perm){
+        free(keys);
+        free(perm);
+        return NULL;
+    }
+    
+    /* scale the bounding box of the map to the Hilbert grid */
+    int minLat = 0, maxLat = 0, minLgt = 0, maxLgt = 0;
+    for (int u = 0; u < n; u++){
+        if (u == 0 || g->lat[u] < minLat) minLat = g->lat[u];
+        if (u == 0 || g->lat[u] > maxLat) maxLat = g->lat[u];
+        if (u == 0 || g->lgt[u] < minLgt) minLgt = g->lgt[u];
+        if (u == 0 || g->lgt[u] > maxLgt) maxLgt = g->lgt[u];
+    }
+    double sLat = (HILBERT_SIDE - 1) / (double)(maxLat > minLat ? maxLat - minLat : 1);
+    double sLgt = (HILBERT_SIDE - 1) / (double)(maxLgt > minLgt ? maxLgt - minLgt : 1);
+    
+    for (int u = 0; u < n; u++){
+        keys[u].key = hilbert_index((unsigned)((g->lat[u] - minLat) * sLat),
+                                    (unsigned)((g->lgt[u] - minLgt) * sLgt));
+        keys[u].node = u;
+    }
+    qsort(keys, n, sizeof(Keyed), compKeyed);
+    for (int i = 0; i < n; i++) perm[keys[i].node] = i;
+    
+    free(keys);
+    return perm;
+}
+
+
+/*************************************************************
+ * Permutation given by a reverse Cuthill-McKee traversal: breadth-first
+ * from a node of smallest degree, neighbours visited by increasing
+ * degree, the resulting order reversed. Every component is traversed.
+ * @param g the graph
+ * @return the permutation (to be freed by the caller)
+ * @return NULL if memory allocation failed or the graph is stored
+ *************************************************************/
+int * rcm_order(Graph * g){
+    if (g->store) return NULL;
+    int n = g->nCities;
+    int * perm = (int *) malloc((n + 1) * sizeof(int));
+    int * queue = (int *) malloc((n + 1) * sizeof(int));
+    char * visited = (char *) calloc(n + 1, sizeof(char));
+    Keyed * byDegree = (Keyed *) malloc((n + 1) * sizeof(Keyed));
+    Keyed * succ = (Keyed *) malloc((n + 1) * sizeof(Keyed));
+    if (!perm || !queue || !visited || !byDegree || !succ){
+        free(perm);
+        perm = NULL;
+        goto done;
+    }
+    
+    /* traversals start from the unvisited node of smallest degree */
+    for (int u = 0; u < n; u++){
+        byDegree[u].key = g->first[u+1] - g->first[u];
+        byDegree[u].node = u;
+    }
+    qsort(byDegree, n, sizeof(Keyed), compKeyed);
+    
+    int tail = 0;
+    for (int i = 0; i < n; i++){
+        int root = byDegree[i].node;
+        if (visited[root]) continue;
+        visited[root] = 1;
+        int head = tail;
+        queue[tail++] = root;
+        
+        while (head < tail){
+            int u = queue[head++], k = 0;
+            for (int e = g->first[u]; e < g->first[u+1]; e++){
+                int v = g->adj[e];
+                if (visited[v]) continue;
+                visited[v] = 1;
+                succ[k].key = g->first[v+1] - g->first[v];
+                succ[k++].node = v;
+            }
+            qsort(succ, k, sizeof(Keyed), compKeyed);
+            for (int j = 0; j < k; j++) queue[tail++] = succ[j].node;
+        }
+    }
+    for (int i = 0; i < n; i++) perm[queue[i]] = n - 1 - i;
+    
+done:
+    free(queue);
+    free(visited);
+    free(byDegree);
+    free(succ);
+    return perm;
+}
+
+
+/*************************************************************
+ * Renumber the nodes of the graph in place: node u becomes perm[u],
+ * the adjacency is rebuilt so that the edges of a node stay contiguous
+ * and are laid out in the new node order. City ids follow.
+ * @param g the graph
+ * @param perm the permutation, perm[u] is the new index of node u
+ * @return ERRUNABLE if the graph is not made of plain arrays or has arc-flags
+ * or a spatial index
+ * @return ERRALLOC if memory allocation failed (the graph is left untouched)
+ * @return OK otherwise
+ *************************************************************/
+status renumber_graph(Graph * g, int * perm){
+    if (g->store || g->arcFlags || g->spatial) return ERRUNABLE;
+    int n = g->nCities, m = g->nEdges;
+    size_t nodes = (n + 1) * sizeof(int), edges = (m + 1) * sizeof(int);
+    City ** cities = (City **) mem_alloc(MEM_GRAPH, (n + 1) * sizeof(City *));
+    int * first = (int *) mem_alloc(MEM_GRAPH, nodes + sizeof(int));
+    int * adj = (int *) mem_alloc(MEM_GRAPH, edges);
+    int * dist = (int *) mem_alloc(MEM_GRAPH, edges);
+    int * lat = (int *) mem_alloc(MEM_GRAPH, nodes);
+    int * lgt = (int *) mem_alloc(MEM_GRAPH, nodes);
+    int * component = (int *) mem_alloc(MEM_GRAPH, nodes);
+    if (!cities || !first || !adj || !dist || !lat || !lgt || !component){
+        mem_free(MEM_GRAPH, cities, (n + 1) * sizeof(City *));
+        mem_free(MEM_GRAPH, first, nodes + sizeof(int));
+        mem_free(MEM_GRAPH, adj, edges);
+        mem_free(MEM_GRAPH, dist, edges);
+        mem_free(MEM_GRAPH, lat, nodes);
+        mem_free(MEM_GRAPH, lgt, nodes);
+        mem_free(MEM_GRAPH, component, nodes);
+        return ERRALLOC;
+    }
+    
+    for (int u = 0; u < n; u++){
+        int v = perm[u];
+        cities[v] = g->cities[u];
+        cities[v]->id = v;
+        lat[v] = g->lat[u];
+        lgt[v] = g->lgt[u];
+        component[v] = g->component[u];
+        first[v] = g->first[u+1] - g->first[u];
+    }
+    
+    /* degrees to offsets, then copy every edge range to its new place */
+    int e = 0;
+    for (int v = 0; v < n; v++){
+        int degree = first[v];
+        first[v] = e;
+        e += degree;
+    }
+    first[n] = e;
+    for (int u = 0; u < n; u++){
+        int to = first[perm[u]];
+        for (int k = g->first[u]; k < g->first[u+1]; k++, to++){
+            adj[to] = perm[g->adj[k]];
+            dist[to] = g->dist[k];
+        }
+    }
+    
+    size_t oldNodes = g->nodeRoom * sizeof(int), oldEdges = g->edgeRoom * sizeof(int);
+    mem_free(MEM_GRAPH, g->cities, g->nodeRoom * sizeof(City *));
+    mem_free(MEM_GRAPH, g->first, oldNodes + sizeof(int));
+    mem_free(MEM_GRAPH, g->adj, oldEdges);
+    mem_free(MEM_GRAPH, g->dist, oldEdges);
+    mem_free(MEM_GRAPH, g->lat, oldNodes);
+    mem_free(MEM_GRAPH, g->lgt, oldNodes);
+    mem_free(MEM_GRAPH, g->component, oldNodes);
+    g->nodeRoom = n + 1;
+    g->edgeRoom = m + 1;
+    g->cities = cities;
+    g->first = first;
+    g->adj = adj;
+    g->dist = dist;
+    g->lat = lat;
+    g->lgt = lgt;
+    g->component = component;
+    return OK;
+}
+
+
+/*************************************************************
+ * Save the current node order of the graph: the name of node i is
+ * written on line i+1. Names do not depend on how the map was read, so
+ * the order can be restored on a later run with load_order.
+ * @param g the graph
+ * @param filepath file to write
+ * @return ERROPEN if the file cannot be created
+ * @return ERRCLOSE if writing failed
+ * @return OK otherwise
+ *************************************************************/
+status save_order(Graph * g, char * filepath){
+    FILE * f = fopen(filepath, "w");
+    if (!f) return ERROPEN;
+    char buf[20];
+    for (int u = 0; u < g->nCities; u++)
+        fprintf(f, "%s\n", city_name(g, u, buf));
+    return fclose(f) == 0 ? OK : ERRCLOSE;
+}
+
+
+/** private comparison of two nodes by city name, for load_order **/
+static Graph * sorted_graph;
+static int compNodeName(const void * a, const void * b){
+    return strcmp(sorted_graph->cities[*(const int *)a]->name,
+                  sorted_graph->cities[*(const int *)b]->name);
+}
+
+static int compNameNode(const void * name, const void * b){
+    return strcmp((const char *)name, sorted_graph->cities[*(const int *)b]->name);
+}
+
+
+/*************************************************************
+ * Read an order saved by save_order and return the permutation that
+ * brings the graph to that order
+ * @param g the graph
+ * @param filepath file to read
+ * @return the permutation (to be freed by the caller)
+ * @return NULL if the file cannot be read or does not list every city once
+ *************************************************************/
+int * load_order(Graph * g, char * filepath){
+    int n = g->nCities;
+    if (g->store) return NULL;
+    FILE * f = fopen(filepath, "r");
+    if (!f) return NULL;
+    int * perm = (int *) malloc((n + 1) * sizeof(int));
+    int * byName = (int *) malloc((n + 1) * sizeof(int));
+    if (!perm || !byName){
+        free(perm);
+        perm = NULL;
+        goto done;
+    }
+    
+    for (int u = 0; u < n; u++){
+        byName[u] = u;
+        perm[u] = -1;
+    }
+    sorted_graph = g;
+    qsort(byName, n, sizeof(int), compNodeName);
+    
+    char name[20];
+    int i = 0;
+    while (fscanf(f, "%19s", name) == 1){
+        int * u = (int *) bsearch(name, byName, n, sizeof(int), compNameNode);
+        if (!u || perm[*u] != -1 || i >= n) break;
+        perm[*u] = i++;
+    }
+    if (i != n){
+        free(perm);
+        perm = NULL;
+    }
+    
+done:
+    free(byName);
+    fclose(f);
+    return perm;
+}
@@ -0,0 +1,29 @@
+//
+//  Reorder.h
+//  Astar
+//
+//  Renumbering of the nodes of a graph so that nodes that are expanded
+//  together by a search are stored close to each other in memory.
+//
+
+#ifndef Reorder_h
+#define Reorder_h
+
+#include "Graph.h"
+
+/** Permutation sorting nodes along a Hilbert curve over (lat, lgt) **/
+int * hilbert_order(Graph *);
+
+/** Permutation given by a reverse Cuthill-McKee traversal of the roads **/
+int * rcm_order(Graph *);
+
+/** Renumber the nodes of the graph in place: node u becomes perm[u] **/
+status renumber_graph(Graph *, int *);
+
+/** Save the current node order of the graph (one city name per line) **/
+status save_order(Graph *, char *);
+
+/** Read an order saved by save_order and return the permutation leading to it **/
+int * load_order(Graph *, char *);
+
+#endif /* Reorder_h */
@@ -0,0 +1,397 @@
+//
+//  Search.c
+//  Astar
+//
+//  A* search on the array view of the map, with per-query budgets.
+//
+
+#include <string.h>
+#include <time.h>
+#include "Search.h"
+#include "ArcFlags.h"
+#include "GoalCache.h"
+#include "Sssp.h"
+#include "Trace.h"
+#include "Memory.h"
+
+/** the clock is only read once every that many expansions **/
+#define CLOCK_PERIOD 256
+
+
+/*************************************************************
+ * Create a workspace for searches on the given graph
+ * @param g the graph the searches will run on
+ * @return the workspace
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Workspace * newWorkspace(Graph * g){
+    return newWorkspaceFor(g->nCities, g->maxDegree);
+}
+
+
+/*************************************************************
+ * Create a workspace for searches on any set of numbered nodes
+ * @param nNodes number of nodes, numbered from 0
+ * @param maxDegree maximum number of successors of a node
+ * @return the workspace
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Workspace * newWorkspaceFor(int nNodes, int maxDegree){
+    Workspace * ws = (Workspace *) mem_calloc(MEM_CLOSED, 1, sizeof(Workspace));
+    if (!ws) return NULL;
+    int n = nNodes + 1;
+    ws->nCities = nNodes;
+    ws->maxDegree = maxDegree;
+    ws->seen = (unsigned *) mem_calloc(MEM_CLOSED, n, sizeof(unsigned));
+    ws->g = (int *) mem_alloc(MEM_CLOSED, n * sizeof(int));
+    ws->parent = (int *) mem_alloc(MEM_CLOSED, n * sizeof(int));
+    ws->closed = (char *) mem_alloc(MEM_CLOSED, n * sizeof(char));
+    ws->open = newHeap(64);
+    ws->adjBuf = (int *) mem_alloc(MEM_CLOSED, (maxDegree + 1) * sizeof(int));
+    ws->distBuf = (int *) mem_alloc(MEM_CLOSED, (maxDegree + 1) * sizeof(int));
+    if (!ws->seen || !ws->g || !ws->parent || !ws->closed || !ws->open || !ws->adjBuf || !ws->distBuf){
+        delWorkspace(ws);
+        return NULL;
+    }
+    ws->reached = -1;
+    return ws;
+}
+
+
+/*************************************************************
+ * Destroy a workspace by deallocating used memory
+ * @param ws the workspace to destroy
+ *************************************************************/
+void delWorkspace(Workspace * ws){
+    if (!ws) return;
+    size_t n = ws->nCities + 1, d = ws->maxDegree + 1;
+    mem_free(MEM_CLOSED, ws->seen, n * sizeof(unsigned));
+    mem_free(MEM_CLOSED, ws->g, n * sizeof(int));
+    mem_free(MEM_CLOSED, ws->parent, n * sizeof(int));
+    mem_free(MEM_CLOSED, ws->closed, n * sizeof(char));
+    delHeap(ws->open);
+    mem_free(MEM_CLOSED, ws->adjBuf, d * sizeof(int));
+    mem_free(MEM_CLOSED, ws->distBuf, d * sizeof(int));
+    mem_free(MEM_CLOSED, ws, sizeof(Workspace));
+}
+
+
+/*************************************************************
+ * Start a new query on the workspace: entries of the previous query
+ * become invalid without clearing the arrays
+ * @param ws the workspace
+ *************************************************************/
+void resetWorkspace(Workspace * ws){
+    if (++ws->epoch == 0){
+        memset(ws->seen, 0, (ws->nCities + 1) * sizeof(unsigned));
+        ws->epoch = 1;
+    }
+    clearHeap(ws->open);
+    ws->touched = 0;
+    ws->reached = -1;
+}
+
+
+/*************************************************************
+ * Monotonic time used to measure searches
+ * @return the time in seconds
+ *************************************************************/
+double search_clock(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*************************************************************
+ * Test whether a search has exceeded its budget, before the next node is
+ * expanded, so that a limit of N expansions lets N nodes be expanded. The
+ * clock is only read once every CLOCK_PERIOD expansions.
+ * @param b the budget
+ * @param st statistics of the search so far (expanded and bytes)
+ * @param t0 time the search started, from search_clock
+ * @return 1 if one of the limits is exceeded
+ * @return 0 otherwise
+ *************************************************************/
+int budget_exceeded(const Budget * b, const SearchStats * st, double t0){
+    return (b->maxExpansions && st->expanded >= b->maxExpansions) ||
+        (b->maxBytes && st->bytes >= b->maxBytes) ||
+        (b->maxSeconds > 0 && st->expanded % CLOCK_PERIOD == 0 &&
+         search_clock() - t0 >= b->maxSeconds);
+}
+
+
+/** private function testing whether the road from u to v must be avoided **/
+static int avoided(const Avoid * avoid, int u, int v){
+    if (avoid->nodes && avoid->nodes[v] == avoid->stamp) return 1;
+    if (u != avoid->from) return 0;
+    for (int i = 0; i < avoid->nTargets; i++)
+        if (avoid->targets[i] == v) return 1;
+    return 0;
+}
+
+
+/*************************************************************
+ * private function expanding the nodes of OPEN until goal is settled,
+ * the budget is exhausted or OPEN is empty. ws->reached is set to goal,
+ * or to the expanded node estimated closest to it. A node taken out of
+ * OPEN when the budget runs out is put back. If the search is resumable,
+ * so is the goal, which is not expanded yet, and arc-flags are not used.
+ * With the exact distances to goal, they are the estimate and the roads
+ * to nodes from which goal cannot be reached are pruned.
+ * @return OK, ERRNOPATH, ERRBUDGET or ERRALLOC as astar
+ *************************************************************/
+static status expand(Graph * g, int goal, const int * exact, const Avoid * avoid, int resumable,
+                     const Budget * b, Workspace * ws, SearchStats * st, double t0){
+    /* with arc-flags, only roads flagged for the region of the goal are followed */
+    const unsigned long long * flags = !resumable && g->arcFlags && !g->store && !avoid
+        ? g->arcFlags->flags : NULL;
+    unsigned long long goalBit = flags ? 1ULL << g->arcFlags->region[goal] : 0;
+    
+    unsigned epoch = ws->epoch;
+    int best = ws->source;
+    int bestH = exact ? exact[best] : graph_h(g, best, goal);
+    status res = ERRNOPATH;
+    
+    HeapItem top;
+    while (popHeap(ws->open, &top) == OK){
+        int n = top.node;
+        
+        /* outdated entry: the node has been expanded with a better distance */
+        if (ws->closed[n]) continue;
+        ws->closed[n] = 1;
+        TRACE_POINT(TRACE_POP, n, top.key);
+        
+        if (n == goal){
+            TRACE_POINT(TRACE_FOUND, goal, ws->g[goal]);
+            best = goal;
+            res = OK;
+            if (resumable){
+                ws->closed[n] = 0;
+                if (pushHeap(ws->open, top.key, n) != OK) res = ERRALLOC;
+            }
+            break;
+        }
+        
+        /* check the budget before expanding further */
+        st->bytes = ws->touched * BYTES_PER_NODE + ws->open->capacity * sizeof(HeapItem);
+        if (budget_exceeded(b, st, t0)){
+            ws->closed[n] = 0;
+            res = pushHeap(ws->open, top.key, n) == OK ? ERRBUDGET : ERRALLOC;
+            break;
+        }
+        
+        st->expanded++;
+        int h = top.key - ws->g[n];
+        if (h < bestH || (h == bestH && ws->g[n] < ws->g[best])){
+            best = n;
+            bestH = h;
+        }
+        
+        const int * adj, * dist;
+        int degree = graph_roads(g, n, ws->adjBuf, ws->distBuf, &adj, &dist);
+        for (int k = 0; k < degree; k++){
+            if (flags && !(flags[g->first[n] + k] & goalBit)){
+                st->pruned++;
+                continue;
+            }
+            int succ = adj[k];
+            if (avoid && avoided(avoid, n, succ)) continue;
+            if (exact && exact[succ] == UNREACHED){
+                st->pruned++;
+                continue;
+            }
+            int distance_so_far = ws->g[n] + dist[k];
+            st->relaxed++;
+            
+            if (ws->seen[succ] != epoch){
+                ws->seen[succ] = epoch;
+                ws->closed[succ] = 0;
+                ws->touched++;
+            }
+            else if (distance_so_far >= ws->g[succ]) continue;
+            else if (ws->closed[succ]){
+                ws->closed[succ] = 0;
+                st->reopened++;
+                TRACE_POINT(TRACE_REOPEN, succ, distance_so_far);
+            }
+            TRACE_POINT(TRACE_RELAX, succ, distance_so_far);
+            
+            ws->g[succ] = distance_so_far;
+            ws->parent[succ] = n;
+            int h = exact ? exact[succ] : graph_h(g, succ, goal);
+            if (pushHeap(ws->open, distance_so_far + h, succ) != OK){
+                res = ERRALLOC;
+                break;
+            }
+        }
+        if (res == ERRALLOC) break;
+    }
+    
+    ws->reached = best;
+    return res;
+}
+
+
+/*************************************************************
+ * Search the shortest path from start to goal.
+ * Pairs lying in different components are rejected before any search.
+ * The search stops as soon as one of the limits of the budget is
+ * exceeded; the node expanded so far that is estimated to be the
+ * closest to the goal is then reported as a partial result.
+ * Follow ws->parent from ws->reached to get the path (in reverse).
+ * @param g the graph
+ * @param start index of the start city
+ * @param goal index of the goal city
+ * @param b limits of the query, NULL for none
+ * @param ws workspace of the query, ws->reached is set on return
+ * @param st (out) statistics of the query, may be NULL
+ * @return OK if a path was found, ws->reached is goal
+ * @return ERRNOPATH if goal cannot be reached from start
+ * @return ERRBUDGET if the budget was exhausted, ws->reached is the best partial end
+ * @return ERRINDEX if start or goal is not a node of the graph
+ * @return ERRUNABLE if the workspace was made for a smaller graph (see Delta.h)
+ * @return ERRALLOC if memory allocation failed
+ *************************************************************/
+status astar(Graph * g, int start, int goal, const Budget * b, Workspace * ws, SearchStats * st){
+    return astar_avoiding(g, start, goal, NULL, b, ws, st);
+}
+
+
+/*************************************************************
+ * Search the shortest path from start to goal that does not go through
+ * the nodes nor take the roads to avoid, otherwise as astar. Arc-flags
+ * are not used, as avoided nodes may divert the path off flagged roads;
+ * the exact distances of a goal cache are, as avoiding only lengthens paths.
+ * @param g the graph
+ * @param start index of the start city
+ * @param goal index of the goal city
+ * @param avoid nodes and roads to avoid, NULL for none
+ * @param b limits of the query, NULL for none
+ * @param ws workspace of the query, ws->reached is set on return
+ * @param st (out) statistics of the query, may be NULL
+ * @return as astar
+ *************************************************************/
+status astar_avoiding(Graph * g, int start, int goal, const Avoid * avoid, const Budget * b,
+                      Workspace * ws, SearchStats * st){
+    SearchStats local;
+    Budget none = {0, 0, 0};
+    if (!st) st = &local;
+    if (!b) b = &none;
+    memset(st, 0, sizeof(SearchStats));
+    
+    if (start < 0 || start >= g->nCities || goal < 0 || goal >= g->nCities)
+        return ERRINDEX;
+    if (ws->nCities < g->nCities || ws->maxDegree < g->maxDegree) return ERRUNABLE;
+    
+    resetWorkspace(ws);
+    ws->source = start;
+    double t0 = search_clock();
+    TRACE_POINT(TRACE_SEARCH_BEGIN, start, goal);
+    
+    /* nodes in different components: no search can succeed */
+    if (g->component[start] != g->component[goal]){
+        ws->reached = start;
+        TRACE_POINT(TRACE_SEARCH_END, 0, ERRNOPATH);
+        return ERRNOPATH;
+    }
+    
+    /* a hot goal: the distances to it are the estimate */
+    const int * exact = ws->goals ? goal_cache_acquire(ws->goals, goal) : NULL;
+    ws->seen[start] = ws->epoch;
+    ws->g[start] = 0;
+    ws->parent[start] = -1;
+    ws->closed[start] = 0;
+    ws->touched = 1;
+    status res;
+    if (exact && exact[start] == UNREACHED){
+        ws->reached = start;
+        res = ERRNOPATH;
+    }
+    else res = pushHeap(ws->open, exact ? exact[start] : graph_h(g, start, goal), start);
+    if (res == OK) res = expand(g, goal, exact, avoid, 0, b, ws, st, t0);
+    if (exact) goal_cache_release(ws->goals, goal);
+    
+    st->bytes = ws->touched * BYTES_PER_NODE + ws->open->capacity * sizeof(HeapItem);
+    st->seconds = search_clock() - t0;
+    TRACE_POINT(TRACE_SEARCH_END, (int)st->expanded, res);
+    return res;
+}
+
+
+/*************************************************************
+ * Start a search from start that astar_resume continues toward
+ * successive goals: the nodes settled for one goal stay settled, with
+ * their shortest path, for the next ones
+ * @param g the graph
+ * @param start index of the start city
+ * @param ws workspace of the search, owned by it until the next search
+ * @return ERRINDEX if start is not a node of the graph
+ * @return ERRUNABLE if the workspace was made for a smaller graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ *************************************************************/
+status astar_begin(Graph * g, int start, Workspace * ws){
+    if (start < 0 || start >= g->nCities) return ERRINDEX;
+    if (ws->nCities < g->nCities || ws->maxDegree < g->maxDegree) return ERRUNABLE;
+    resetWorkspace(ws);
+    ws->source = start;
+    ws->seen[start] = ws->epoch;
+    ws->g[start] = 0;
+    ws->parent[start] = -1;
+    ws->closed[start] = 0;
+    ws->touched = 1;
+    return pushHeap(ws->open, 0, start);
+}
+
+
+/*************************************************************
+ * Continue the search begun by astar_begin until goal is settled. The
+ * nodes left in OPEN are first ordered by the estimate toward the new
+ * goal. The estimate being consistent (see calibrate_h), settled nodes
+ * keep their shortest distance whatever the goal, so follow ws->parent
+ * from goal to get the path. Arc-flags are not used, as the roads they
+ * prune for one goal may be needed by the next one.
+ * @param g the graph
+ * @param goal index of the goal city
+ * @param b limits of this part of the search, NULL for none
+ * @param ws workspace of the search
+ * @param st (out) statistics of this part of the search, may be NULL
+ * @return as astar; after ERRBUDGET the search can still be resumed
+ *************************************************************/
+status astar_resume(Graph * g, int goal, const Budget * b, Workspace * ws, SearchStats * st){
+    SearchStats local;
+    Budget none = {0, 0, 0};
+    if (!st) st = &local;
+    if (!b) b = &none;
+    memset(st, 0, sizeof(SearchStats));
+    
+    if (goal < 0 || goal >= g->nCities) return ERRINDEX;
+    if (ws->nCities < g->nCities || ws->maxDegree < g->maxDegree) return ERRUNABLE;
+    double t0 = search_clock();
+    TRACE_POINT(TRACE_SEARCH_BEGIN, ws->source, goal);
+    
+    status res;
+    if (g->component[ws->source] != g->component[goal]){
+        ws->reached = ws->source;
+        res = ERRNOPATH;
+    }
+    else if (ws->seen[goal] == ws->epoch && ws->closed[goal]){
+        TRACE_POINT(TRACE_FOUND, goal, ws->g[goal]);
+        ws->reached = goal;
+        res = OK;
+    }
+    else {
+        for (int i = 0; i < ws->open->size; i++){
+            HeapItem * it = &ws->open->items[i];
+            it->key = ws->g[it->node] + graph_h(g, it->node, goal);
+        }
+        heapifyHeap(ws->open);
+        res = expand(g, goal, NULL, NULL, 1, b, ws, st, t0);
+    }
+    
+    st->bytes = ws->touched * BYTES_PER_NODE + ws->open->capacity * sizeof(HeapItem);
+    st->seconds = search_clock() - t0;
+    TRACE_POINT(TRACE_SEARCH_END, (int)st->expanded, res);
+    return res;
+}
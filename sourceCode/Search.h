@@ -0,0 +1,97 @@
+//
+//  Search.h
+//  Astar
+//
+//  A* search on the array view of the map, with per-query budgets.
+//
+
+#ifndef Search_h
+#define Search_h
+
+#include <stddef.h>
+#include "Graph.h"
+#include "Heap.h"
+
+/** Per-query limits, a zero field means "no limit" **/
+typedef struct Budget{
+    long maxExpansions;
+    double maxSeconds;
+    size_t maxBytes;
+}Budget;
+
+/** What a search did: filled by astar on every return **/
+typedef struct SearchStats{
+    long expanded;
+    long relaxed;
+    long reopened;
+    long pruned;
+    size_t bytes;
+    double seconds;
+}SearchStats;
+
+/** Per-query search state, indexed by node. Allocated once and reused by
+ * successive searches on the same graph: a node's entries are only valid
+ * when seen[node] equals the current epoch. When goals is set, astar
+ * takes the exact distances to hot goals from that cache (GoalCache.h). **/
+typedef struct Workspace{
+    int nCities;
+    int maxDegree;
+    unsigned epoch;
+    unsigned * seen;
+    int * g;
+    int * parent;
+    char * closed;
+    Heap * open;
+    int * adjBuf;
+    int * distBuf;
+    int touched;
+    int reached;
+    int source;
+    struct GoalCache * goals;
+}Workspace;
+
+/** bytes of search state attributed to every node touched by a query:
+ * its entries of seen, g, parent and closed **/
+#define BYTES_PER_NODE (sizeof(unsigned) + 2 * sizeof(int) + sizeof(char))
+
+/** Nodes and roads a search must not use: node u when nodes[u] equals
+ * stamp, and the roads from node from to the nTargets given targets **/
+typedef struct Avoid{
+    const unsigned * nodes;
+    unsigned stamp;
+    int from;
+    const int * targets;
+    int nTargets;
+}Avoid;
+
+/** Create a workspace for searches on the given graph **/
+Workspace * newWorkspace(Graph *);
+
+/** Create a workspace for searches on any set of numbered nodes **/
+Workspace * newWorkspaceFor(int, int);
+
+/** Start a new query on a workspace **/
+void resetWorkspace(Workspace *);
+
+/** Destroy a workspace by deallocating used memory **/
+void delWorkspace(Workspace *);
+
+/** Monotonic time used to measure searches, in seconds **/
+double search_clock(void);
+
+/** Test whether a search has exceeded its budget **/
+int budget_exceeded(const Budget *, const SearchStats *, double);
+
+/** Search the shortest path from start to goal within the given budget **/
+status astar(Graph *, int, int, const Budget *, Workspace *, SearchStats *);
+
+/** Search the shortest path from start to goal that avoids some nodes and roads **/
+status astar_avoiding(Graph *, int, int, const Avoid *, const Budget *, Workspace *, SearchStats *);
+
+/** Start a search from start that can be resumed toward successive goals **/
+status astar_begin(Graph *, int, Workspace *);
+
+/** Continue the search of the workspace until the given goal is settled **/
+status astar_resume(Graph *, int, const Budget *, Workspace *, SearchStats *);
+
+#endif /* Search_h */
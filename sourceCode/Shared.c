@@ -0,0 +1,250 @@
+//
+//  Shared.c
+//  Astar
+//
+//  Graph held in one shared memory segment.
+//
+//  The segment starts with a header followed by the arrays of the graph
+//  (first, adj, dist, lat, lgt, component), the names of the cities on 20
+//  bytes each and the nodes sorted by name. The header locates the arrays
+//  by their offset from the start of the segment, not by address, so the
+//  segment means the same wherever a process maps it. Once written, the
+//  segment is made read-only: processes forked afterwards share its pages
+//  (copy-on-write never triggers), and other processes map it read-only by
+//  name. The graph of a process is a small view whose arrays point into
+//  the segment; names are read through a GraphStore that leaves the roads
+//  to the arrays.
+//
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "Shared.h"
+
+#define NAME_BYTES 20
+
+static const char magic[4] = {'A', 'S', 'H', '1'};
+
+/** Start of a segment: offsets are in bytes from the start of the segment **/
+typedef struct SharedHeader{
+    char magic[4];
+    int nCities;
+    int nEdges;
+    int nComponents;
+    int maxDegree;
+    int hMetric;
+    double hScale;
+    size_t bytes;
+    size_t first;
+    size_t adj;
+    size_t dist;
+    size_t lat;
+    size_t lgt;
+    size_t component;
+    size_t names;
+    size_t byName;
+}SharedHeader;
+
+/** Mapping of a segment by a process **/
+typedef struct Segment{
+    SharedHeader * h;
+    Graph * g;
+}Segment;
+
+
+/** private function locating an array of the segment **/
+static void * at(const SharedHeader * h, size_t offset){
+    return (char *)h + offset;
+}
+
+/** decoding function of the name of a node, see GraphStore **/
+static void shared_name(void * data, int u, char * buf){
+    const SharedHeader * h = ((Segment *)data)->h;
+    memcpy(buf, (char *)at(h, h->names) + (size_t)u * NAME_BYTES, NAME_BYTES);
+}
+
+/** lookup function of a node by its name, see GraphStore **/
+static int shared_find(void * data, char * name){
+    const SharedHeader * h = ((Segment *)data)->h;
+    return find_sorted_name((const char (*)[20])at(h, h->names), (const int *)at(h, h->byName), h->nCities, name);
+}
+
+/** unmapping function of the segment; the arrays of the graph point into
+ * it, so they are cleared before delGraph frees them **/
+static void delSegment(void * data){
+    Segment * s = (Segment *)data;
+    Graph * g = s->g;
+    g->first = g->adj = g->dist = g->lat = g->lgt = g->component = NULL;
+    mem_track(MEM_GRAPH, s->h->bytes, 0);
+    munmap(s->h, s->h->bytes);
+    free(s);
+}
+
+
+/** private function building the view of a process on a mapped segment **/
+static Graph * view_graph(SharedHeader * h){
+    Graph * g = (Graph *) calloc(1, sizeof(Graph));
+    GraphStore * store = (GraphStore *) malloc(sizeof(GraphStore));
+    Segment * s = (Segment *) malloc(sizeof(Segment));
+    if (!g || !store || !s){
+        free(g);
+        free(store);
+        free(s);
+        munmap(h, h->bytes);
+        return NULL;
+    }
+    s->h = h;
+    s->g = g;
+    store->roads = NULL;
+    store->name = shared_name;
+    store->find = shared_find;
+    store->live = NULL;
+    store->del = delSegment;
+    store->data = s;
+    g->store = store;
+    g->nCities = h->nCities;
+    g->nEdges = h->nEdges;
+    g->nComponents = h->nComponents;
+    g->maxDegree = h->maxDegree;
+    g->hMetric = (metric)h->hMetric;
+    g->hScale = h->hScale;
+    g->first = (int *)at(h, h->first);
+    g->adj = (int *)at(h, h->adj);
+    g->dist = (int *)at(h, h->dist);
+    g->lat = (int *)at(h, h->lat);
+    g->lgt = (int *)at(h, h->lgt);
+    g->component = (int *)at(h, h->component);
+    mem_track(MEM_GRAPH, h->bytes, 1);
+    return g;
+}
+
+
+/** private comparison of two nodes by name, for share_graph **/
+static const char * sorted_names;
+static int compName(const void * a, const void * b){
+    return strcmp(sorted_names + (size_t)*(const int *)a * NAME_BYTES,
+                  sorted_names + (size_t)*(const int *)b * NAME_BYTES);
+}
+
+
+/*************************************************************
+ * Copy a graph into a shared memory segment and make it read-only. An
+ * anonymous segment is shared with the processes forked afterwards; a
+ * named one can also be attached by other processes with attach_graph
+ * until unlink_graph removes its name. The estimate is copied, so
+ * calibrate the graph first.
+ * @param g the graph (plain or stored), left untouched
+ * @param name name of the segment ("/name"), NULL for an anonymous one
+ * @return the graph of the segment, read-only: it cannot be renumbered
+ * nor given arc-flags
+ * @return NULL if the segment cannot be created or memory allocation failed
+ *************************************************************/
+Graph * share_graph(Graph * g, char * name){
+    int n = g->nCities, m = g->nEdges;
+    SharedHeader layout = {{0}};
+    size_t off = (sizeof(SharedHeader) + 7) & ~(size_t)7;
+    size_t ints[8] = {n + 1, m + 1, m + 1, n + 1, n + 1, n + 1, 0, n + 1};
+    size_t * field[8] = {&layout.first, &layout.adj, &layout.dist, &layout.lat, &layout.lgt,
+                         &layout.component, &layout.names, &layout.byName};
+    for (int i = 0; i < 8; i++){
+        *field[i] = off;
+        off += i == 6 ? (size_t)n * NAME_BYTES : ints[i] * sizeof(int);
+        off = (off + 7) & ~(size_t)7;
+    }
+    
+    void * base;
+    if (name){
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) return NULL;
+        base = ftruncate(fd, off) == 0 ? mmap(NULL, off, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (base == MAP_FAILED) shm_unlink(name);
+    }
+    else base = mmap(NULL, off, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    
+    SharedHeader * h = (SharedHeader *)base;
+    *h = layout;
+    h->nCities = n;
+    h->nEdges = m;
+    h->nComponents = g->nComponents;
+    h->maxDegree = g->maxDegree;
+    h->hMetric = g->hMetric;
+    h->hScale = g->hScale;
+    h->bytes = off;
+    
+    /* roads decoded one node at a time, so stored graphs can be shared too */
+    int * first = (int *)at(h, h->first), * adj = (int *)at(h, h->adj), * dist = (int *)at(h, h->dist);
+    char * names = (char *)at(h, h->names);
+    int * byName = (int *)at(h, h->byName);
+    int e = 0;
+    for (int u = 0; u < n; u++){
+        const int * a, * d;
+        first[u] = e;
+        int degree = graph_roads(g, u, adj + e, dist + e, &a, &d);
+        if (a != adj + e){
+            memcpy(adj + e, a, degree * sizeof(int));
+            memcpy(dist + e, d, degree * sizeof(int));
+        }
+        e += degree;
+        char buf[NAME_BYTES];
+        strncpy(names + (size_t)u * NAME_BYTES, city_name(g, u, buf), NAME_BYTES);
+        byName[u] = u;
+    }
+    first[n] = e;
+    memcpy(at(h, h->lat), g->lat, n * sizeof(int));
+    memcpy(at(h, h->lgt), g->lgt, n * sizeof(int));
+    memcpy(at(h, h->component), g->component, n * sizeof(int));
+    sorted_names = names;
+    qsort(byName, n, sizeof(int), compName);
+    memcpy(h->magic, magic, 4);
+    
+    if (mprotect(base, off, PROT_READ) != 0){
+        munmap(base, off);
+        if (name) shm_unlink(name);
+        return NULL;
+    }
+    return view_graph(h);
+}
+
+
+/*************************************************************
+ * Attach read-only the graph of a named segment made by share_graph
+ * @param name name of the segment
+ * @return the graph, to destroy with delGraph (the segment is unmapped)
+ * @return NULL if there is no such segment or memory allocation failed
+ *************************************************************/
+Graph * attach_graph(char * name){
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    SharedHeader layout;
+    void * base = MAP_FAILED;
+    if (pread(fd, &layout, sizeof layout, 0) == sizeof layout && memcmp(layout.magic, magic, 4) == 0)
+        base = mmap(NULL, layout.bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return base == MAP_FAILED ? NULL : view_graph((SharedHeader *)base);
+}
+
+
+/*************************************************************
+ * Remove the name of a segment: it is freed once the last process
+ * having it mapped unmaps it
+ * @param name name of the segment
+ * @return ERRABSENT if there is no such segment
+ * @return OK otherwise
+ *************************************************************/
+status unlink_graph(char * name){
+    return shm_unlink(name) == 0 ? OK : ERRABSENT;
+}
+
+
+/*************************************************************
+ * Size of the segment of a shared graph
+ * @param g the graph
+ * @return the size in bytes, 0 if the graph is not shared
+ *************************************************************/
+size_t shared_bytes(Graph * g){
+    if (!g->store || g->store->del != delSegment) return 0;
+    return ((Segment *)g->store->data)->h->bytes;
+}
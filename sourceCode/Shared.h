@@ -0,0 +1,27 @@
+//
+//  Shared.h
+//  Astar
+//
+//  Graph held in one read-only shared memory segment, so that processes
+//  forked after it is built, or attaching it by name, search the same
+//  copy.
+//
+
+#ifndef Shared_h
+#define Shared_h
+
+#include "Graph.h"
+
+/** Copy a graph into a read-only shared memory segment, anonymous or named **/
+Graph * share_graph(Graph *, char *);
+
+/** Attach read-only the graph of a named segment made by share_graph **/
+Graph * attach_graph(char *);
+
+/** Remove the name of a segment: attached graphs stay valid **/
+status unlink_graph(char *);
+
+/** Size in bytes of the segment of a shared graph, 0 for another graph **/
+size_t shared_bytes(Graph *);
+
+#endif /* Shared_h */
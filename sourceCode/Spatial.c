@@ -0,0 +1,339 @@
+//
+//  Spatial.c
+//  Astar
+//
+//  k-d tree over the coordinates of the cities, packed in arrays with no
+//  pointer: the root of every range is its middle element, each split is
+//  on the coordinate of widest extent in the range, and the coordinates are
+//  copied in tree order so a search reads consecutive memory near the
+//  leaves. Built in O(n log n) by selecting medians, over the nodes that
+//  are cities (graph_live), never modified: a graph whose cities change
+//  drops it and find_place builds it again.
+//
+
+#include <stdio.h>
+#include <limits.h>
+#include "Spatial.h"
+
+
+/** private function putting the k-th smallest key of a[lo .. hi-1] at a[k],
+ * smaller or equal keys before it and greater or equal ones after it **/
+static void select_nth(int * a, int lo, int hi, int k, const int * key){
+    hi--;
+    while (hi > lo){
+        int pivot = key[a[(lo + hi) / 2]];
+        int i = lo, j = hi;
+        while (i <= j){
+            while (key[a[i]] < pivot) i++;
+            while (key[a[j]] > pivot) j--;
+            if (i <= j){
+                int t = a[i];
+                a[i++] = a[j];
+                a[j--] = t;
+            }
+        }
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else return;
+    }
+}
+
+/** private function building the subtree of the nodes in[lo .. hi-1] **/
+static void build_range(Spatial * s, const Graph * g, int lo, int hi){
+    if (hi - lo < 2){
+        if (lo < hi) s->axis[lo] = 0;
+        return;
+    }
+    int latMin = INT_MAX, latMax = INT_MIN, lgtMin = INT_MAX, lgtMax = INT_MIN;
+    for (int i = lo; i < hi; i++){
+        int u = s->node[i];
+        if (g->lat[u] < latMin) latMin = g->lat[u];
+        if (g->lat[u] > latMax) latMax = g->lat[u];
+        if (g->lgt[u] < lgtMin) lgtMin = g->lgt[u];
+        if (g->lgt[u] > lgtMax) lgtMax = g->lgt[u];
+    }
+    int mid = (lo + hi) / 2;
+    int axis = (long long)lgtMax - lgtMin > (long long)latMax - latMin;
+    select_nth(s->node, lo, hi, mid, axis ? g->lgt : g->lat);
+    s->axis[mid] = (unsigned char)axis;
+    build_range(s, g, lo, mid);
+    build_range(s, g, mid + 1, hi);
+}
+
+
+/*************************************************************
+ * Build the spatial index of the cities of a graph (the nodes of cities
+ * removed by deltas are left out)
+ * @param g the graph (its coordinates are read, not kept)
+ * @return the index, to destroy with delSpatial
+ * @return NULL if memory allocation failed
+ *************************************************************/
+Spatial * build_spatial(Graph * g){
+    Spatial * s = (Spatial *) malloc(sizeof(Spatial));
+    if (!s) return NULL;
+    int n = 0;
+    s->n = 0;
+    s->node = (int *) malloc((g->nCities + 1) * sizeof(int));
+    s->lat = (int *) malloc((g->nCities + 1) * sizeof(int));
+    s->lgt = (int *) malloc((g->nCities + 1) * sizeof(int));
+    s->axis = (unsigned char *) malloc(g->nCities + 1);
+    if (!s->node || !s->lat || !s->lgt || !s->axis){
+        delSpatial(s);
+        return NULL;
+    }
+    for (int u = 0; u < g->nCities; u++)
+        if (graph_live(g, u)) s->node[n++] = u;
+    s->n = n;
+    build_range(s, g, 0, n);
+    for (int i = 0; i < n; i++){
+        s->lat[i] = g->lat[s->node[i]];
+        s->lgt[i] = g->lgt[s->node[i]];
+    }
+    return s;
+}
+
+
+/*************************************************************
+ * Destroy a spatial index
+ * @param s the index, or NULL
+ *************************************************************/
+void delSpatial(Spatial * s){
+    if (!s) return;
+    free(s->node);
+    free(s->lat);
+    free(s->lgt);
+    free(s->axis);
+    free(s);
+}
+
+
+/*************************************************************
+ * Bytes taken by a spatial index
+ * @param s the index
+ * @return its size in bytes
+ *************************************************************/
+size_t spatial_bytes(const Spatial * s){
+    return sizeof(Spatial) + (size_t)s->n * (3 * sizeof(int) + 1);
+}
+
+
+/** A candidate of a nearest neighbour search **/
+typedef struct Near{
+    long long d;
+    int node;
+}Near;
+
+/** private order of candidates: by distance, then by node so that ties
+ * are broken the same way whatever the shape of the tree **/
+static inline int before(Near a, Near b){
+    return a.d < b.d || (a.d == b.d && a.node < b.node);
+}
+
+/** private function searching the range [lo, hi) for the nearest city **/
+static void nearest_range(const Spatial * s, int lo, int hi, long long x, long long y, Near * best){
+    while (lo < hi){
+        int mid = (lo + hi) / 2;
+        long long dx = x - s->lat[mid], dy = y - s->lgt[mid];
+        Near c = {dx * dx + dy * dy, s->node[mid]};
+        if (before(c, *best)) *best = c;
+        long long diff = s->axis[mid] ? dy : dx;
+        /* the side of the point first, the other one if the plane is near enough */
+        if (diff < 0){
+            nearest_range(s, lo, mid, x, y, best);
+            if (diff * diff > best->d) return;
+            lo = mid + 1;
+        }
+        else {
+            nearest_range(s, mid + 1, hi, x, y, best);
+            if (diff * diff > best->d) return;
+            hi = mid;
+        }
+    }
+}
+
+
+/*************************************************************
+ * City nearest to a point, by Euclidean distance on the coordinates;
+ * among cities at the same distance, the one of smallest node number
+ * @param s the index
+ * @param lat latitude of the point
+ * @param lgt longitude of the point
+ * @return the node of the city
+ * @return -1 if the index holds no city
+ *************************************************************/
+int nearest_city(const Spatial * s, int lat, int lgt){
+    Near best = {LLONG_MAX, INT_MAX};
+    nearest_range(s, 0, s->n, lat, lgt, &best);
+    return s->n ? best.node : -1;
+}
+
+
+/** State of a k nearest neighbours search: a max-heap of the k best candidates **/
+typedef struct KNear{
+    Near * heap;
+    int size;
+    int k;
+}KNear;
+
+/** private function offering a candidate to the heap of the k best **/
+static void offer(KNear * kn, Near c){
+    Near * h = kn->heap;
+    int i;
+    if (kn->size < kn->k){
+        /* sift up */
+        i = kn->size++;
+        while (i > 0 && before(h[(i - 1) / 2], c)){
+            h[i] = h[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        h[i] = c;
+        return;
+    }
+    if (!before(c, h[0])) return;
+    /* replace the worst and sift down */
+    i = 0;
+    for (;;){
+        int child = 2 * i + 1;
+        if (child >= kn->size) break;
+        if (child + 1 < kn->size && before(h[child], h[child + 1])) child++;
+        if (!before(c, h[child])) break;
+        h[i] = h[child];
+        i = child;
+    }
+    h[i] = c;
+}
+
+/** private distance beyond which no candidate can enter the heap **/
+static inline long long bound(const KNear * kn){
+    return kn->size < kn->k ? LLONG_MAX : kn->heap[0].d;
+}
+
+/** private function searching the range [lo, hi) for the k nearest cities **/
+static void knearest_range(const Spatial * s, int lo, int hi, long long x, long long y, KNear * kn){
+    while (lo < hi){
+        int mid = (lo + hi) / 2;
+        long long dx = x - s->lat[mid], dy = y - s->lgt[mid];
+        Near c = {dx * dx + dy * dy, s->node[mid]};
+        offer(kn, c);
+        long long diff = s->axis[mid] ? dy : dx;
+        if (diff < 0){
+            knearest_range(s, lo, mid, x, y, kn);
+            if (diff * diff > bound(kn)) return;
+            lo = mid + 1;
+        }
+        else {
+            knearest_range(s, mid + 1, hi, x, y, kn);
+            if (diff * diff > bound(kn)) return;
+            hi = mid;
+        }
+    }
+}
+
+
+/*************************************************************
+ * The k cities nearest to a point, nearest first (ties by node number)
+ * @param s the index
+ * @param lat latitude of the point
+ * @param lgt longitude of the point
+ * @param k number of cities wanted
+ * @param out (out) their nodes, room for k
+ * @return the number of cities found: k, or fewer if the index holds fewer
+ * @return -1 if memory allocation failed
+ *************************************************************/
+int nearest_cities(const Spatial * s, int lat, int lgt, int k, int * out){
+    if (k > s->n) k = s->n;
+    if (k <= 0) return 0;
+    KNear kn = {(Near *) malloc(k * sizeof(Near)), 0, k};
+    if (!kn.heap) return -1;
+    knearest_range(s, 0, s->n, lat, lgt, &kn);
+
+    /* empty the heap, the farthest first */
+    int found = kn.size;
+    while (kn.size > 0){
+        out[kn.size - 1] = kn.heap[0].node;
+        Near last = kn.heap[--kn.size];
+        int i = 0;
+        for (;;){
+            int child = 2 * i + 1;
+            if (child >= kn.size) break;
+            if (child + 1 < kn.size && before(kn.heap[child], kn.heap[child + 1])) child++;
+            if (!before(last, kn.heap[child])) break;
+            kn.heap[i] = kn.heap[child];
+            i = child;
+        }
+        if (kn.size > 0) kn.heap[i] = last;
+    }
+    free(kn.heap);
+    return found;
+}
+
+
+/** Box of a range query, and the cities found in it **/
+typedef struct Box{
+    int lat0, lgt0, lat1, lgt1;
+    int * out;
+    int max;
+    int found;
+}Box;
+
+/** private function collecting the cities of the range [lo, hi) inside the box **/
+static void box_range(const Spatial * s, int lo, int hi, Box * b){
+    while (lo < hi){
+        int mid = (lo + hi) / 2;
+        int x = s->lat[mid], y = s->lgt[mid];
+        if (x >= b->lat0 && x <= b->lat1 && y >= b->lgt0 && y <= b->lgt1){
+            if (b->found < b->max) b->out[b->found] = s->node[mid];
+            b->found++;
+        }
+        int split = s->axis[mid] ? y : x;
+        int low = s->axis[mid] ? b->lgt0 : b->lat0;
+        int high = s->axis[mid] ? b->lgt1 : b->lat1;
+        /* keys before mid are at most split, keys after it at least split */
+        if (high < split){
+            hi = mid;
+            continue;
+        }
+        if (low <= split) box_range(s, lo, mid, b);
+        lo = mid + 1;
+    }
+}
+
+
+/*************************************************************
+ * Cities inside a box, in no particular order
+ * @param s the index
+ * @param lat0 smallest latitude of the box
+ * @param lgt0 smallest longitude of the box
+ * @param lat1 largest latitude of the box
+ * @param lgt1 largest longitude of the box
+ * @param out (out) the nodes of the cities, room for max
+ * @param max most nodes stored in out
+ * @return the number of cities in the box, which may exceed max
+ *************************************************************/
+int cities_in_box(const Spatial * s, int lat0, int lgt0, int lat1, int lgt1, int * out, int max){
+    Box b = {lat0, lgt0, lat1, lgt1, out, max, 0};
+    if (lat0 <= lat1 && lgt0 <= lgt1) box_range(s, 0, s->n, &b);
+    return b.found;
+}
+
+
+/*************************************************************
+ * Node of a city given by its name, or by coordinates written "lat,lgt"
+ * (the city nearest to them). The spatial index of the graph is built by
+ * the first lookup by coordinates, and again after deltas added or removed
+ * cities; so that one must not run concurrently with other lookups.
+ * @param g the graph
+ * @param place name or coordinates of the city
+ * @return -1 if there is no such city or memory allocation failed
+ * @return the node of the city otherwise
+ *************************************************************/
+int find_place(Graph * g, char * place){
+    int lat, lgt;
+    char end;
+    if (sscanf(place, "%d,%d%c", &lat, &lgt, &end) != 2) return find_node(g, place);
+    if (!g->spatial){
+        g->spatial = build_spatial(g);
+        if (!g->spatial) return -1;
+    }
+    return nearest_city(g->spatial, lat, lgt);
+}
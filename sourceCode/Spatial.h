@@ -0,0 +1,50 @@
+//
+//  Spatial.h
+//  Astar
+//
+//  Spatial index of the cities of a graph: a k-d tree over their
+//  coordinates, for the city nearest to a point, the k nearest ones and
+//  the cities inside a box.
+//
+
+#ifndef Spatial_h
+#define Spatial_h
+
+#include "Graph.h"
+
+/** Spatial structure: a balanced k-d tree packed in arrays. The subtree
+ * of the range [lo, hi) has its root at mid = (lo + hi) / 2, split on
+ * latitude if axis[mid] is 0 and on longitude otherwise; the coordinates
+ * are stored in tree order next to the node numbers **/
+typedef struct Spatial{
+    int n;
+    int * node;
+    int * lat;
+    int * lgt;
+    unsigned char * axis;
+}Spatial;
+
+/** Build the spatial index of the cities of a graph **/
+Spatial * build_spatial(Graph *);
+
+/** Destroy a spatial index **/
+void delSpatial(Spatial *);
+
+/** Bytes taken by a spatial index **/
+size_t spatial_bytes(const Spatial *);
+
+/** City nearest to a point (Euclidean distance on lat, lgt), -1 if none **/
+int nearest_city(const Spatial *, int, int);
+
+/** The k cities nearest to a point, nearest first: returns their number (at most k) **/
+int nearest_cities(const Spatial *, int, int, int, int *);
+
+/** Cities inside a box (lat0, lgt0, lat1, lgt1, bounds included): returns
+ * their number, of which at most max are stored **/
+int cities_in_box(const Spatial *, int, int, int, int, int *, int);
+
+/** Node of a city given by name or as coordinates "lat,lgt" (the nearest
+ * city), building the spatial index of the graph on first use **/
+int find_place(Graph *, char *);
+
+#endif /* Spatial_h */
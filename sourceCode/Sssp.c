@@ -0,0 +1,361 @@
+//
+//  Sssp.c
+//  Astar
+//
+//  Single-source shortest paths: the distance from one city to every
+//  other one, with the shortest path tree as parent links.
+//
+//  delta_stepping keeps nodes in buckets of width delta of tentative
+//  distance. The smallest non-empty bucket is settled by all threads at
+//  once: its nodes relax their light roads (distance <= delta), which may
+//  refill the same bucket, until it stays empty; then the heavy roads of
+//  every node settled in the bucket are relaxed once. The distance and
+//  the parent of a node are packed in one 64-bit word updated by
+//  compare-and-swap, so a relaxation never needs a lock.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "Sssp.h"
+#include "Heap.h"
+
+/** packed tentative distance (high half) and parent (low half) of a node **/
+#define PACK(d, p) (((uint64_t)(uint32_t)(d) << 32) | (uint32_t)(p))
+#define DIST(x) ((int)((x) >> 32))
+#define PARENT(x) ((int)(uint32_t)(x))
+
+
+/*************************************************************
+ * Sequential Dijkstra from a source
+ * @param g the graph
+ * @param source index of the source city
+ * @param dist (out) distance of every node from source, UNREACHED if none
+ * @param parent (out) predecessor of every node on its shortest path, -1 if none
+ * @return ERRINDEX if source is not a node of the graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ *************************************************************/
+status dijkstra(Graph * g, int source, int * dist, int * parent){
+    if (source < 0 || source >= g->nCities) return ERRINDEX;
+    Heap * open = newHeap(1024);
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    status res = OK;
+    if (!open || !adjBuf || !distBuf){
+        res = ERRALLOC;
+        goto done;
+    }
+    
+    for (int u = 0; u < g->nCities; u++){
+        dist[u] = UNREACHED;
+        parent[u] = -1;
+    }
+    dist[source] = 0;
+    pushHeap(open, 0, source);
+    
+    HeapItem top;
+    while (popHeap(open, &top) == OK){
+        int u = top.node;
+        if (top.key != dist[u]) continue;
+        const int * adj, * d;
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &d);
+        for (int k = 0; k < degree; k++){
+            int nd = top.key + d[k];
+            if (nd >= dist[adj[k]]) continue;
+            dist[adj[k]] = nd;
+            parent[adj[k]] = u;
+            if (pushHeap(open, nd, adj[k]) != OK){
+                res = ERRALLOC;
+                goto done;
+            }
+        }
+    }
+    
+done:
+    delHeap(open);
+    free(adjBuf);
+    free(distBuf);
+    return res;
+}
+
+
+/** Growable array of nodes **/
+typedef struct Vec{
+    int size;
+    int capacity;
+    int * items;
+}Vec;
+
+static int push(Vec * v, int x){
+    if (v->size == v->capacity){
+        int capacity = v->capacity ? 2 * v->capacity : 256;
+        int * bigger = (int *) realloc(v->items, capacity * sizeof(int));
+        if (!bigger) return 0;
+        v->items = bigger;
+        v->capacity = capacity;
+    }
+    v->items[v->size++] = x;
+    return 1;
+}
+
+
+/** State shared by the threads of a delta-stepping run **/
+typedef struct Stepping{
+    Graph * g;
+    int delta;
+    int nThreads;
+    int nBuckets;
+    uint64_t * tent;
+    int * settled;
+    Vec * buckets;          /* nThreads x nBuckets, cyclic on the bucket index */
+    Vec frontier;
+    int * counts;           /* entries of the current bucket, per thread */
+    int current;
+    int finished;
+    int failed;             /* set by any thread, read once they all wait */
+    int ready;
+    pthread_mutex_t lock;
+    pthread_cond_t go;
+    pthread_barrier_t barrier;
+}Stepping;
+
+typedef struct Worker{
+    Stepping * s;
+    int id;
+}Worker;
+
+
+/*************************************************************
+ * private function lowering the tentative distance of v to nd through u,
+ * and filing v in the bucket of its new distance if it improved
+ *************************************************************/
+static void relax(Stepping * s, Vec * mine, int u, int v, int nd){
+    uint64_t old = __atomic_load_n(&s->tent[v], __ATOMIC_RELAXED);
+    while (nd < DIST(old)){
+        if (__atomic_compare_exchange_n(&s->tent[v], &old, PACK(nd, u), 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+            if (!push(&mine[(nd / s->delta) % s->nBuckets], v)) __atomic_store_n(&s->failed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+
+/*************************************************************
+ * private function run by every thread: settle buckets one after the
+ * other, in lockstep with the other threads
+ *************************************************************/
+static void * stepping_worker(void * arg){
+    Worker * w = (Worker *)arg;
+    Stepping * s = w->s;
+    Graph * g = s->g;
+    Vec * mine = s->buckets + (size_t)w->id * s->nBuckets;
+    Vec heavy = {0, 0, NULL};
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    if (!adjBuf || !distBuf) __atomic_store_n(&s->failed, 1, __ATOMIC_RELAXED);
+    
+    /* wait until the number of threads, hence the barrier, is known */
+    pthread_mutex_lock(&s->lock);
+    while (!s->ready) pthread_cond_wait(&s->go, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+    
+    for (;;){
+        /* thread 0 picks the smallest non-empty bucket after the current one */
+        pthread_barrier_wait(&s->barrier);
+        if (w->id == 0){
+            s->finished = 1;
+            for (int k = 0; k < s->nBuckets && s->finished && !__atomic_load_n(&s->failed, __ATOMIC_RELAXED); k++){
+                int b = (s->current + k) % s->nBuckets;
+                for (int t = 0; t < s->nThreads; t++)
+                    if (s->buckets[(size_t)t * s->nBuckets + b].size){
+                        s->current += k;
+                        s->finished = 0;
+                        break;
+                    }
+            }
+        }
+        pthread_barrier_wait(&s->barrier);
+        if (s->finished || __atomic_load_n(&s->failed, __ATOMIC_RELAXED)) break;
+        int i = s->current, slot = i % s->nBuckets;
+        
+        /* light phase: until nobody refills the current bucket */
+        for (;;){
+            s->counts[w->id] = mine[slot].size;
+            pthread_barrier_wait(&s->barrier);
+            int total = 0, at = 0;
+            for (int t = 0; t < s->nThreads; t++){
+                if (t < w->id) at += s->counts[t];
+                total += s->counts[t];
+            }
+            if (total == 0) break;
+            if (w->id == 0 && s->frontier.capacity < total){
+                int * bigger = (int *) realloc(s->frontier.items, total * sizeof(int));
+                if (bigger){
+                    s->frontier.items = bigger;
+                    s->frontier.capacity = total;
+                }
+                else __atomic_store_n(&s->failed, 1, __ATOMIC_RELAXED);
+            }
+            pthread_barrier_wait(&s->barrier);
+            /* the capacity is only changed by thread 0 above, while failed may
+             * already be set by a thread relaxing roads: every thread must
+             * take the same way */
+            if (s->frontier.capacity < total){
+                /* no room to gather the bucket: drop it, the run is reported as failed */
+                mine[slot].size = 0;
+                pthread_barrier_wait(&s->barrier);
+                continue;
+            }
+            memcpy(s->frontier.items + at, mine[slot].items, mine[slot].size * sizeof(int));
+            mine[slot].size = 0;
+            pthread_barrier_wait(&s->barrier);
+            
+            /* every thread takes an even share of the bucket */
+            int lo = (int)((long)total * w->id / s->nThreads);
+            int hi = (int)((long)total * (w->id + 1) / s->nThreads);
+            for (int j = lo; j < hi; j++){
+                int u = s->frontier.items[j];
+                int du = DIST(__atomic_load_n(&s->tent[u], __ATOMIC_RELAXED));
+                
+                /* outdated entry, or entry already handled at this distance */
+                if (du / s->delta != i) continue;
+                if (__atomic_exchange_n(&s->settled[u], du, __ATOMIC_RELAXED) == du) continue;
+                if (!push(&heavy, u)) __atomic_store_n(&s->failed, 1, __ATOMIC_RELAXED);
+                
+                const int * adj, * d;
+                int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &d);
+                for (int k = 0; k < degree; k++)
+                    if (d[k] <= s->delta) relax(s, mine, u, adj[k], du + d[k]);
+            }
+            pthread_barrier_wait(&s->barrier);
+        }
+        
+        /* heavy phase: roads longer than delta of the nodes settled in the bucket */
+        for (int j = 0; j < heavy.size; j++){
+            int u = heavy.items[j];
+            int du = DIST(__atomic_load_n(&s->tent[u], __ATOMIC_RELAXED));
+            const int * adj, * d;
+            int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &d);
+            for (int k = 0; k < degree; k++)
+                if (d[k] > s->delta) relax(s, mine, u, adj[k], du + d[k]);
+        }
+        heavy.size = 0;
+    }
+    
+    free(heavy.items);
+    free(adjBuf);
+    free(distBuf);
+    return NULL;
+}
+
+
+/*************************************************************
+ * Parallel delta-stepping from a source
+ * @param g the graph
+ * @param source index of the source city
+ * @param delta width of the buckets, 0 to use the average road distance
+ * @param nThreads number of threads, 0 to use every online processor
+ * @param dist (out) distance of every node from source, UNREACHED if none
+ * @param parent (out) predecessor of every node on its shortest path, -1 if none
+ * @return ERRINDEX if source is not a node of the graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise (with fewer threads if some could not be created)
+ *************************************************************/
+status delta_stepping(Graph * g, int source, int delta, int nThreads, int * dist, int * parent){
+    if (source < 0 || source >= g->nCities) return ERRINDEX;
+    int * adjBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    int * distBuf = (int *) malloc((g->maxDegree + 1) * sizeof(int));
+    if (!adjBuf || !distBuf){
+        free(adjBuf);
+        free(distBuf);
+        return ERRALLOC;
+    }
+    
+    /* the longest road bounds how far ahead of the current bucket a node can be filed */
+    long sum = 0;
+    int maxRoad = 1, nRoads = 0;
+    for (int u = 0; u < g->nCities; u++){
+        const int * adj, * d;
+        int degree = graph_roads(g, u, adjBuf, distBuf, &adj, &d);
+        for (int k = 0; k < degree; k++){
+            sum += d[k];
+            if (d[k] > maxRoad) maxRoad = d[k];
+        }
+        nRoads += degree;
+    }
+    free(adjBuf);
+    free(distBuf);
+    if (delta <= 0) delta = nRoads ? (int)(sum / nRoads) : 1;
+    if (delta <= 0) delta = 1;
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads <= 0) nThreads = 1;
+    
+    Stepping s;
+    memset(&s, 0, sizeof(s));
+    s.g = g;
+    s.delta = delta;
+    s.nThreads = nThreads;
+    s.nBuckets = maxRoad / delta + 2;
+    s.tent = (uint64_t *) malloc((g->nCities + 1) * sizeof(uint64_t));
+    s.settled = (int *) malloc((g->nCities + 1) * sizeof(int));
+    s.buckets = (Vec *) calloc((size_t)nThreads * s.nBuckets, sizeof(Vec));
+    s.counts = (int *) calloc(nThreads, sizeof(int));
+    Worker * workers = (Worker *) malloc(nThreads * sizeof(Worker));
+    pthread_t * threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
+    status res = OK;
+    if (!s.tent || !s.settled || !s.buckets || !s.counts || !workers || !threads){
+        res = ERRALLOC;
+        goto done;
+    }
+    
+    for (int u = 0; u < g->nCities; u++){
+        s.tent[u] = PACK(UNREACHED, -1);
+        s.settled[u] = -1;
+    }
+    s.tent[source] = PACK(0, -1);
+    push(&s.buckets[0], source);
+    
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.go, NULL);
+    for (int t = 0; t < nThreads; t++){
+        workers[t].s = &s;
+        workers[t].id = t;
+    }
+    int started;
+    for (started = 1; started < nThreads; started++)
+        if (pthread_create(&threads[started], NULL, stepping_worker, &workers[started]) != 0) break;
+    
+    /* run with the threads that could be created, the caller being thread 0 */
+    s.nThreads = started;
+    pthread_barrier_init(&s.barrier, NULL, started);
+    pthread_mutex_lock(&s.lock);
+    s.ready = 1;
+    pthread_cond_broadcast(&s.go);
+    pthread_mutex_unlock(&s.lock);
+    stepping_worker(&workers[0]);
+    for (int t = 1; t < started; t++) pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&s.barrier);
+    pthread_cond_destroy(&s.go);
+    pthread_mutex_destroy(&s.lock);
+    
+    if (s.failed) res = ERRALLOC;
+    else for (int u = 0; u < g->nCities; u++){
+        dist[u] = DIST(s.tent[u]);
+        parent[u] = PARENT(s.tent[u]);
+    }
+    
+done:
+    if (s.buckets)
+        for (int b = 0; b < nThreads * s.nBuckets; b++) free(s.buckets[b].items);
+    free(s.buckets);
+    free(s.tent);
+    free(s.settled);
+    free(s.counts);
+    free(s.frontier.items);
+    free(workers);
+    free(threads);
+    return res;
+}
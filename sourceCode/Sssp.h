@@ -0,0 +1,24 @@
+//
+//  Sssp.h
+//  Astar
+//
+//  Single-source shortest paths: the distance from one city to every
+//  other one, with the shortest path tree as parent links.
+//
+
+#ifndef Sssp_h
+#define Sssp_h
+
+#include <limits.h>
+#include "Graph.h"
+
+/** distance of the nodes that cannot be reached from the source **/
+#define UNREACHED INT_MAX
+
+/** Sequential Dijkstra from a source **/
+status dijkstra(Graph *, int, int *, int *);
+
+/** Parallel delta-stepping from a source **/
+status delta_stepping(Graph *, int, int, int, int *, int *);
+
+#endif /* Sssp_h */
@@ -0,0 +1,452 @@
+//
+//  Tiles.c
+//  Astar
+//
+//  Tiled storage of a graph for maps larger than memory.
+//
+//  Tile t holds nodes t*tileNodes to (t+1)*tileNodes-1, so a graph renumbered
+//  along a Hilbert curve (see Reorder.h) gets compact geographic tiles. The
+//  coordinates and components of every node stay in memory for the
+//  heuristic and the component check; roads and names live in the tiles.
+//
+//  File layout (native int sizes and byte order):
+//    "ATL2", n, m, maxDegree, nComponents, tileNodes, nTiles, hMetric
+//    hScale                        (double) scale of the estimate
+//    lat[n], lgt[n], component[n]
+//    offset[nTiles+1]              (long long) file position of every tile
+//    index[n]                      {name[20], node} sorted by name
+//    tiles: first[k+1] (local), adj[mt], dist[mt], names[k][20]
+//
+//  Tiles are read with pread into a cache of bounded size; the least
+//  recently used tiles are evicted when a new one does not fit. The cache
+//  is protected by a lock, and roads are copied out of it, so concurrent
+//  searches can share a tiled graph.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Tiles.h"
+#include "Memory.h"
+
+static const char magic[4] = {'A', 'T', 'L', '2'};
+#define HEADER_INTS 7
+/** bytes before the coordinates: magic, counts and scale of the estimate **/
+#define HEADER_BYTES (4 + HEADER_INTS * sizeof(int) + sizeof(double))
+
+/** Name index entry of a tiled file **/
+typedef struct NameEntry{
+    char name[20];
+    int node;
+}NameEntry;
+
+/** A tile in memory, linked in the LRU list of the cache **/
+typedef struct Tile{
+    int id;
+    size_t bytes;
+    int * first;
+    int * adj;
+    int * dist;
+    char (*names)[20];
+    struct Tile * prev;
+    struct Tile * next;
+}Tile;
+
+/** Open tiled file and its cache **/
+typedef struct Tiled{
+    int fd;
+    int nCities;
+    int tileNodes;
+    int nTiles;
+    long long * offset;
+    long long indexAt;
+    Tile ** tiles;
+    Tile * mru;
+    Tile * lru;
+    TileStats stats;
+    pthread_mutex_t lock;
+}Tiled;
+
+
+/** private function reading exactly bytes at a file position **/
+static int read_at(int fd, void * buf, size_t bytes, long long at){
+    char * p = (char *)buf;
+    while (bytes){
+        ssize_t r = pread(fd, p, bytes, (off_t)at);
+        if (r <= 0) return 0;
+        p += r;
+        bytes -= r;
+        at += r;
+    }
+    return 1;
+}
+
+static void unlink_tile(Tiled * t, Tile * tile){
+    if (tile->prev) tile->prev->next = tile->next; else t->mru = tile->next;
+    if (tile->next) tile->next->prev = tile->prev; else t->lru = tile->prev;
+}
+
+static void push_front(Tiled * t, Tile * tile){
+    tile->prev = NULL;
+    tile->next = t->mru;
+    if (t->mru) t->mru->prev = tile; else t->lru = tile;
+    t->mru = tile;
+}
+
+
+/** private function testing a tile just read: as many roads as its size
+ * holds, first offsets in order and roads to nodes of the graph **/
+static int valid_tile(const Tiled * t, const Tile * tile, int k){
+    int mt = tile->first[k];
+    if (tile->first[0] != 0 || mt < 0 || (k + 1 + 2 * (size_t)mt) * sizeof(int) + k * 20 != tile->bytes) return 0;
+    for (int i = 0; i < k; i++)
+        if (tile->first[i + 1] < tile->first[i]) return 0;
+    for (int e = 0; e < mt; e++)
+        if (tile->adj[e] < 0 || tile->adj[e] >= t->nCities) return 0;
+    return 1;
+}
+
+
+/*************************************************************
+ * private function returning tile id, resident and most recently used,
+ * reading it if needed (cache lock held)
+ *************************************************************/
+static Tile * get_tile(Tiled * t, int id){
+    Tile * tile = t->tiles[id];
+    if (tile){
+        t->stats.hits++;
+        if (tile != t->mru){
+            unlink_tile(t, tile);
+            push_front(t, tile);
+        }
+        return tile;
+    }
+    
+    t->stats.misses++;
+    long long at = t->offset[id];
+    size_t bytes = (size_t)(t->offset[id + 1] - at);
+    int k = t->tileNodes;
+    if ((id + 1) * (long)t->tileNodes > t->nCities) k = t->nCities - id * t->tileNodes;
+    
+    /* make room, keeping at least the tile being read */
+    while (t->lru && t->stats.residentBytes + bytes > t->stats.budgetBytes){
+        Tile * victim = t->lru;
+        unlink_tile(t, victim);
+        t->tiles[victim->id] = NULL;
+        t->stats.residentBytes -= victim->bytes;
+        t->stats.resident--;
+        t->stats.evictions++;
+        mem_free(MEM_CACHES, victim, sizeof(Tile) + victim->bytes);
+    }
+    
+    tile = (Tile *) mem_alloc(MEM_CACHES, sizeof(Tile) + bytes);
+    if (!tile) return NULL;
+    if (!read_at(t->fd, tile + 1, bytes, at)){
+        mem_free(MEM_CACHES, tile, sizeof(Tile) + bytes);
+        return NULL;
+    }
+    tile->id = id;
+    tile->bytes = bytes;
+    tile->first = (int *)(tile + 1);
+    int mt = tile->first[k];
+    tile->adj = tile->first + k + 1;
+    tile->dist = tile->adj + mt;
+    tile->names = (char (*)[20])(tile->dist + mt);
+    if (!valid_tile(t, tile, k)){
+        mem_free(MEM_CACHES, tile, sizeof(Tile) + bytes);
+        return NULL;
+    }
+    
+    t->tiles[id] = tile;
+    push_front(t, tile);
+    t->stats.resident++;
+    t->stats.residentBytes += bytes;
+    if (t->stats.residentBytes > t->stats.peakBytes) t->stats.peakBytes = t->stats.residentBytes;
+    return tile;
+}
+
+
+/** decoding function of the roads of a node, see GraphStore **/
+static int tiled_roads(void * data, int u, int * adj, int * dist){
+    Tiled * t = (Tiled *)data;
+    pthread_mutex_lock(&t->lock);
+    Tile * tile = get_tile(t, u / t->tileNodes);
+    int degree = 0;
+    if (tile){
+        int i = u % t->tileNodes;
+        degree = tile->first[i+1] - tile->first[i];
+        memcpy(adj, tile->adj + tile->first[i], degree * sizeof(int));
+        memcpy(dist, tile->dist + tile->first[i], degree * sizeof(int));
+    }
+    pthread_mutex_unlock(&t->lock);
+    return degree;
+}
+
+/** decoding function of the name of a node, see GraphStore **/
+static void tiled_name(void * data, int u, char * buf){
+    Tiled * t = (Tiled *)data;
+    pthread_mutex_lock(&t->lock);
+    Tile * tile = get_tile(t, u / t->tileNodes);
+    if (tile) memcpy(buf, tile->names[u % t->tileNodes], 20);
+    else strcpy(buf, "?");
+    pthread_mutex_unlock(&t->lock);
+}
+
+/** lookup function of a node by its name: binary search in the file index **/
+static int tiled_find(void * data, char * name){
+    Tiled * t = (Tiled *)data;
+    int lo = 0, hi = t->nCities - 1;
+    NameEntry e;
+    while (lo <= hi){
+        int mid = (lo + hi) / 2;
+        if (!read_at(t->fd, &e, sizeof(e), t->indexAt + (long long)mid * sizeof(e))) return -1;
+        int c = strcmp(name, e.name);
+        if (c == 0) return e.node;
+        if (c < 0) hi = mid - 1; else lo = mid + 1;
+    }
+    return -1;
+}
+
+static void delTiled(void * data){
+    Tiled * t = (Tiled *)data;
+    if (!t) return;
+    while (t->mru){
+        Tile * tile = t->mru;
+        t->mru = tile->next;
+        mem_free(MEM_CACHES, tile, sizeof(Tile) + tile->bytes);
+    }
+    if (t->fd >= 0) close(t->fd);
+    pthread_mutex_destroy(&t->lock);
+    free(t->offset);
+    free(t->tiles);
+    free(t);
+}
+
+
+/** private comparison of name index entries **/
+static int compEntry(const void * a, const void * b){
+    return strcmp(((const NameEntry *)a)->name, ((const NameEntry *)b)->name);
+}
+
+
+/*************************************************************
+ * Write a plain graph as a tiled file, tiles following the current node
+ * order (renumber the graph along a Hilbert curve first)
+ * @param g the plain graph
+ * @param tileNodes number of nodes per tile, 0 for TILE_NODES
+ * @param filepath file to write
+ * @return ERRUNABLE if the graph is not made of plain arrays
+ * @return ERRALLOC if memory allocation failed
+ * @return ERROPEN if the file cannot be created
+ * @return ERRCLOSE if writing failed
+ * @return OK otherwise
+ *************************************************************/
+status save_tiled(Graph * g, int tileNodes, char * filepath){
+    int n = g->nCities;
+    if (g->store) return ERRUNABLE;
+    if (tileNodes <= 0) tileNodes = TILE_NODES;
+    int nTiles = (n + tileNodes - 1) / tileNodes;
+    long long * offset = (long long *) malloc((nTiles + 1) * sizeof(long long));
+    NameEntry * index = (NameEntry *) calloc(n + 1, sizeof(NameEntry));
+    char (*names)[20] = (char (*)[20]) calloc(tileNodes, 20);
+    int * first = (int *) malloc((tileNodes + 1) * sizeof(int));
+    if (!offset || !index || !names || !first){
+        free(offset); free(index); free(names); free(first);
+        return ERRALLOC;
+    }
+    FILE * f = fopen(filepath, "wb");
+    if (!f){
+        free(offset); free(index); free(names); free(first);
+        return ERROPEN;
+    }
+    
+    for (int u = 0; u < n; u++){
+        memcpy(index[u].name, g->cities[u]->name, strlen(g->cities[u]->name) + 1);
+        index[u].node = u;
+    }
+    qsort(index, n, sizeof(NameEntry), compEntry);
+    
+    /* tile positions follow the fixed-size sections */
+    long long at = HEADER_BYTES + 3 * (long long)n * sizeof(int)
+        + (nTiles + 1) * sizeof(long long) + (long long)n * sizeof(NameEntry);
+    for (int id = 0; id < nTiles; id++){
+        int lo = id * tileNodes, hi = lo + tileNodes < n ? lo + tileNodes : n;
+        int mt = g->first[hi] - g->first[lo];
+        offset[id] = at;
+        at += (hi - lo + 1) * sizeof(int) + 2 * (long long)mt * sizeof(int) + (hi - lo) * 20;
+    }
+    offset[nTiles] = at;
+    
+    int header[HEADER_INTS] = {n, g->nEdges, g->maxDegree, g->nComponents, tileNodes, nTiles, g->hMetric};
+    int ok = fwrite(magic, 1, 4, f) == 4
+        && fwrite(header, sizeof(int), HEADER_INTS, f) == HEADER_INTS
+        && fwrite(&g->hScale, sizeof(double), 1, f) == 1
+        && fwrite(g->lat, sizeof(int), n, f) == (size_t)n
+        && fwrite(g->lgt, sizeof(int), n, f) == (size_t)n
+        && fwrite(g->component, sizeof(int), n, f) == (size_t)n
+        && fwrite(offset, sizeof(long long), nTiles + 1, f) == (size_t)nTiles + 1
+        && fwrite(index, sizeof(NameEntry), n, f) == (size_t)n;
+    
+    for (int id = 0; ok && id < nTiles; id++){
+        int lo = id * tileNodes, hi = lo + tileNodes < n ? lo + tileNodes : n;
+        int mt = g->first[hi] - g->first[lo];
+        memset(names, 0, (size_t)tileNodes * 20);
+        for (int u = lo; u <= hi; u++) first[u - lo] = g->first[u] - g->first[lo];
+        for (int u = lo; u < hi; u++) memcpy(names[u - lo], g->cities[u]->name, strlen(g->cities[u]->name) + 1);
+        ok = fwrite(first, sizeof(int), hi - lo + 1, f) == (size_t)(hi - lo + 1)
+            && fwrite(g->adj + g->first[lo], sizeof(int), mt, f) == (size_t)mt
+            && fwrite(g->dist + g->first[lo], sizeof(int), mt, f) == (size_t)mt
+            && fwrite(names, 20, hi - lo, f) == (size_t)(hi - lo);
+    }
+    
+    if (fclose(f) != 0) ok = 0;
+    free(offset); free(index); free(names); free(first);
+    return ok ? OK : ERRCLOSE;
+}
+
+
+/** private function testing the header of a tiled file: counts that agree
+ * with each other, a known metric and a scale that is a number, and fixed
+ * sections that fit in the file **/
+static int valid_header(const int * header, double scale, long long size){
+    int n = header[0], tileNodes = header[4];
+    if (n < 0 || header[1] < 0 || header[2] < 0 || header[2] > header[1] || header[3] < 0 || header[3] > n
+        || tileNodes <= 0 || header[5] != (int)((n + (long long)tileNodes - 1) / tileNodes)
+        || header[6] < METRIC_MANHATTAN || header[6] > METRIC_GREAT_CIRCLE || !(scale >= 0 && scale < HUGE_VAL))
+        return 0;
+    long long fixed = HEADER_BYTES + 3 * (long long)n * sizeof(int)
+        + (header[5] + 1LL) * sizeof(long long) + (long long)n * sizeof(NameEntry);
+    return fixed <= size;
+}
+
+/** private function testing the tile directory and the components read
+ * from a tiled file: every tile between the name index and the end of the
+ * file, with room for its first offsets and names and whole roads **/
+static int valid_tiles(const Tiled * t, const Graph * g, long long size){
+    long long at = t->indexAt + (long long)t->nCities * sizeof(NameEntry);
+    if (t->offset[0] != at || t->offset[t->nTiles] != size) return 0;
+    for (int id = 0; id < t->nTiles; id++){
+        int k = t->tileNodes;
+        if ((id + 1) * (long long)t->tileNodes > t->nCities) k = t->nCities - id * t->tileNodes;
+        long long roads = t->offset[id + 1] - t->offset[id] - (k + 1LL) * sizeof(int) - k * 20LL;
+        if (roads < 0 || roads % (2 * sizeof(int)) != 0) return 0;
+    }
+    for (int u = 0; u < t->nCities; u++)
+        if (g->component[u] < 0 || g->component[u] >= g->nComponents) return 0;
+    return 1;
+}
+
+
+/*************************************************************
+ * Open a tiled file: only the coordinates, components and tile directory
+ * are read, tiles are read on demand by the searches. The counts of the
+ * header and the tile directory are checked against the size of the
+ * file; a tile whose road count disagrees with its size is refused when
+ * it is read.
+ * @param filepath file to read
+ * @param budget maximum bytes of resident tiles (at least one tile is kept)
+ * @return the tiled graph
+ * @return NULL if the file cannot be read or is not a well-formed tiled graph
+ *************************************************************/
+Graph * load_tiled(char * filepath, size_t budget){
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return NULL;
+    char m[4];
+    int header[HEADER_INTS];
+    double scale;
+    long long size = (long long)lseek(fd, 0, SEEK_END);
+    if (size < 0 || !read_at(fd, m, 4, 0) || memcmp(m, magic, 4) != 0 ||
+        !read_at(fd, header, sizeof(header), 4) || !read_at(fd, &scale, sizeof(double), 4 + sizeof(header)) ||
+        !valid_header(header, scale, size)){
+        close(fd);
+        return NULL;
+    }
+    int n = header[0], nTiles = header[5];
+    
+    Graph * g = (Graph *) calloc(1, sizeof(Graph));
+    Tiled * t = (Tiled *) calloc(1, sizeof(Tiled));
+    GraphStore * store = (GraphStore *) malloc(sizeof(GraphStore));
+    if (g){
+        g->nodeRoom = n + 1;
+        g->lat = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+        g->lgt = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+        g->component = (int *) mem_alloc(MEM_GRAPH, g->nodeRoom * sizeof(int));
+    }
+    if (t){
+        t->fd = fd;
+        t->offset = (long long *) malloc((nTiles + 1) * sizeof(long long));
+        t->tiles = (Tile **) calloc(nTiles + 1, sizeof(Tile *));
+        pthread_mutex_init(&t->lock, NULL);
+    }
+    long long at = HEADER_BYTES;
+    if (!g || !t || !store || !g->lat || !g->lgt || !g->component || !t->offset || !t->tiles ||
+        !read_at(fd, g->lat, n * sizeof(int), at) ||
+        !read_at(fd, g->lgt, n * sizeof(int), at + (long long)n * sizeof(int)) ||
+        !read_at(fd, g->component, n * sizeof(int), at + 2 * (long long)n * sizeof(int)) ||
+        !read_at(fd, t->offset, (nTiles + 1) * sizeof(long long), at + 3 * (long long)n * sizeof(int))){
+        free(store);
+        if (t) delTiled(t); else close(fd);
+        delGraph(g);
+        return NULL;
+    }
+    
+    t->nCities = n;
+    t->tileNodes = header[4];
+    t->nTiles = nTiles;
+    t->indexAt = at + 3 * (long long)n * sizeof(int) + (nTiles + 1) * sizeof(long long);
+    t->stats.budgetBytes = budget;
+    store->roads = tiled_roads;
+    store->name = tiled_name;
+    store->find = tiled_find;
+    store->live = NULL;
+    store->del = delTiled;
+    store->data = t;
+    g->store = store;
+    g->nCities = n;
+    g->nEdges = header[1];
+    g->hMetric = (metric)header[6];
+    g->hScale = scale;
+    g->maxDegree = header[2];
+    g->nComponents = header[3];
+    if (!valid_tiles(t, g, size)){
+        delGraph(g);
+        return NULL;
+    }
+    return g;
+}
+
+
+/*************************************************************
+ * Test whether a file holds a tiled graph
+ * @param filepath file to test
+ * @return 1 if the file starts with the magic of tiled graphs
+ * @return 0 otherwise
+ *************************************************************/
+int is_tiled(char * filepath){
+    FILE * f = fopen(filepath, "rb");
+    char m[4];
+    if (!f) return 0;
+    int res = fread(m, 1, 4, f) == 4 && memcmp(m, magic, 4) == 0;
+    fclose(f);
+    return res;
+}
+
+
+/*************************************************************
+ * Read the counters of the tile cache of a tiled graph
+ * @param g the graph
+ * @param st (out) the counters
+ * @return ERRUNABLE if the graph is not tiled
+ * @return OK otherwise
+ *************************************************************/
+status tile_stats(Graph * g, TileStats * st){
+    if (!g->store || g->store->roads != tiled_roads) return ERRUNABLE;
+    Tiled * t = (Tiled *)g->store->data;
+    pthread_mutex_lock(&t->lock);
+    *st = t->stats;
+    pthread_mutex_unlock(&t->lock);
+    return OK;
+}
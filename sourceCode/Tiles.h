@@ -0,0 +1,42 @@
+//
+//  Tiles.h
+//  Astar
+//
+//  Tiled storage of a graph for maps larger than memory: the roads and
+//  names are cut into tiles of consecutive nodes kept in one file, and only
+//  the tiles a search touches are read, into a cache of bounded size.
+//
+
+#ifndef Tiles_h
+#define Tiles_h
+
+#include <stddef.h>
+#include "Graph.h"
+
+/** default number of nodes per tile **/
+#define TILE_NODES 512
+
+/** Counters of the tile cache of a tiled graph **/
+typedef struct TileStats{
+    long hits;
+    long misses;
+    long evictions;
+    int resident;
+    size_t residentBytes;
+    size_t peakBytes;
+    size_t budgetBytes;
+}TileStats;
+
+/** Write a plain graph as a tiled file **/
+status save_tiled(Graph *, int, char *);
+
+/** Open a tiled file, with a cache of at most the given number of bytes **/
+Graph * load_tiled(char *, size_t);
+
+/** Test whether a file holds a tiled graph **/
+int is_tiled(char *);
+
+/** Read the counters of the tile cache of a tiled graph **/
+status tile_stats(Graph *, TileStats *);
+
+#endif /* Tiles_h */
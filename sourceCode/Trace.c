@@ -0,0 +1,159 @@
+//
+//  Trace.c
+//  Astar
+//
+//  Per-thread ring buffers of trace events.
+//
+//  A thread allocates its ring on its first event and links it at the head
+//  of the list of rings with a compare-and-swap; afterwards it is the only
+//  writer of its ring and publishes every event by a release store of the
+//  ring head, so recording takes no lock. trace_dump is meant to run once
+//  the traced work is over: events written while it runs may be torn.
+//  trace_close then frees the rings; the threads that had one must be
+//  over, except the calling one, which gets a new ring on its next event.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Trace.h"
+
+#ifdef TRACE
+
+#include <stdatomic.h>
+#include <time.h>
+
+typedef struct TraceEvent{
+    long long ns;
+    int kind;
+    int a;
+    int b;
+}TraceEvent;
+
+typedef struct TraceRing{
+    int tid;
+    atomic_ullong head;
+    struct TraceRing * next;
+    TraceEvent events[TRACE_EVENTS];
+}TraceRing;
+
+/** how trace points are displayed: name, Chrome phase and argument names **/
+static const struct{
+    char * name;
+    char phase;
+    char * a;
+    char * b;
+} kinds[] = {
+    [TRACE_LOAD_BEGIN] = {"load", 'B', NULL, NULL},
+    [TRACE_LOAD_END] = {"load", 'E', "cities", NULL},
+    [TRACE_CITY] = {"city", 'i', "cities", NULL},
+    [TRACE_SEARCH_BEGIN] = {"search", 'B', "start", "goal"},
+    [TRACE_SEARCH_END] = {"search", 'E', "expanded", "status"},
+    [TRACE_POP] = {"pop", 'i', "node", "f"},
+    [TRACE_RELAX] = {"relax", 'i', "node", "g"},
+    [TRACE_REOPEN] = {"reopen", 'i', "node", "g"},
+    [TRACE_FOUND] = {"found", 'i', "goal", "cost"},
+};
+
+static _Atomic(TraceRing *) rings = NULL;
+static atomic_int nextTid = 1;
+static _Thread_local TraceRing * mine = NULL;
+
+
+/*************************************************************
+ * Record an event in the ring buffer of the calling thread, the oldest
+ * event being overwritten when the ring is full
+ * @param kind the trace point
+ * @param a first argument, see traceKind
+ * @param b second argument
+ *************************************************************/
+void trace_event(traceKind kind, int a, int b){
+    TraceRing * r = mine;
+    if (!r){
+        r = (TraceRing *) calloc(1, sizeof(TraceRing));
+        if (!r) return;
+        r->tid = atomic_fetch_add(&nextTid, 1);
+        r->next = atomic_load(&rings);
+        while (!atomic_compare_exchange_weak(&rings, &r->next, r));
+        mine = r;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    unsigned long long h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    TraceEvent * e = &r->events[h % TRACE_EVENTS];
+    e->ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    e->kind = kind;
+    e->a = a;
+    e->b = b;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+
+/*************************************************************
+ * Write the events of all threads to a file in the Chrome trace JSON
+ * format (chrome://tracing, ui.perfetto.dev), timestamps in microseconds
+ * @param filepath the file to write
+ * @return ERROPEN if the file cannot be written
+ * @return OK otherwise
+ *************************************************************/
+status trace_dump(char * filepath){
+    FILE * f = fopen(filepath, "w");
+    if (!f) return ERROPEN;
+    int count = 0;
+    fputs("{\"traceEvents\":[\n", f);
+    for (TraceRing * r = atomic_load(&rings); r; r = r->next){
+        unsigned long long head = atomic_load_explicit(&r->head, memory_order_acquire);
+        unsigned long long i = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+        for (; i < head; i++){
+            TraceEvent * e = &r->events[i % TRACE_EVENTS];
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                    count++ ? ",\n" : "", kinds[e->kind].name, kinds[e->kind].phase, e->ns / 1e3, r->tid);
+            if (kinds[e->kind].phase == 'i') fputs(",\"s\":\"t\"", f);
+            if (kinds[e->kind].a){
+                fprintf(f, ",\"args\":{\"%s\":%d", kinds[e->kind].a, e->a);
+                if (kinds[e->kind].b) fprintf(f, ",\"%s\":%d", kinds[e->kind].b, e->b);
+                fputc('}', f);
+            }
+            fputc('}', f);
+        }
+    }
+    fputs("\n]}\n", f);
+    return fclose(f) == 0 ? OK : ERROPEN;
+}
+
+
+/*************************************************************
+ * Free the ring buffers of all threads and their events. The other
+ * threads that recorded events must be over: their ring is freed too.
+ *************************************************************/
+void trace_close(void){
+    TraceRing * r = atomic_exchange(&rings, NULL);
+    while (r){
+        TraceRing * next = r->next;
+        free(r);
+        r = next;
+    }
+    mine = NULL;
+}
+
+#else
+
+/** without TRACE, trace points record nothing **/
+void trace_event(traceKind kind, int a, int b){
+}
+
+
+/*************************************************************
+ * Write the events of all threads to a Chrome trace JSON file
+ * @param filepath the file to write
+ * @return ERRUNABLE: the program was built without trace points
+ *************************************************************/
+status trace_dump(char * filepath){
+    return ERRUNABLE;
+}
+
+
+/** without TRACE, there are no ring buffers to free **/
+void trace_close(void){
+}
+
+#endif
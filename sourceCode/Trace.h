@@ -0,0 +1,49 @@
+//
+//  Trace.h
+//  Astar
+//
+//  Trace points of the searches and of map loading. They compile to
+//  nothing unless the program is built with TRACE defined (make TRACE=1);
+//  then every thread records its events in its own ring buffer, which
+//  trace_dump writes in the Chrome trace (Perfetto) JSON format.
+//
+
+#ifndef Trace_h
+#define Trace_h
+
+#include "status.h"
+
+/** number of events kept per thread, the oldest ones are overwritten **/
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS (1 << 16)
+#endif
+
+/** Kinds of trace points, with the meaning of their two arguments **/
+typedef enum{
+    TRACE_LOAD_BEGIN,       /* map loading starts: -, - */
+    TRACE_LOAD_END,         /* map loading ends: cities, - */
+    TRACE_CITY,             /* a new city is read: cities so far, - */
+    TRACE_SEARCH_BEGIN,     /* a search starts: start, goal */
+    TRACE_SEARCH_END,       /* a search ends: expanded, status */
+    TRACE_POP,              /* a node is taken from OPEN: node, f */
+    TRACE_RELAX,            /* a road improves a node: node, g */
+    TRACE_REOPEN,           /* a closed node is improved: node, g */
+    TRACE_FOUND             /* the goal is reached: goal, cost */
+}traceKind;
+
+#ifdef TRACE
+#define TRACE_POINT(kind, a, b) trace_event(kind, a, b)
+#else
+#define TRACE_POINT(kind, a, b) ((void)0)
+#endif
+
+/** Record an event in the ring buffer of the calling thread **/
+void trace_event(traceKind, int, int);
+
+/** Write the events of all threads to a Chrome trace JSON file **/
+status trace_dump(char *);
+
+/** Free the ring buffers of all threads, once the traced threads are over **/
+void trace_close(void);
+
+#endif /* Trace_h */
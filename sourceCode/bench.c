@@ -0,0 +1,1466 @@
+//
+//  bench.c
+//  Astar
+//
+//  Measurements of the searches on a map, typically a large one made by genmap.
+//
+//  usage: bench experiment map [n_queries [seed]]
+//
+//  order: runs the same random queries with the nodes numbered in name
+//  order (as read), in reverse Cuthill-McKee order and in Hilbert order,
+//  and reports the average latency and hardware cache misses per query.
+//
+//  compress: reports the bytes per road of the list of cities, of the
+//  array view and of the compressed graph, and the latency of the same
+//  queries on the array view and on the compressed graph.
+//
+//  sssp: computes full shortest path trees from n_queries random sources
+//  with Dijkstra and with delta-stepping on 1, 2, 4 ... threads (up to
+//  the number of processors, at least 4), checks that the distances agree
+//  and reports the speedup over Dijkstra.
+//
+//  arcflags: builds arc-flags with 4, 16 and 64 regions and reports the
+//  build time, the flag storage and the expansions and latency of the
+//  same queries with and without flags (path costs are checked to agree).
+//
+//  tiles: writes the map as a temporary tiled file and runs the same
+//  queries with tile caches of decreasing size, reporting hits, misses,
+//  evictions, peak resident bytes and latency.
+//
+//  heuristic: calibrates the estimate in the Manhattan, Euclidean and
+//  great-circle metrics and reports for each the scale found, the
+//  tightness of the estimate (estimate over path cost, on average over
+//  the queries) and the expansions and latency saved against h_of_n.
+//
+//  ksp: finds the k shortest loopless paths of the queries for k = 2, 8
+//  and 32, on 1 thread and on 4 (or one per processor if more), checks
+//  that both give the same paths and reports the latency and expansions.
+//
+//  batch: answers n_queries random queries sharing their start city by
+//  groups of 1, 4, 16 and 64, independently and grouped into one resumed
+//  search per start city (estimate calibrated), checks that the path costs
+//  agree and reports the expansions and latency saved by grouping.
+//
+//  async: answers the queries through a router (Async.h) of 1 thread and of
+//  4 (or one per processor if more), queue of 64 tickets, with callbacks
+//  and with an event loop polling the eventfd, checks the path costs
+//  against sequential searches and reports the throughput and how often
+//  the full queue pushed back.
+//
+//  shared: forks 1, 2, 4 and 8 worker processes answering n_queries
+//  queries each, either every one loading the map itself or all of them
+//  searching one copy in shared memory (Shared.h), and reports per worker
+//  the time until it can answer, its private memory and its proportional
+//  share of the memory it uses (Pss).
+//
+//  hda: runs n_queries long queries (goal the farthest of 32 random cities)
+//  with A* and with HDA* on 1, 2, 4 and 8 threads, checks that the path
+//  costs agree and reports the expansions, reopened nodes, latency and
+//  speedup over A*.
+//
+//  hubs: builds the hub labels of the map (Hub.h), writes them to a
+//  temporary file and reads them back, checks the distances of the queries
+//  against A* and reports the build time, the entries per label, the bytes
+//  of the labels and the latency of a distance query with each.
+//
+//  delta: writes delta files of 10, 100 and 1000 random changes (roads
+//  reweighted, removed and added, cities added with their roads), and
+//  reports the time to apply each to an overlay over the loaded map against
+//  reloading the map, then the latency of the same queries on the base, on
+//  the overlay and once it is compacted (path costs are checked to agree
+//  between the overlay and the compacted graph).
+//
+//  output: answers n_queries queries as a batch, then writes the answers
+//  to /dev/null with a printf per city (as Astar did) and through the
+//  buffered writer (Output.h) in each format, and reports the bytes and
+//  time of each; then the time to load the map with and without the
+//  listing of its cities.
+//
+//  spatial: builds the k-d tree of the coordinates (Spatial.h) and looks up
+//  random points: the nearest city by linear scan and with the tree, the
+//  8 nearest cities and the cities in boxes of about 1, 10 and 100 cities
+//  (every answer is checked against a scan of all the cities), and reports
+//  the build time, the bytes of the tree and the lookups per second.
+//
+//  goals: runs n_queries queries from random cities toward 8 hot goals,
+//  without goal cache and with caches (GoalCache.h) holding all of them
+//  and only 2 of them, then through a router of 4 threads sharing the
+//  cache; checks the path costs and reports the latency, the expansions
+//  per query, the goals held, hits, trees built (and their time) and
+//  evictions.
+//
+//  range: picks the distances within which about 100, 1000 and 10000
+//  cities lie from a random city, and searches the cities within each from
+//  n_queries random origins (Range.h): one at a time on one workspace,
+//  then shared among 1, 2 and 4 threads (or one per processor if more).
+//  The cities found from the first origins are checked against a full
+//  Dijkstra; reports the cities reached, the latency per origin against
+//  Dijkstra, the heap grown by the repeated searches and the speedup.
+//
+//  grid: on a grid map (see genmap -g), runs the same random queries with
+//  A* over the 8 neighbours of a cell and with Jump Point Search, checks
+//  that the path costs agree and reports expansions and latency.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "Map.h"
+#include "Graph.h"
+#include "Search.h"
+#include "Reorder.h"
+#include "Compress.h"
+#include "Sssp.h"
+#include "ArcFlags.h"
+#include "Tiles.h"
+#include "Grid.h"
+#include "Ksp.h"
+#include "Batch.h"
+#include "Async.h"
+#include "Shared.h"
+#include "Hda.h"
+#include "Hub.h"
+#include "Delta.h"
+#include "Output.h"
+#include "Spatial.h"
+#include "GoalCache.h"
+#include "Range.h"
+
+/** a query, kept as cities since node indices change with the order **/
+typedef struct Query{
+    City * from;
+    City * to;
+}Query;
+
+static unsigned long long seed_state = 1;
+static unsigned rnd(void){
+    seed_state = seed_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned)(seed_state >> 33);
+}
+
+/** heap bytes taken by map_to_list, measured when loading the map **/
+static size_t listBytes;
+
+/** map file of the experiment, for the experiments loading it again **/
+static char * mapPath;
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*************************************************************
+ * private function opening a counter of the hardware cache misses of
+ * this process
+ * @return the file descriptor of the counter
+ * @return -1 if the counter is not available (virtual machine, permissions)
+ *************************************************************/
+static int open_cache_misses(void){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long read_counter(int fd){
+    long long count = 0;
+    if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return count;
+}
+
+
+/*************************************************************
+ * private function picking random queries between cities of the same
+ * component, so that every query has a path
+ *************************************************************/
+static Query * random_queries(Graph * g, int n){
+    Query * q = (Query *) malloc(n * sizeof(Query));
+    if (!q) return NULL;
+    for (int i = 0; i < n; i++){
+        int from = rnd() % g->nCities, to;
+        do to = rnd() % g->nCities; while (g->component[to] != g->component[from]);
+        q[i].from = g->cities[from];
+        q[i].to = g->cities[to];
+    }
+    return q;
+}
+
+
+/*************************************************************
+ * private function running every query once and displaying one line of
+ * results: average latency, expansions and cache misses per query
+ *************************************************************/
+static void run_queries(char * label, Graph * g, Query * q, int n){
+    Workspace * ws = newWorkspace(g);
+    SearchStats st;
+    long expanded = 0;
+    int fd = open_cache_misses();
+    
+    if (fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    double t0 = now();
+    for (int i = 0; i < n; i++){
+        astar(g, q[i].from->id, q[i].to->id, NULL, ws, &st);
+        expanded += st.expanded;
+    }
+    double elapsed = now() - t0;
+    long long misses = read_counter(fd);
+    if (fd >= 0) close(fd);
+    
+    printf("%-8s %12.1f %12.1f", label, elapsed / n * 1e6, (double)expanded / n);
+    if (misses >= 0) printf(" %14.1f\n", (double)misses / n);
+    else printf(" %14s\n", "n/a");
+    delWorkspace(ws);
+}
+
+
+/** bench order: compare query latency under the available node orders **/
+static int bench_order(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    if (!q) return 1;
+    
+    printf("%d cities, %d roads, %d queries\n", g->nCities, g->nEdges, nQueries);
+    printf("%-8s %12s %12s %14s\n", "order", "us/query", "expanded", "misses/query");
+    run_queries("name", g, q, nQueries);
+    
+    int * perm = rcm_order(g);
+    if (!perm || renumber_graph(g, perm) != OK) return 1;
+    free(perm);
+    run_queries("rcm", g, q, nQueries);
+    
+    perm = hilbert_order(g);
+    if (!perm || renumber_graph(g, perm) != OK) return 1;
+    free(perm);
+    run_queries("hilbert", g, q, nQueries);
+    
+    free(q);
+    return 0;
+}
+
+
+/** bench compress: compare the size and speed of the plain and compressed graphs **/
+static int bench_compress(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * perm = hilbert_order(g);
+    if (!q || !perm || renumber_graph(g, perm) != OK) return 1;
+    free(perm);
+    Graph * packed = compress_graph(g);
+    if (!packed) return 1;
+    
+    int n = g->nCities;
+    double m = g->nEdges;
+    size_t plain = (size_t)(n + 1) * (sizeof(City *) + 4 * sizeof(int)) + (size_t)(m + 1) * 2 * sizeof(int);
+    size_t roads, total = compressed_bytes(packed, &roads);
+    printf("%d cities, %d roads, %d queries\n", n, g->nEdges, nQueries);
+    printf("%-10s %14s %14s\n", "storage", "bytes/road", "total bytes");
+    printf("%-10s %14.2f %14zu\n", "list", listBytes / m, listBytes);
+    printf("%-10s %14.2f %14zu\n", "arrays", plain / m, plain);
+    printf("%-10s %14.2f %14zu\n", "packed", total / m, total);
+    printf("%-10s %14.2f %14zu\n", "(roads)", roads / m, roads);
+    
+    printf("%-8s %12s %12s %14s\n", "graph", "us/query", "expanded", "misses/query");
+    run_queries("arrays", g, q, nQueries);
+    run_queries("packed", packed, q, nQueries);
+    
+    delGraph(packed);
+    free(q);
+    return 0;
+}
+
+
+/** bench sssp: compare delta-stepping on several threads with Dijkstra **/
+static int bench_sssp(Graph * g, int nSources){
+    int n = g->nCities;
+    int * dist = (int *) malloc((n + 1) * sizeof(int));
+    int * parent = (int *) malloc((n + 1) * sizeof(int));
+    int * ref = (int *) malloc((n + 1) * sizeof(int));
+    int * sources = (int *) malloc(nSources * sizeof(int));
+    if (!dist || !parent || !ref || !sources) return 1;
+    for (int i = 0; i < nSources; i++) sources[i] = rnd() % n;
+    int * perm = hilbert_order(g);
+    if (!perm || renumber_graph(g, perm) != OK) return 1;
+    free(perm);
+    
+    int maxThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (maxThreads < 4) maxThreads = 4;
+    printf("%d cities, %d roads, %d sources, %ld processors\n", n, g->nEdges, nSources,
+           sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-16s %12s %10s\n", "algorithm", "ms/source", "speedup");
+    
+    double base = 0;
+    for (int threads = 0; threads <= maxThreads; threads = threads ? 2 * threads : 1){
+        double elapsed = 0;
+        for (int i = 0; i < nSources; i++){
+            double t0 = now();
+            status s;
+            if (threads == 0) s = dijkstra(g, sources[i], ref + 0, parent);
+            else s = delta_stepping(g, sources[i], 0, threads, dist, parent);
+            elapsed += now() - t0;
+            if (s != OK) return 1;
+            
+            /* distances are unique even when trees differ: compare with the last Dijkstra */
+            if (threads && i == nSources - 1 && memcmp(dist, ref, n * sizeof(int)) != 0){
+                fprintf(stderr, "delta-stepping on %d threads disagrees with Dijkstra\n", threads);
+                return 1;
+            }
+        }
+        if (threads == 0) base = elapsed;
+        char label[32];
+        if (threads == 0) snprintf(label, sizeof(label), "dijkstra");
+        else snprintf(label, sizeof(label), "delta x%d", threads);
+        printf("%-16s %12.1f %10.2f\n", label, elapsed / nSources * 1e3, base / elapsed);
+    }
+    
+    free(dist);
+    free(parent);
+    free(ref);
+    free(sources);
+    return 0;
+}
+
+
+/** private function running queries and returning average expansions and
+ * microseconds per query, the distance of each path being stored in costs **/
+static double timed_queries(Graph * g, Query * q, int n, int * costs, double * expanded){
+    Workspace * ws = newWorkspace(g);
+    SearchStats st;
+    long total = 0;
+    if (!ws) return -1;
+    double t0 = now();
+    for (int i = 0; i < n; i++){
+        status s = astar(g, q[i].from->id, q[i].to->id, NULL, ws, &st);
+        costs[i] = s == OK ? ws->g[ws->reached] : -1;
+        total += st.expanded;
+    }
+    double elapsed = now() - t0;
+    delWorkspace(ws);
+    *expanded = (double)total / n;
+    return elapsed / n * 1e6;
+}
+
+
+/** bench arcflags: expansions saved by arc-flags against their cost **/
+static int bench_arcflags(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * costs = (int *) malloc(nQueries * sizeof(int));
+    int * perm = hilbert_order(g);
+    if (!q || !ref || !costs || !perm || renumber_graph(g, perm) != OK) return 1;
+    free(perm);
+    
+    double expanded, us = timed_queries(g, q, nQueries, ref, &expanded);
+    printf("%d cities, %d roads, %d queries\n", g->nCities, g->nEdges, nQueries);
+    printf("%-8s %10s %10s %12s %12s %10s\n", "regions", "build s", "flag MB", "expanded", "us/query", "speedup");
+    printf("%-8s %10s %10s %12.1f %12.1f %10.2f\n", "none", "-", "-", expanded, us, 1.0);
+    
+    for (int regions = 4; regions <= MAX_REGIONS; regions *= 4){
+        ArcFlags * af = build_arc_flags(g, regions, 0);
+        if (!af) return 1;
+        g->arcFlags = af;
+        double e, t = timed_queries(g, q, nQueries, costs, &e);
+        g->arcFlags = NULL;
+        if (memcmp(costs, ref, nQueries * sizeof(int)) != 0){
+            fprintf(stderr, "arc-flags with %d regions change path costs\n", regions);
+            return 1;
+        }
+        printf("%-8d %10.2f %10.2f %12.1f %12.1f %10.2f\n", regions, af->buildSeconds,
+               arc_flags_bytes(g, af) / 1048576.0, e, t, us / t);
+        delArcFlags(af);
+    }
+    
+    free(q);
+    free(ref);
+    free(costs);
+    return 0;
+}
+
+
+/** bench heuristic: expansions saved by calibrated estimates **/
+static int bench_heuristic(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * costs = (int *) malloc(nQueries * sizeof(int));
+    if (!q || !ref || !costs) return 1;
+    
+    char * names[] = {"h_of_n", "manhattan", "euclidean", "greatcircle"};
+    double base = 0;
+    printf("%d cities, %d roads, %d queries\n", g->nCities, g->nEdges, nQueries);
+    printf("%-12s %10s %10s %10s %12s %10s %12s\n", "estimate", "scale", "calib ms",
+           "tightness", "expanded", "saved", "us/query");
+    for (int v = 0; v < 4; v++){
+        double t0 = now();
+        g->hMetric = METRIC_MANHATTAN;
+        g->hScale = DEFAULT_H_SCALE;
+        if (v > 0 && calibrate_h(g, (metric)(v - 1)) != OK) return 1;
+        double ms = (now() - t0) * 1e3;
+        
+        double expanded, us = timed_queries(g, q, nQueries, v ? costs : ref, &expanded);
+        if (v && memcmp(costs, ref, nQueries * sizeof(int)) != 0){
+            fprintf(stderr, "the %s estimate changes path costs\n", names[v]);
+            return 1;
+        }
+        double tight = 0;
+        int counted = 0;
+        for (int i = 0; i < nQueries; i++)
+            if (ref[i] > 0){
+                tight += (double)graph_h(g, q[i].from->id, q[i].to->id) / ref[i];
+                counted++;
+            }
+        if (v == 0) base = expanded;
+        printf("%-12s %10.4f %10.2f %10.3f %12.1f %9.1f%% %12.1f\n", names[v], g->hScale, v ? ms : 0.0,
+               counted ? tight / counted : 0.0, expanded, base > 0 ? 100 * (1 - expanded / base) : 0.0, us);
+    }
+    
+    free(q);
+    free(ref);
+    free(costs);
+    return 0;
+}
+
+
+/** bench ksp: cost of alternatives, sequential and with parallel spur searches **/
+static int bench_ksp(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * 32 * sizeof(int));
+    Path ** paths = (Path **) malloc(32 * sizeof(Path *));
+    long procs = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads[2] = {1, procs > 4 ? (int)procs : 4};
+    if (!q || !ref || !paths) return 1;
+    
+    printf("%d cities, %d roads, %d queries, %ld processors\n", g->nCities, g->nEdges, nQueries, procs);
+    printf("%-4s %8s %12s %12s %12s\n", "k", "threads", "paths", "expanded", "ms/query");
+    for (int k = 2; k <= 32; k *= 4)
+        for (int t = 0; t < 2; t++){
+            long expanded = 0, found = 0;
+            double t0 = now();
+            for (int i = 0; i < nQueries; i++){
+                SearchStats st;
+                int n;
+                if (k_shortest_paths(g, q[i].from->id, q[i].to->id, k, threads[t], paths, &n, &st) != OK) return 1;
+                for (int j = 0; j < k; j++){
+                    int cost = j < n ? paths[j]->total : -1;
+                    if (t == 0) ref[i * 32 + j] = cost;
+                    else if (ref[i * 32 + j] != cost){
+                        fprintf(stderr, "threads change the paths of query %d\n", i);
+                        return 1;
+                    }
+                    if (j < n) delPath(paths[j]);
+                }
+                expanded += st.expanded;
+                found += n;
+            }
+            printf("%-4d %8d %12.1f %12.1f %12.2f\n", k, threads[t], (double)found / nQueries,
+                   (double)expanded / nQueries, (now() - t0) / nQueries * 1e3);
+        }
+    
+    free(q);
+    free(ref);
+    free(paths);
+    return 0;
+}
+
+
+/** bench batch: expansions saved by sharing one search among the queries of a start city **/
+static int bench_batch(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    BatchQuery * b = (BatchQuery *) malloc(nQueries * sizeof(BatchQuery));
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    Workspace * ws = newWorkspace(g);
+    if (!q || !b || !ref || !ws || calibrate_h(g, METRIC_EUCLIDEAN) != OK) return 1;
+    
+    printf("%d cities, %d roads, %d queries\n", g->nCities, g->nEdges, nQueries);
+    printf("%-6s %12s %12s %12s %12s %10s\n", "group", "expanded", "grouped", "us/query", "grouped", "saved");
+    for (int size = 1; size <= 64; size *= 4){
+        double expanded[2], us[2];
+        for (int grouped = 0; grouped < 2; grouped++){
+            for (int i = 0; i < nQueries; i++){
+                b[i].start = q[i - i % size].from->id;
+                b[i].goal = q[i].to->id;
+                b[i].startName = b[i].goalName = NULL;
+                b[i].res = OK;
+                b[i].path = NULL;
+            }
+            SearchStats st;
+            double t0 = now();
+            if (run_batch(g, b, nQueries, grouped, NULL, ws, &st) != OK) return 1;
+            us[grouped] = (now() - t0) / nQueries * 1e6;
+            expanded[grouped] = (double)st.expanded / nQueries;
+            for (int i = 0; i < nQueries; i++){
+                int cost = b[i].res == OK ? b[i].path->total : -1;
+                if (!grouped) ref[i] = cost;
+                else if (cost != ref[i]){
+                    fprintf(stderr, "grouping changes the cost of query %d: %d instead of %d\n", i, cost, ref[i]);
+                    return 1;
+                }
+                delPath(b[i].path);
+            }
+        }
+        printf("%-6d %12.1f %12.1f %12.1f %12.1f %9.1f%%\n", size, expanded[0], expanded[1],
+               us[0], us[1], 100 * (1 - expanded[1] / expanded[0]));
+    }
+    
+    delWorkspace(ws);
+    free(q);
+    free(b);
+    free(ref);
+    return 0;
+}
+
+
+/** private function storing the cost of an answered ticket where its argument points **/
+static void store_cost(Ticket * t, void * arg){
+    *(int *)arg = t->res == OK ? t->path->total : -1;
+    delTicket(t);
+}
+
+
+/** bench async: throughput of the router, with callbacks and with an event loop **/
+static int bench_async(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * costs = (int *) malloc(nQueries * sizeof(int));
+    long procs = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads[2] = {1, procs > 4 ? (int)procs : 4};
+    double expanded;
+    if (!q || !ref || !costs) return 1;
+    
+    printf("%d cities, %d roads, %d queries, %ld processors\n", g->nCities, g->nEdges, nQueries, procs);
+    printf("%-10s %8s %12s %12s\n", "mode", "threads", "us/query", "full");
+    printf("%-10s %8d %12.1f %12s\n", "sequential", 1, timed_queries(g, q, nQueries, ref, &expanded), "-");
+    for (int t = 0; t < 2; t++)
+        for (int loop = 0; loop < 2; loop++){
+            Router * r = newRouter(g, threads[t], 64);
+            if (!r) return 1;
+            long full = 0;
+            int answered = 0;
+            struct pollfd pfd = {router_fd(r), POLLIN, 0};
+            double t0 = now();
+            for (int i = 0; i < nQueries; i++){
+                Ticket * tk = newTicket(q[i].from->id, q[i].to->id, NULL, loop ? NULL : store_cost, &costs[i]);
+                if (!tk) return 1;
+                
+                /* with callbacks, submitting waits for room; the event loop
+                 * collects answers while the queue is full */
+                status s;
+                while ((s = router_submit(r, tk, !loop)) == ERRFULL){
+                    full++;
+                    poll(&pfd, 1, -1);
+                    for (Ticket * d; (d = router_done(r)); answered++) store_cost(d, d->arg);
+                }
+                if (s != OK) return 1;
+            }
+            if (loop)
+                while (answered < nQueries){
+                    poll(&pfd, 1, -1);
+                    for (Ticket * d; (d = router_done(r)); answered++) store_cost(d, d->arg);
+                }
+            router_drain(r);
+            double us = (now() - t0) / nQueries * 1e6;
+            delRouter(r);
+            for (int i = 0; i < nQueries; i++)
+                if (costs[i] != ref[i]){
+                    fprintf(stderr, "the router changes the cost of query %d\n", i);
+                    return 1;
+                }
+            printf("%-10s %8d %12.1f %12ld\n", loop ? "eventfd" : "callback", threads[t], us, full);
+        }
+    
+    free(q);
+    free(ref);
+    free(costs);
+    return 0;
+}
+
+
+/** what a worker of bench shared measured, sent to the parent through a pipe **/
+typedef struct WorkerReport{
+    double ready;
+    long privateKB;
+    long pssKB;
+}WorkerReport;
+
+/** private function reading a field of /proc/self/smaps_rollup, in kB **/
+static long rollup_kb(char * field){
+    FILE * f = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    long kb = 0, v;
+    size_t len = strlen(field);
+    while (f && fgets(line, sizeof line, f))
+        if (strncmp(line, field, len) == 0 && strchr(line, ':') && sscanf(strchr(line, ':') + 1, "%ld", &v) == 1)
+            kb += v;
+    if (f) fclose(f);
+    return kb;
+}
+
+
+/** bench shared: memory and start-up of worker processes, with private and shared graphs **/
+static int bench_shared(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    char * names = (char *) malloc(2 * (size_t)nQueries * 20);
+    if (!q || !names) return 1;
+    for (int i = 0; i < nQueries; i++){
+        strcpy(names + 40 * (size_t)i, q[i].from->name);
+        strcpy(names + 40 * (size_t)i + 20, q[i].to->name);
+    }
+    double t0 = now();
+    Graph * shared = share_graph(g, NULL);
+    if (!shared) return 1;
+    printf("%d cities, %d roads, %d queries per worker, shared segment %zu bytes built in %.1f ms\n",
+           g->nCities, g->nEdges, nQueries, shared_bytes(shared), (now() - t0) * 1e3);
+    printf("%-8s %8s %12s %14s %14s\n", "graph", "workers", "ready ms", "private kB", "pss kB");
+    
+    for (int mode = 0; mode < 2; mode++)
+        for (int nWorkers = 1; nWorkers <= 8; nWorkers *= 2){
+            int fds[8];
+            pid_t pids[8];
+            double t1 = now();
+            for (int k = 0; k < nWorkers; k++){
+                int p[2];
+                if (pipe(p) != 0 || (pids[k] = fork()) < 0) return 1;
+                if (pids[k] > 0){
+                    close(p[1]);
+                    fds[k] = p[0];
+                    continue;
+                }
+                
+                /* worker: get a graph, answer the queries, report */
+                close(p[0]);
+                WorkerReport r;
+                Graph * wg = mode ? shared : list_to_graph(map_to_list(mapPath));
+                Workspace * ws = wg ? newWorkspace(wg) : NULL;
+                if (!ws) _exit(1);
+                r.ready = now() - t1;
+                for (int i = 0; i < nQueries; i++)
+                    astar(wg, find_node(wg, names + 40 * (size_t)i), find_node(wg, names + 40 * (size_t)i + 20),
+                          NULL, ws, NULL);
+                r.privateKB = rollup_kb("Private_");
+                r.pssKB = rollup_kb("Pss:");
+                _exit(write(p[1], &r, sizeof r) == sizeof r ? 0 : 1);
+            }
+            WorkerReport sum = {0, 0, 0};
+            for (int k = 0; k < nWorkers; k++){
+                WorkerReport r;
+                int st;
+                if (read(fds[k], &r, sizeof r) != sizeof r) return 1;
+                close(fds[k]);
+                waitpid(pids[k], &st, 0);
+                sum.ready += r.ready;
+                sum.privateKB += r.privateKB;
+                sum.pssKB += r.pssKB;
+            }
+            printf("%-8s %8d %12.2f %14ld %14ld\n", mode ? "shared" : "private", nWorkers,
+                   sum.ready / nWorkers * 1e3, sum.privateKB / nWorkers, sum.pssKB / nWorkers);
+        }
+    
+    delGraph(shared);
+    free(q);
+    free(names);
+    return 0;
+}
+
+
+/** bench hda: speedup of one long query searched by several threads **/
+static int bench_hda(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    Path * path = newPath(g->nCities);
+    Workspace * ws = newWorkspace(g);
+    if (!q || !ref || !path || !ws || calibrate_h(g, METRIC_EUCLIDEAN) != OK) return 1;
+    
+    /* long queries: the farthest of a few random goals */
+    for (int i = 0; i < nQueries; i++)
+        for (int c = 0; c < 32; c++){
+            int to = rnd() % g->nCities;
+            if (g->component[to] == g->component[q[i].from->id] &&
+                graph_h(g, q[i].from->id, to) > graph_h(g, q[i].from->id, q[i].to->id))
+                q[i].to = g->cities[to];
+        }
+    
+    printf("%d cities, %d roads, %d queries, %ld processors\n", g->nCities, g->nEdges, nQueries,
+           sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s %8s %12s %12s %12s %10s\n", "search", "threads", "expanded", "reopened", "ms/query", "speedup");
+    double base = 0;
+    for (int threads = 0; threads <= 8; threads = threads ? 2 * threads : 1){
+        long expanded = 0, reopened = 0;
+        double t0 = now();
+        for (int i = 0; i < nQueries; i++){
+            SearchStats st;
+            status s = threads ? hda_star(g, q[i].from->id, q[i].to->id, threads, path, &st)
+                : astar(g, q[i].from->id, q[i].to->id, NULL, ws, &st);
+            if (s != OK) return 1;
+            int cost = threads ? path->total : ws->g[ws->reached];
+            if (!threads) ref[i] = cost;
+            else if (cost != ref[i]){
+                fprintf(stderr, "HDA* on %d threads finds %d instead of %d for query %d\n", threads, cost, ref[i], i);
+                return 1;
+            }
+            expanded += st.expanded;
+            reopened += st.reopened;
+        }
+        double ms = (now() - t0) / nQueries * 1e3;
+        if (!threads) base = ms;
+        printf("%-8s %8d %12.1f %12.1f %12.2f %9.2fx\n", threads ? "hda" : "astar", threads ? threads : 1,
+               (double)expanded / nQueries, (double)reopened / nQueries, ms, base / ms);
+    }
+    
+    delWorkspace(ws);
+    delPath(path);
+    free(q);
+    free(ref);
+    return 0;
+}
+
+
+/** bench hubs: distance queries answered by hub labels instead of searches **/
+static int bench_hubs(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    Workspace * ws = newWorkspace(g);
+    char file[] = "/tmp/benchXXXXXX";
+    int fd = mkstemp(file);
+    if (!q || !ref || !ws || fd < 0 || calibrate_h(g, METRIC_MANHATTAN) != OK) return 1;
+    close(fd);
+    
+    double t0 = now();
+    for (int i = 0; i < nQueries; i++){
+        status s = astar(g, q[i].from->id, q[i].to->id, NULL, ws, NULL);
+        ref[i] = s == OK ? ws->g[ws->reached] : UNREACHED;
+    }
+    double astarUs = (now() - t0) / nQueries * 1e6;
+    
+    HubLabels * built = build_hub_labels(g);
+    if (!built || save_hub_labels(built, file) != OK) return 1;
+    t0 = now();
+    HubLabels * hl = load_hub_labels(g, file);
+    double loadSeconds = now() - t0;
+    unlink(file);
+    if (!hl) return 1;
+    
+    /* the labels answer in well under a microsecond: repeat the queries */
+    int passes = 1 + 1000000 / nQueries;
+    long sum = 0;
+    t0 = now();
+    for (int p = 0; p < passes; p++)
+        for (int i = 0; i < nQueries; i++) sum += hub_distance(hl, q[i].from->id, q[i].to->id);
+    double hubUs = (now() - t0) / ((double)passes * nQueries) * 1e6;
+    for (int i = 0; i < nQueries; i++){
+        int d = hub_distance(hl, q[i].from->id, q[i].to->id);
+        if (d != ref[i] || d != hub_distance(built, q[i].from->id, q[i].to->id)){
+            fprintf(stderr, "hub labels give %d instead of %d for query %d\n", d, ref[i], i);
+            return 1;
+        }
+    }
+    
+    long n = g->nCities;
+    printf("%d cities, %d roads, %d queries (checksum %ld)\n", g->nCities, g->nEdges, nQueries, sum);
+    printf("build %.2f s, load %.3f s, %.1f out and %.1f in entries per node, %.2f MB (%.1f bytes per road)\n",
+           built->buildSeconds, loadSeconds, (double)(hl->outFirst[n] - n) / n, (double)(hl->inFirst[n] - n) / n,
+           hub_labels_bytes(hl) / 1048576.0, (double)hub_labels_bytes(hl) / g->nEdges);
+    printf("%-8s %12s %10s\n", "query", "us/query", "speedup");
+    printf("%-8s %12.3f %10.2f\n", "astar", astarUs, 1.0);
+    printf("%-8s %12.3f %10.0f\n", "hubs", hubUs, astarUs / hubUs);
+    
+    delHubLabels(built);
+    delHubLabels(hl);
+    delWorkspace(ws);
+    free(q);
+    free(ref);
+    return 0;
+}
+
+
+/** private function writing a delta file of n random changes to g **/
+static int write_delta(Graph * g, char * file, int n){
+    FILE * f = fopen(file, "w");
+    char * used = (char *) calloc(g->nCities, 1);
+    if (!f || !used) return 0;
+    char a[20], b[20];
+    
+    /* at most one change to the roads of a city, so no change undoes another */
+    for (int i = 0; i < n; i++){
+        int u = rnd() % g->nCities, degree = g->first[u+1] - g->first[u];
+        if (degree == 0 || used[u]) continue;
+        used[u] = 1;
+        int e = g->first[u] + rnd() % degree, v = g->adj[e];
+        char * from = city_name(g, u, a), * to = city_name(g, v, b);
+        switch (i % 4){
+            case 0: fprintf(f, "set road %s %s %d\n", from, to, g->dist[e] + (int)(rnd() % 20)); break;
+            case 1: fprintf(f, "remove road %s %s\n", from, to); break;
+            case 2:
+                /* a road past the next city, as long as the two it replaces */
+                for (int k = g->first[v]; k < g->first[v+1]; k++){
+                    int w = g->adj[k], known = w == u;
+                    for (int j = g->first[u]; j < g->first[u+1]; j++) known |= g->adj[j] == w;
+                    if (known) continue;
+                    fprintf(f, "add road %s %s %d\n", from, city_name(g, w, b), g->dist[e] + g->dist[k]);
+                    break;
+                }
+                break;
+            default:
+                fprintf(f, "add city D%07d %d %d\n", i, g->lat[u] + 1, g->lgt[u] + 1);
+                fprintf(f, "add road D%07d %s %d\nadd road %s D%07d %d\n", i, from, 3, from, i, 3);
+        }
+    }
+    free(used);
+    return fclose(f) == 0;
+}
+
+
+/** bench delta: changes applied to an overlay instead of reloading the map **/
+static int bench_delta(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * costs = (int *) malloc(nQueries * sizeof(int));
+    char file[] = "/tmp/benchXXXXXX";
+    int fd = mkstemp(file);
+    if (!q || !ref || !costs || fd < 0 || calibrate_h(g, METRIC_MANHATTAN) != OK) return 1;
+    close(fd);
+    
+    double t0 = now();
+    List * cities = map_to_list(mapPath);
+    Graph * copy = cities ? list_to_graph(cities) : NULL;
+    if (!copy || calibrate_h(copy, METRIC_MANHATTAN) != OK) return 1;
+    double reload = now() - t0;
+    delGraph(copy);
+    delCities(cities);
+    
+    double expanded, base = timed_queries(g, q, nQueries, ref, &expanded);
+    printf("%d cities, %d roads, %d queries, reload %.1f ms\n", g->nCities, g->nEdges, nQueries, reload * 1e3);
+    printf("%-8s %10s %10s %12s %12s %12s %12s\n", "changes", "apply ms", "held", "base us", "overlay us",
+           "compact ms", "compact us");
+    for (int n = 10; n <= 1000; n *= 10){
+        Graph * overlay = newOverlay(g, 0);
+        int line;
+        if (!overlay || !write_delta(g, file, n)) return 1;
+        t0 = now();
+        status s = apply_delta(overlay, file, &line);
+        double apply = now() - t0;
+        if (s != OK){
+            fprintf(stderr, "%s:%d: %s\n", file, line, message(s));
+            return 1;
+        }
+        int held = overlay_changes(overlay);
+        double e, us = timed_queries(overlay, q, nQueries, ref, &e);
+        t0 = now();
+        if (compact_overlay(overlay) != OK) return 1;
+        double compact = now() - t0;
+        double cus = timed_queries(overlay, q, nQueries, costs, &e);
+        if (memcmp(costs, ref, nQueries * sizeof(int)) != 0){
+            fprintf(stderr, "compaction of %d changes changes path costs\n", n);
+            return 1;
+        }
+        printf("%-8d %10.2f %10d %12.1f %12.1f %12.1f %12.1f\n", n, apply * 1e3, held, base, us, compact * 1e3, cus);
+        delGraph(overlay);
+        timed_queries(g, q, nQueries, ref, &expanded);
+    }
+    
+    unlink(file);
+    free(q);
+    free(ref);
+    free(costs);
+    return 0;
+}
+
+
+/** bench tiles: behaviour of the tile cache as its budget shrinks **/
+static int bench_tiles(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * costs = (int *) malloc(nQueries * sizeof(int));
+    int * perm = hilbert_order(g);
+    char file[] = "/tmp/bench_tiles_XXXXXX";
+    int fd = mkstemp(file);
+    if (!q || !ref || !costs || !perm || fd < 0 || renumber_graph(g, perm) != OK) return 1;
+    close(fd);
+    free(perm);
+    if (save_tiled(g, 0, file) != OK) return 1;
+    
+    /* the cities of the queries are only known by name in the tiled graph */
+    int * from = (int *) malloc(nQueries * sizeof(int));
+    int * to = (int *) malloc(nQueries * sizeof(int));
+    if (!from || !to) return 1;
+    
+    double expanded, us = timed_queries(g, q, nQueries, ref, &expanded);
+    printf("%d cities, %d roads, %d queries, %d nodes per tile\n", g->nCities, g->nEdges, nQueries, TILE_NODES);
+    printf("%-8s %10s %10s %10s %12s %12s\n", "cache", "hits", "misses", "evictions", "peak bytes", "us/query");
+    printf("%-8s %10s %10s %10s %12s %12.1f\n", "memory", "-", "-", "-", "-", us);
+    
+    /* the first run has no bound: its peak is the working set of the queries */
+    size_t all = (size_t)-1;
+    int percents[] = {100, 25, 5, 1};
+    for (int p = 0; p < 4; p++){
+        Graph * tiled = load_tiled(file, p == 0 ? all : all / 100 * percents[p]);
+        Workspace * ws = tiled ? newWorkspace(tiled) : NULL;
+        if (!ws) return 1;
+        for (int i = 0; i < nQueries; i++){
+            from[i] = find_node(tiled, q[i].from->name);
+            to[i] = find_node(tiled, q[i].to->name);
+        }
+        
+        TileStats ts;
+        SearchStats st;
+        tile_stats(tiled, &ts);
+        long hits0 = ts.hits, misses0 = ts.misses;
+        double t0 = now();
+        for (int i = 0; i < nQueries; i++){
+            status s = astar(tiled, from[i], to[i], NULL, ws, &st);
+            costs[i] = s == OK ? ws->g[ws->reached] : -1;
+        }
+        double t = (now() - t0) / nQueries * 1e6;
+        tile_stats(tiled, &ts);
+        if (memcmp(costs, ref, nQueries * sizeof(int)) != 0){
+            fprintf(stderr, "tiled graph changes path costs\n");
+            return 1;
+        }
+        if (p == 0) all = ts.peakBytes;
+        char label[16];
+        snprintf(label, sizeof(label), "%d%%", percents[p]);
+        printf("%-8s %10ld %10ld %10ld %12zu %12.1f\n", label, ts.hits - hits0, ts.misses - misses0,
+               ts.evictions, ts.peakBytes, t);
+        delWorkspace(ws);
+        delGraph(tiled);
+    }
+    
+    unlink(file);
+    free(q); free(ref); free(costs); free(from); free(to);
+    return 0;
+}
+
+
+/** bench grid: symmetric paths pruned by Jump Point Search **/
+static int bench_grid(Grid * g, int nQueries){
+    int * from = (int *) malloc(nQueries * sizeof(int));
+    int * to = (int *) malloc(nQueries * sizeof(int));
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    Workspace * ws = newGridWorkspace(g);
+    if (!from || !to || !ref || !ws) return 1;
+    
+    /* free cells picked at random: queries between unconnected cells count as failures */
+    int nCells = g->width * g->height;
+    for (int i = 0; i < nQueries; i++){
+        do from[i] = rnd() % nCells; while (grid_blocked(g, from[i] % g->width, from[i] / g->width));
+        do to[i] = rnd() % nCells; while (grid_blocked(g, to[i] % g->width, to[i] / g->width));
+    }
+    
+    printf("%d x %d cells, %d free, %d queries\n", g->width, g->height, g->nFree, nQueries);
+    printf("%-8s %12s %12s %12s %10s\n", "search", "expanded", "relaxed", "us/query", "speedup");
+    double base = 0;
+    for (int jps = 0; jps <= 1; jps++){
+        SearchStats st;
+        long expanded = 0, relaxed = 0;
+        double t0 = now();
+        for (int i = 0; i < nQueries; i++){
+            status s = grid_search(g, from[i], to[i], jps, NULL, ws, &st);
+            int cost = s == OK ? ws->g[to[i]] : -1;
+            if (!jps) ref[i] = cost;
+            else if (cost != ref[i]){
+                fprintf(stderr, "jump points change the cost of query %d\n", i);
+                return 1;
+            }
+            expanded += st.expanded;
+            relaxed += st.relaxed;
+        }
+        double us = (now() - t0) / nQueries * 1e6;
+        if (!jps) base = us;
+        printf("%-8s %12.1f %12.1f %12.1f %10.2f\n", jps ? "jps" : "astar",
+               (double)expanded / nQueries, (double)relaxed / nQueries, us, base / us);
+    }
+    
+    delWorkspace(ws);
+    free(from); free(to); free(ref);
+    return 0;
+}
+
+
+/** private function writing the answers of a batch as Astar did, a printf per city **/
+static void print_batch(FILE * f, Graph * g, BatchQuery * b, int n){
+    char buf[20];
+    for (int i = 0; i < n; i++){
+        fprintf(f, "%d) ", i + 1);
+        if (b[i].res != OK){
+            fputs("failure\n", f);
+            continue;
+        }
+        Path * p = b[i].path;
+        for (int k = 0; k < p->nNodes; k++)
+            fprintf(f, "%s%s", city_name(g, p->nodes[k], buf), k + 1 < p->nNodes ? "->" : "\n");
+        fprintf(f, "Total distance: %d\n", p->total);
+    }
+    fflush(f);
+}
+
+/** private function writing the answers of a batch through a writer **/
+static status write_batch(FILE * f, format fmt, Graph * g, BatchQuery * b, int n){
+    Writer * w = newWriter(f, fmt, 0);
+    if (!w) return ERRALLOC;
+    write_header(w, RECORD_ROUTE);
+    for (int i = 0; i < n; i++)
+        write_route(w, g, i + 1, b[i].start, b[i].goal, NULL, NULL, b[i].res, UNREACHED, b[i].path);
+    return delWriter(w);
+}
+
+/** bench output: cost of writing the answers, and of listing the cities when loading **/
+static int bench_output(Graph * g, int nQueries){
+    Query * q = random_queries(g, nQueries);
+    BatchQuery * b = (BatchQuery *) malloc(nQueries * sizeof(BatchQuery));
+    Workspace * ws = newWorkspace(g);
+    FILE * null = fopen("/dev/null", "w");
+    FILE * count = tmpfile();
+    if (!q || !b || !ws || !null || !count) return 1;
+    for (int i = 0; i < nQueries; i++){
+        b[i].start = q[i].from->id;
+        b[i].goal = q[i].to->id;
+        b[i].startName = b[i].goalName = NULL;
+        b[i].res = OK;
+        b[i].path = NULL;
+    }
+    SearchStats st;
+    if (run_batch(g, b, nQueries, 1, NULL, ws, &st) != OK) return 1;
+    
+    char * names[] = {"printf", "human", "csv", "json", "binary"};
+    printf("%d cities, %d roads, %d queries\n", g->nCities, g->nEdges, nQueries);
+    printf("%-10s %12s %12s %12s\n", "output", "bytes", "ms", "MB/s");
+    for (int v = 0; v < 5; v++){
+        double best = 1e30;
+        long bytes = 0;
+        for (int rep = 0; rep <= 5; rep++){
+            /* the first run counts the bytes, the others are timed */
+            FILE * f = rep ? null : count;
+            double t0 = now();
+            if (v == 0) print_batch(f, g, b, nQueries);
+            else if (write_batch(f, (format)(v - 1), g, b, nQueries) != OK) return 1;
+            double elapsed = now() - t0;
+            if (!rep){
+                bytes = ftell(count);
+                rewind(count);
+            }
+            else if (elapsed < best) best = elapsed;
+        }
+        printf("%-10s %12ld %12.2f %12.1f\n", names[v], bytes, best * 1e3, bytes / best / 1e6);
+    }
+    
+    /* the listing of map_to_list, sent to /dev/null */
+    printf("%-10s %12s %12s\n", "load", "", "ms");
+    int saved = dup(STDOUT_FILENO);
+    for (int verbose = 0; verbose < 2; verbose++){
+        fflush(stdout);
+        dup2(fileno(null), STDOUT_FILENO);
+        verbose_load = verbose;
+        double t0 = now();
+        List * cities = map_to_list(mapPath);
+        fflush(stdout);
+        double elapsed = now() - t0;
+        dup2(saved, STDOUT_FILENO);
+        if (!cities) return 1;
+        delCities(cities);
+        printf("%-10s %12s %12.2f\n", verbose ? "verbose" : "quiet", "", elapsed * 1e3);
+    }
+    verbose_load = 0;
+    close(saved);
+    
+    for (int i = 0; i < nQueries; i++) delPath(b[i].path);
+    delWorkspace(ws);
+    fclose(null);
+    fclose(count);
+    free(q);
+    free(b);
+    return 0;
+}
+
+
+/** private squared distance from a point to a city, as the spatial index measures it **/
+static long long dist2(Graph * g, int u, int lat, int lgt){
+    long long dx = lat - g->lat[u], dy = lgt - g->lgt[u];
+    return dx * dx + dy * dy;
+}
+
+/** private function finding the city nearest to a point by scanning them all **/
+static int scan_nearest(Graph * g, int lat, int lgt){
+    int best = -1;
+    long long bestD = 0;
+    for (int u = 0; u < g->nCities; u++){
+        long long d = dist2(g, u, lat, lgt);
+        if (best < 0 || d < bestD){
+            best = u;
+            bestD = d;
+        }
+    }
+    return best;
+}
+
+/** bench spatial: lookups of cities by coordinates, with the k-d tree against a scan **/
+static int bench_spatial(Graph * g, int nQueries){
+    enum {K = 8};
+    int n = g->nCities;
+    int latMin = g->lat[0], latMax = g->lat[0], lgtMin = g->lgt[0], lgtMax = g->lgt[0];
+    for (int u = 1; u < n; u++){
+        if (g->lat[u] < latMin) latMin = g->lat[u];
+        if (g->lat[u] > latMax) latMax = g->lat[u];
+        if (g->lgt[u] < lgtMin) lgtMin = g->lgt[u];
+        if (g->lgt[u] > lgtMax) lgtMax = g->lgt[u];
+    }
+    int nPoints = nQueries * 100;
+    int * lat = (int *) malloc(nPoints * sizeof(int));
+    int * lgt = (int *) malloc(nPoints * sizeof(int));
+    int * out = (int *) malloc((n + 1) * sizeof(int));
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    if (!lat || !lgt || !out || !ref) return 1;
+    for (int i = 0; i < nPoints; i++){
+        lat[i] = latMin + (int)(rnd() % ((unsigned)(latMax - latMin) + 1));
+        lgt[i] = lgtMin + (int)(rnd() % ((unsigned)(lgtMax - lgtMin) + 1));
+    }
+    
+    double t0 = now();
+    Spatial * s = build_spatial(g);
+    double build = now() - t0;
+    if (!s) return 1;
+    printf("%d cities, %d points, build %.1f ms, %zu bytes\n", n, nPoints, build * 1e3, spatial_bytes(s));
+    printf("%-12s %10s %14s %12s\n", "lookup", "points", "lookups/s", "cities");
+    
+    /* the nearest city, checked against the scan */
+    t0 = now();
+    for (int i = 0; i < nQueries; i++) ref[i] = scan_nearest(g, lat[i], lgt[i]);
+    double scan = now() - t0;
+    printf("%-12s %10d %14.0f %12.1f\n", "scan", nQueries, nQueries / scan, 1.0);
+    long sum = 0;
+    t0 = now();
+    for (int i = 0; i < nPoints; i++) sum += nearest_city(s, lat[i], lgt[i]);
+    double tree = now() - t0;
+    for (int i = 0; i < nQueries; i++){
+        int u = nearest_city(s, lat[i], lgt[i]);
+        if (dist2(g, u, lat[i], lgt[i]) != dist2(g, ref[i], lat[i], lgt[i])){
+            fprintf(stderr, "nearest city of point %d is %d, not %d\n", i, ref[i], u);
+            return 1;
+        }
+    }
+    printf("%-12s %10d %14.0f %12.1f\n", "nearest", nPoints, nPoints / tree, 1.0);
+    
+    /* the K nearest: the farthest of them is as far as the K-th nearest of a scan */
+    t0 = now();
+    for (int i = 0; i < nPoints; i++) sum += nearest_cities(s, lat[i], lgt[i], K, out);
+    tree = now() - t0;
+    for (int i = 0; i < nQueries && n > K; i++){
+        if (nearest_cities(s, lat[i], lgt[i], K, out) != K) return 1;
+        long long worst = dist2(g, out[K - 1], lat[i], lgt[i]);
+        int closer = 0;
+        for (int u = 0; u < n; u++) closer += dist2(g, u, lat[i], lgt[i]) < worst;
+        for (int j = 1; j < K; j++) if (dist2(g, out[j - 1], lat[i], lgt[i]) > dist2(g, out[j], lat[i], lgt[i])) closer = K;
+        if (closer >= K){
+            fprintf(stderr, "the %d nearest cities of point %d are wrong\n", K, i);
+            return 1;
+        }
+    }
+    printf("%-12s %10d %14.0f %12.1f\n", "nearest 8", nPoints, nPoints / tree, (double)K);
+    
+    /* boxes holding about 1, 10 and 100 cities on average */
+    for (int c = 1; c <= 100; c *= 10){
+        double side = sqrt((double)(latMax - latMin) * (lgtMax - lgtMin) * c / n);
+        int half = (int)(side / 2) + 1;
+        long found = 0;
+        t0 = now();
+        for (int i = 0; i < nPoints; i++)
+            found += cities_in_box(s, lat[i] - half, lgt[i] - half, lat[i] + half, lgt[i] + half, out, n);
+        tree = now() - t0;
+        for (int i = 0; i < nQueries; i++){
+            int got = cities_in_box(s, lat[i] - half, lgt[i] - half, lat[i] + half, lgt[i] + half, out, n), in = 0;
+            for (int u = 0; u < n; u++)
+                in += abs(g->lat[u] - lat[i]) <= half && abs(g->lgt[u] - lgt[i]) <= half;
+            for (int j = 0; j < got; j++)
+                if (abs(g->lat[out[j]] - lat[i]) > half || abs(g->lgt[out[j]] - lgt[i]) > half) in = -1;
+            if (got != in){
+                fprintf(stderr, "box of point %d holds %d cities, not %d\n", i, in, got);
+                return 1;
+            }
+        }
+        char label[16];
+        snprintf(label, sizeof label, "box %d", c);
+        printf("%-12s %10d %14.0f %12.1f\n", label, nPoints, nPoints / tree, (double)found / nPoints);
+    }
+    
+    printf("checksum %ld\n", sum);
+    delSpatial(s);
+    free(lat);
+    free(lgt);
+    free(out);
+    free(ref);
+    return 0;
+}
+
+
+/** bench goals: expansions saved by exact estimates toward hot goals **/
+static int bench_goals(Graph * g, int nQueries){
+    enum {HOT = 8};
+    int goal[HOT];
+    Query * q = (Query *) malloc(nQueries * sizeof(Query));
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * costs = (int *) malloc(nQueries * sizeof(int));
+    Workspace * ws = newWorkspace(g);
+    SearchStats st;
+    if (!q || !ref || !costs || !ws) return 1;
+    for (int k = 0; k < HOT; k++) goal[k] = rnd() % g->nCities;
+    for (int i = 0; i < nQueries; i++){
+        int to = goal[rnd() % HOT], from;
+        do from = rnd() % g->nCities; while (g->component[from] != g->component[to]);
+        q[i].from = g->cities[from];
+        q[i].to = g->cities[to];
+    }
+    
+    size_t perGoal = (g->nCities + 1) * sizeof(int);
+    printf("%d cities, %d roads, %d queries toward %d goals\n", g->nCities, g->nEdges, nQueries, HOT);
+    printf("%-10s %12s %12s %8s %8s %8s %10s %8s\n",
+           "cache", "us/query", "expanded", "held", "hits", "built", "build s", "evicted");
+    double baseExpanded = 0;
+    for (int run = 0; run < 4; run++){
+        int held[4] = {0, HOT, 2, HOT};
+        GoalCache * c = held[run] ? newGoalCache(g, held[run] * perGoal, 0) : NULL;
+        if (held[run] && !c) return 1;
+        int * out = run ? costs : ref;
+        long expanded = 0;
+        double t0 = now();
+        if (run < 3){
+            ws->goals = c;
+            for (int i = 0; i < nQueries; i++){
+                status s = astar(g, q[i].from->id, q[i].to->id, NULL, ws, &st);
+                out[i] = s == OK ? ws->g[ws->reached] : -1;
+                expanded += st.expanded;
+            }
+        }
+        else {
+            Router * r = newRouter(g, 4, 64);
+            if (!r) return 1;
+            router_use_goals(r, c);
+            for (int i = 0; i < nQueries; i++){
+                Ticket * tk = newTicket(q[i].from->id, q[i].to->id, NULL, store_cost, &out[i]);
+                if (!tk || router_submit(r, tk, 1) != OK) return 1;
+            }
+            router_drain(r);
+            delRouter(r);
+        }
+        double us = (now() - t0) / nQueries * 1e6;
+        for (int i = 0; run && i < nQueries; i++)
+            if (costs[i] != ref[i]){
+                fprintf(stderr, "the goal cache changes the cost of query %d\n", i);
+                return 1;
+            }
+        
+        char label[16];
+        snprintf(label, sizeof(label), run == 3 ? "%d, router" : "%d goals", held[run]);
+        if (!run){
+            baseExpanded = (double)expanded / nQueries;
+            printf("%-10s %12.1f %12.1f\n", "none", us, baseExpanded);
+            continue;
+        }
+        GoalCacheStats gs;
+        goal_cache_stats(c, &gs);
+        if (run < 3) printf("%-10s %12.1f %12.1f", label, us, (double)expanded / nQueries);
+        else printf("%-10s %12.1f %12s", label, us, "-");
+        printf(" %8d %8ld %8ld %10.3f %8ld\n", gs.held, gs.hits, gs.builds, gs.buildSeconds, gs.evictions);
+        delGoalCache(c);
+    }
+    
+    ws->goals = NULL;
+    delWorkspace(ws);
+    free(q);
+    free(ref);
+    free(costs);
+    return 0;
+}
+
+
+/** private order of ints, for qsort **/
+static int by_int(const void * a, const void * b){
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+
+/** bench range: cities within a distance, against Dijkstra and on threads **/
+static int bench_range(Graph * g, int nQueries){
+    enum {CHECKED = 10};
+    int n = g->nCities;
+    int * origins = (int *) malloc(nQueries * sizeof(int));
+    int * dist = (int *) malloc((n + 1) * sizeof(int));
+    int * parent = (int *) malloc((n + 1) * sizeof(int));
+    int * count = (int *) malloc(nQueries * sizeof(int));
+    Reach ** reach = (Reach **) calloc(nQueries, sizeof(Reach *));
+    long procs = sysconf(_SC_NPROCESSORS_ONLN);
+    int maxThreads = procs > 4 ? (int)procs : 4;
+    Workspace ** ws = (Workspace **) calloc(maxThreads, sizeof(Workspace *));
+    if (!origins || !dist || !parent || !count || !reach || !ws) return 1;
+    for (int i = 0; i < nQueries; i++){
+        origins[i] = rnd() % n;
+        if (!(reach[i] = newReach(0))) return 1;
+    }
+    for (int t = 0; t < maxThreads; t++)
+        if (!(ws[t] = newWorkspace(g))) return 1;
+    
+    /* the distances of the 100th, 1000th and 10000th cities from a random one */
+    if (dijkstra(g, rnd() % n, dist, parent) != OK) return 1;
+    qsort(dist, n, sizeof(int), by_int);
+    int radius[3];
+    for (int k = 0, size = 100; k < 3; k++, size *= 10) radius[k] = dist[size < n ? size : n - 1];
+    
+    printf("%d cities, %d roads, %d origins, %ld processors\n", n, g->nEdges, nQueries, procs);
+    printf("%10s %10s %-12s %12s %12s %10s\n", "distance", "cities", "search", "us/origin", "heap grown", "speedup");
+    for (int k = 0; k < 3; k++){
+        int d = radius[k];
+        
+        /* full trees, filtered: the reference */
+        int checked = nQueries < CHECKED ? nQueries : CHECKED;
+        for (int i = 0; i < checked; i++){
+            if (dijkstra(g, origins[i], dist, parent) != OK || range_search(g, origins[i], d, ws[0], reach[i], NULL) != OK)
+                return 1;
+            int within = 0;
+            for (int u = 0; u < n; u++) within += dist[u] <= d;
+            for (int j = 0; j < reach[i]->n; j++)
+                if (dist[reach[i]->node[j]] != reach[i]->dist[j]) within = -1;
+            if (within != reach[i]->n){
+                fprintf(stderr, "the range search from %d disagrees with Dijkstra\n", origins[i]);
+                return 1;
+            }
+        }
+        double dijkstraUs = 0;
+        for (int i = 0; i < checked; i++){
+            double t1 = now();
+            dijkstra(g, origins[i], dist, parent);
+            dijkstraUs += (now() - t1) * 1e6;
+        }
+        dijkstraUs /= checked;
+        
+        /* one origin after the other on the same workspace and the same set */
+        long cities = 0;
+        Reach * one = reach[0];
+        size_t heap0 = mallinfo2().uordblks;
+        double t1 = now();
+        for (int i = 0; i < nQueries; i++){
+            if (range_search(g, origins[i], d, ws[0], one, NULL) != OK) return 1;
+            count[i] = one->n;
+            cities += one->n;
+        }
+        double us = (now() - t1) / nQueries * 1e6;
+        size_t grown = mallinfo2().uordblks - heap0;
+        printf("%10d %10.1f %-12s %12.1f %12s %10s\n", d, (double)cities / nQueries, "dijkstra", dijkstraUs, "-", "-");
+        printf("%10d %10.1f %-12s %12.1f %12zu %10.2f\n", d, (double)cities / nQueries, "range", us, grown, dijkstraUs / us);
+        
+        /* every origin in its own set, shared among threads */
+        double base = 0;
+        for (int threads = 1; threads <= maxThreads; threads *= 2){
+            SearchStats st;
+            double t2 = now();
+            if (range_searches(g, origins, nQueries, d, ws, threads, reach, &st) != OK) return 1;
+            double ust = (now() - t2) / nQueries * 1e6;
+            for (int i = 0; i < nQueries; i++)
+                if (reach[i]->origin != origins[i] || reach[i]->n != count[i]){
+                    fprintf(stderr, "range searches on %d threads disagree from origin %d\n", threads, origins[i]);
+                    return 1;
+                }
+            if (threads == 1) base = ust;
+            char label[16];
+            snprintf(label, sizeof(label), "range x%d", threads);
+            printf("%10d %10.1f %-12s %12.1f %12s %10.2f\n", d, (double)cities / nQueries, label, ust, "-", base / ust);
+        }
+    }
+    
+    for (int i = 0; i < nQueries; i++) delReach(reach[i]);
+    for (int t = 0; t < maxThreads; t++) delWorkspace(ws[t]);
+    free(reach);
+    free(ws);
+    free(origins);
+    free(dist);
+    free(parent);
+    free(count);
+    return 0;
+}
+
+
+/** available experiments, on a map of cities or on a grid **/
+static struct{
+    char * name;
+    int (*run)(Graph *, int);
+    int (*runGrid)(Grid *, int);
+} experiments[] = {
+    {"order", bench_order, NULL},
+    {"compress", bench_compress, NULL},
+    {"sssp", bench_sssp, NULL},
+    {"arcflags", bench_arcflags, NULL},
+    {"tiles", bench_tiles, NULL},
+    {"heuristic", bench_heuristic, NULL},
+    {"ksp", bench_ksp, NULL},
+    {"batch", bench_batch, NULL},
+    {"async", bench_async, NULL},
+    {"shared", bench_shared, NULL},
+    {"hda", bench_hda, NULL},
+    {"hubs", bench_hubs, NULL},
+    {"delta", bench_delta, NULL},
+    {"output", bench_output, NULL},
+    {"spatial", bench_spatial, NULL},
+    {"goals", bench_goals, NULL},
+    {"range", bench_range, NULL},
+    {"grid", NULL, bench_grid},
+};
+#define N_EXPERIMENTS (int)(sizeof(experiments) / sizeof(experiments[0]))
+
+
+int main(int argc, char * argv[]){
+    int x = 0;
+    while (argc >= 3 && x < N_EXPERIMENTS && strcmp(argv[1], experiments[x].name) != 0) x++;
+    if (argc < 3 || x == N_EXPERIMENTS){
+        fprintf(stderr, "usage: %s experiment map [n_queries [seed]]\nexperiments:", argv[0]);
+        for (x = 0; x < N_EXPERIMENTS; x++) fprintf(stderr, " %s", experiments[x].name);
+        fputc('\n', stderr);
+        return 1;
+    }
+    int nQueries = argc > 3 ? atoi(argv[3]) : 1000;
+    if (argc > 4) seed_state = strtoull(argv[4], NULL, 10);
+    
+    verbose_load = 0;
+    mapPath = argv[2];
+    double t0 = now();
+    if (experiments[x].runGrid){
+        Grid * grid = load_grid(argv[2]);
+        if (!grid){
+            fprintf(stderr, "%s: %s\n", argv[2], message(ERROPEN));
+            return 1;
+        }
+        printf("loaded in %.2f s\n", now() - t0);
+        int res = experiments[x].runGrid(grid, nQueries > 0 ? nQueries : 1);
+        delGrid(grid);
+        return res;
+    }
+
+    size_t heap0 = mallinfo2().uordblks;
+    List * all_cities = map_to_list(argv[2]);
+    listBytes = mallinfo2().uordblks - heap0;
+    if (!all_cities){
+        fprintf(stderr, "%s: %s\n", argv[2], message(ERROPEN));
+        return 1;
+    }
+    Graph * g = list_to_graph(all_cities);
+    if (!g){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    printf("loaded in %.2f s\n", now() - t0);
+    
+    int res = experiments[x].run(g, nQueries > 0 ? nQueries : 1);
+    delGraph(g);
+    return res;
+}
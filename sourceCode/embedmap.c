@@ -0,0 +1,49 @@
+//
+//  embedmap.c
+//  Astar
+//
+//  Generator of the C source of an embedded map (see Embedded.h).
+//
+//  usage: embedmap [-H manhattan|euclidean|greatcircle] map > EmbeddedMap.c
+//
+//  The map (text or compressed) is read as Astar reads it and the estimate
+//  calibrated in the given metric (Manhattan by default), so the program
+//  it is compiled into does neither.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "Map.h"
+#include "Graph.h"
+#include "Compress.h"
+#include "Embedded.h"
+
+int main(int argc, char * argv[]){
+    char * metrics[] = {"manhattan", "euclidean", "greatcircle"};
+    char * estimate = metrics[0];
+    int opt;
+    while ((opt = getopt(argc, argv, "H:")) != -1) estimate = opt == 'H' ? optarg : "";
+    int m = 0;
+    while (m < 3 && strcmp(estimate, metrics[m]) != 0) m++;
+    if (m == 3 || optind + 1 != argc){
+        fprintf(stderr, "usage: %s [-H manhattan|euclidean|greatcircle] map > EmbeddedMap.c\n", argv[0]);
+        return 1;
+    }
+    
+    char * mapfile = argv[optind];
+    verbose_load = 0;
+    Graph * g = NULL;
+    if (is_compressed(mapfile)) g = load_compressed(mapfile);
+    else {
+        List * all_cities = map_to_list(mapfile);
+        if (all_cities) g = list_to_graph(all_cities);
+    }
+    status s = !g ? ERROPEN : calibrate_h(g, (metric)m);
+    if (s == OK) s = write_embedded(g, mapfile, stdout);
+    if (s != OK){
+        fprintf(stderr, "%s: %s\n", mapfile, message(s));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+//
+//  genmap.c
+//  Astar
+//
+//  Generator of large maps in the FRANCE.MAP format, used to measure the
+//  searches on graphs much bigger than the committed map.
+//
+//  usage: genmap n_cities [seed] > file.MAP
+//         genmap -g width height [seed] > file.map
+//
+//  Cities are laid out on a jittered square grid and linked to their right
+//  and lower grid neighbours (and some diagonals), roads in both directions.
+//  Road lengths are half the euclidean distance, rounded up, which keeps
+//  h_of_n admissible. Cities are written in a random order under names that
+//  are unrelated to their position.
+//
+//  With -g, a warehouse floor plan is written in the octile grid format:
+//  bands of shelves two cells deep separated by aisles three cells wide,
+//  cut by cross aisles, with pallets left at random on the middle lane of
+//  the aisles (which never disconnects the floor).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/** distance between two grid points, in map units **/
+#define SPACING 100
+#define JITTER 30
+
+/** private linear congruential generator, so maps only depend on the seed **/
+static unsigned long long seed_state;
+static unsigned rnd(void){
+    seed_state = seed_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned)(seed_state >> 33);
+}
+
+static int * lat;
+static int * lgt;
+static int * name;
+
+static int road(int u, int v){
+    double dx = lat[u] - lat[v], dy = lgt[u] - lgt[v];
+    return (int)ceil(sqrt(dx * dx + dy * dy) / 2);
+}
+
+static void prRoad(int u, int v){
+    printf("C%07d\t%d\n", name[v], road(u, v));
+}
+
+/** warehouse layout: period of the shelf bands and of the cross aisles **/
+#define BAND 5
+#define BLOCK 13
+#define SHELF 10
+
+static int gen_grid(int argc, char * argv[]){
+    if (argc < 4){
+        fprintf(stderr, "usage: %s -g width height [seed]\n", argv[0]);
+        return 1;
+    }
+    int width = atoi(argv[2]), height = atoi(argv[3]);
+    seed_state = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    if (width < 1 || height < 1){
+        fprintf(stderr, "%s: width and height must be positive\n", argv[0]);
+        return 1;
+    }
+    
+    printf("type octile\nheight %d\nwidth %d\nmap\n", height, width);
+    for (int y = 0; y < height; y++){
+        for (int x = 0; x < width; x++){
+            int shelf = y % BAND >= 3 && x % BLOCK < SHELF;
+            int lane = y % BAND == 1 || x % BLOCK == SHELF + 1;
+            putchar(shelf || (lane && rnd() % 8 == 0) ? '@' : '.');
+        }
+        putchar('\n');
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[]){
+    if (argc > 1 && strcmp(argv[1], "-g") == 0) return gen_grid(argc, argv);
+    if (argc < 2){
+        fprintf(stderr, "usage: %s n_cities [seed]\n", argv[0]);
+        return 1;
+    }
+    int n = atoi(argv[1]);
+    seed_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    int side = (int)ceil(sqrt((double)n));
+    if (n < 2 || n > 9999999){
+        fprintf(stderr, "%s: n_cities must be between 2 and 9999999\n", argv[0]);
+        return 1;
+    }
+    
+    lat = (int *) malloc(n * sizeof(int));
+    lgt = (int *) malloc(n * sizeof(int));
+    name = (int *) malloc(n * sizeof(int));
+    int * order = (int *) malloc(n * sizeof(int));
+    if (!lat || !lgt || !name || !order) return 1;
+    
+    /* position u is at row u/side, column u%side; names and output order are shuffled */
+    for (int u = 0; u < n; u++){
+        lat[u] = (u % side) * SPACING + (int)(rnd() % (2 * JITTER + 1)) - JITTER;
+        lgt[u] = (u / side) * SPACING + (int)(rnd() % (2 * JITTER + 1)) - JITTER;
+        name[u] = u;
+        order[u] = u;
+    }
+    for (int u = n - 1; u > 0; u--){
+        int v = rnd() % (u + 1), t;
+        t = name[u]; name[u] = name[v]; name[v] = t;
+        v = rnd() % (u + 1);
+        t = order[u]; order[u] = order[v]; order[v] = t;
+    }
+    
+    for (int i = 0; i < n; i++){
+        int u = order[i], row = u / side, col = u % side;
+        printf("C%07d\t%d\t%d\n", name[u], lat[u], lgt[u]);
+        if (col > 0) prRoad(u, u - 1);
+        if (col + 1 < side && u + 1 < n) prRoad(u, u + 1);
+        if (row > 0) prRoad(u, u - side);
+        if (u + side < n) prRoad(u, u + side);
+        
+        /* diagonal roads are decided by the upper-left city of each grid square */
+        if (col + 1 < side && u + side + 1 < n && (name[u] % 3) == 0) prRoad(u, u + side + 1);
+        if (col > 0 && row > 0 && (name[u - side - 1] % 3) == 0) prRoad(u, u - side - 1);
+        putchar('\n');
+    }
+    
+    free(lat);
+    free(lgt);
+    free(name);
+    free(order);
+    return 0;
+}
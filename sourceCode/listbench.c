@@ -0,0 +1,307 @@
+//
+//  listbench.c
+//  Astar
+//
+//  Micro-benchmarks of the List library, to catch regressions in the
+//  container layer.
+//
+//  usage: listbench [-r repetitions] [-w warmup] [-f text|csv|json] [-s seed] [size ...]
+//
+//  Every operation is measured at each list size (16, 256 and 4096 by
+//  default) under several access patterns: at the front, at the back or at
+//  random positions; sorted insertions of ascending, descending or random
+//  elements; present or absent elements. A sample times batches of
+//  operations (at least 4096 in all), the list being rebuilt between
+//  batches outside of the timed part; operations that insert or remove
+//  elements run on lists holding between size and twice size elements.
+//  The pool case times insertions with the available Nodes list warm
+//  (Nodes are reused) and cold (every Node comes from malloc).
+//
+//  After the warmup samples, which are discarded, the median, 99th
+//  percentile and minimum time per operation of the repetitions are
+//  displayed as a table, or written as CSV or JSON lines.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "List.h"
+
+/** number of operations a sample measures at least **/
+#define SAMPLE_OPS 4096
+
+/** private linear congruential generator, so runs only depend on the seed **/
+static unsigned long long seed_state = 1;
+static unsigned rnd(void){
+    seed_state = seed_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned)(seed_state >> 33);
+}
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** elements of the lists: values[i] is i, up to 4 times the list size **/
+static int * values;
+
+/** per-batch arguments (positions or indices into values), drawn before timing **/
+static int * args;
+
+/** keeps the results of the operations alive **/
+static volatile long sink;
+
+static int compInt(void * e1, void * e2){
+    return *(int *)e1 - *(int *)e2;
+}
+
+static void addInt(void * e){
+    sink += *(int *)e;
+}
+
+
+/** private function building the list of values[from] to values[from+count-1], in order **/
+static List * build(int from, int count){
+    List * l = newList(compInt, NULL);
+    for (int i = from + count - 1; i >= from; i--) addListAt(l, 1, &values[i]);
+    return l;
+}
+
+
+/** private function drawing the position of the i-th operation of a batch,
+ * on a list of n elements that grows (positions 1 to n+i+1) or shrinks
+ * (positions 1 to n-i) with every operation **/
+static void positions(int n, int count, int grow, int pattern){
+    for (int i = 0; i < count; i++){
+        int len = grow ? n + i + 1 : n - i;
+        args[i] = pattern == 0 ? 1 : pattern == 1 ? len : 1 + (int)(rnd() % len);
+    }
+}
+
+
+/*************************************************************
+ * Sample functions: each measures one sample of an operation on lists
+ * of size n with the given pattern
+ * @param n the list size
+ * @param pattern index of the access pattern
+ * @param ops (out) number of operations timed
+ * @return the time spent in the timed operations, in nanoseconds
+ *************************************************************/
+
+static double sample_addListAt(int n, int pattern, long * ops){
+    double t = 0;
+    for (*ops = 0; *ops < SAMPLE_OPS; *ops += n){
+        List * l = build(0, n);
+        positions(n, n, 1, pattern);
+        double t0 = now_ns();
+        for (int i = 0; i < n; i++) addListAt(l, args[i], &values[i]);
+        t += now_ns() - t0;
+        delList(l);
+    }
+    return t;
+}
+
+static double sample_remFromListAt(int n, int pattern, long * ops){
+    double t = 0;
+    void * res;
+    for (*ops = 0; *ops < SAMPLE_OPS; *ops += n){
+        List * l = build(0, 2 * n);
+        positions(2 * n, n, 0, pattern);
+        double t0 = now_ns();
+        for (int i = 0; i < n; i++) remFromListAt(l, args[i], &res);
+        t += now_ns() - t0;
+        delList(l);
+    }
+    return t;
+}
+
+static double sample_addList(int n, int pattern, long * ops){
+    double t = 0;
+    for (*ops = 0; *ops < SAMPLE_OPS; *ops += n){
+        List * l = build(n, n);
+        for (int i = 0; i < n; i++)
+            args[i] = pattern == 0 ? 2 * n + i : pattern == 1 ? n - 1 - i : (int)(rnd() % (3 * n));
+        double t0 = now_ns();
+        for (int i = 0; i < n; i++) addList(l, &values[args[i]]);
+        t += now_ns() - t0;
+        delList(l);
+    }
+    return t;
+}
+
+static double sample_remFromList(int n, int pattern, long * ops){
+    double t = 0;
+    for (*ops = 0; *ops < SAMPLE_OPS; *ops += n){
+        List * l = build(0, 2 * n);
+        if (pattern == 2){
+            /* n distinct elements drawn among the 2n of the list */
+            for (int i = 0; i < 2 * n; i++) args[i] = i;
+            for (int i = 0; i < n; i++){
+                int j = i + (int)(rnd() % (2 * n - i)), tmp = args[i];
+                args[i] = args[j];
+                args[j] = tmp;
+            }
+        }
+        else for (int i = 0; i < n; i++) args[i] = pattern == 0 ? i : 2 * n - 1 - i;
+        double t0 = now_ns();
+        for (int i = 0; i < n; i++) remFromList(l, &values[args[i]]);
+        t += now_ns() - t0;
+        delList(l);
+    }
+    return t;
+}
+
+static double sample_isInList(int n, int pattern, long * ops){
+    int count = SAMPLE_OPS * 16 / n > 16 ? SAMPLE_OPS * 16 / n : 16;
+    List * l = build(0, n);
+    for (int i = 0; i < count; i++)
+        args[i] = pattern == 0 ? 0 : pattern == 1 ? (int)(rnd() % n) : 2 * n;
+    double t0 = now_ns();
+    for (int i = 0; i < count; i++) sink += isInList(l, &values[args[i]]) != 0;
+    double t = now_ns() - t0;
+    delList(l);
+    *ops = count;
+    return t;
+}
+
+static double sample_nthInList(int n, int pattern, long * ops){
+    int count = SAMPLE_OPS * 16 / n > 16 ? SAMPLE_OPS * 16 / n : 16;
+    void * res;
+    List * l = build(0, n);
+    for (int i = 0; i < count; i++) args[i] = pattern == 0 ? 1 : pattern == 1 ? n : 1 + (int)(rnd() % n);
+    double t0 = now_ns();
+    for (int i = 0; i < count; i++){
+        nthInList(l, args[i], &res);
+        sink += *(int *)res;
+    }
+    double t = now_ns() - t0;
+    delList(l);
+    *ops = count;
+    return t;
+}
+
+static double sample_forEach(int n, int pattern, long * ops){
+    int rounds = SAMPLE_OPS * 16 / n > 1 ? SAMPLE_OPS * 16 / n : 1;
+    List * l = build(0, n);
+    double t0 = now_ns();
+    for (int r = 0; r < rounds; r++) forEach(l, addInt);
+    double t = now_ns() - t0;
+    delList(l);
+    *ops = (long)rounds * n;
+    return t;
+}
+
+static double sample_pool(int n, int pattern, long * ops){
+    double t = 0;
+    for (*ops = 0; *ops < SAMPLE_OPS; *ops += n){
+        List * l = newList(compInt, NULL);
+        if (pattern == 1) freeAvailable();
+        else if (lengthAvailable() < n) delList(build(0, n));
+        double t0 = now_ns();
+        for (int i = 0; i < n; i++) addListAt(l, 1, &values[i]);
+        t += now_ns() - t0;
+        delList(l);
+    }
+    return t;
+}
+
+
+/** measured operations with the names of their access patterns **/
+static struct{
+    char * op;
+    char * patterns[3];
+    double (*sample)(int, int, long *);
+} cases[] = {
+    {"addListAt", {"front", "back", "random"}, sample_addListAt},
+    {"remFromListAt", {"front", "back", "random"}, sample_remFromListAt},
+    {"addList", {"ascending", "descending", "random"}, sample_addList},
+    {"remFromList", {"front", "back", "random"}, sample_remFromList},
+    {"isInList", {"front", "random", "absent"}, sample_isInList},
+    {"nthInList", {"front", "back", "random"}, sample_nthInList},
+    {"forEach", {"all"}, sample_forEach},
+    {"pool", {"warm", "cold"}, sample_pool},
+};
+#define N_CASES (int)(sizeof(cases) / sizeof(cases[0]))
+
+
+static int compDouble(const void * a, const void * b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+int main(int argc, char * argv[]){
+    int reps = 31, warmup = 3, opt;
+    char * format = "text";
+    while ((opt = getopt(argc, argv, "r:w:f:s:")) != -1){
+        switch (opt){
+            case 'r': reps = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'f': format = optarg; break;
+            case 's': seed_state = strtoull(optarg, NULL, 10); break;
+            default: reps = 0;
+        }
+    }
+    if (reps < 1 || warmup < 0 || (strcmp(format, "text") && strcmp(format, "csv") && strcmp(format, "json"))){
+        fprintf(stderr, "usage: %s [-r repetitions] [-w warmup] [-f text|csv|json] [-s seed] [size ...]\n", argv[0]);
+        return 1;
+    }
+
+    int defaults[] = {16, 256, 4096};
+    int nSizes = optind < argc ? argc - optind : 3, maxSize = 1;
+    int * sizes = (int *) malloc(nSizes * sizeof(int));
+    double * samples = (double *) malloc(reps * sizeof(double));
+    if (!sizes || !samples) return 1;
+    for (int s = 0; s < nSizes; s++){
+        sizes[s] = optind < argc ? atoi(argv[optind + s]) : defaults[s];
+        if (sizes[s] < 1){
+            fprintf(stderr, "%s: sizes must be positive\n", argv[0]);
+            return 1;
+        }
+        if (sizes[s] > maxSize) maxSize = sizes[s];
+    }
+    int nArgs = 4 * maxSize > SAMPLE_OPS * 16 ? 4 * maxSize : SAMPLE_OPS * 16;
+    values = (int *) malloc(4 * maxSize * sizeof(int));
+    args = (int *) malloc(nArgs * sizeof(int));
+    if (!values || !args) return 1;
+    for (int i = 0; i < 4 * maxSize; i++) values[i] = i;
+
+    if (strcmp(format, "csv") == 0) puts("op,pattern,size,samples,median_ns,p99_ns,min_ns");
+    else if (strcmp(format, "text") == 0)
+        printf("%-14s %-11s %8s %12s %12s %12s\n", "operation", "pattern", "size", "median ns", "p99 ns", "min ns");
+
+    for (int c = 0; c < N_CASES; c++)
+        for (int p = 0; p < 3 && cases[c].patterns[p]; p++)
+            for (int s = 0; s < nSizes; s++){
+                for (int r = -warmup; r < reps; r++){
+                    long ops;
+                    double t = cases[c].sample(sizes[s], p, &ops);
+                    if (r >= 0) samples[r] = t / ops;
+                }
+                qsort(samples, reps, sizeof(double), compDouble);
+                double median = samples[reps / 2];
+                double p99 = samples[(int)(0.99 * (reps - 1) + 0.5)];
+                double min = samples[0];
+
+                if (strcmp(format, "csv") == 0)
+                    printf("%s,%s,%d,%d,%.2f,%.2f,%.2f\n", cases[c].op, cases[c].patterns[p],
+                           sizes[s], reps, median, p99, min);
+                else if (strcmp(format, "json") == 0)
+                    printf("{\"op\":\"%s\",\"pattern\":\"%s\",\"size\":%d,\"samples\":%d,"
+                           "\"median_ns\":%.2f,\"p99_ns\":%.2f,\"min_ns\":%.2f}\n", cases[c].op,
+                           cases[c].patterns[p], sizes[s], reps, median, p99, min);
+                else printf("%-14s %-11s %8d %12.2f %12.2f %12.2f\n", cases[c].op, cases[c].patterns[p],
+                            sizes[s], median, p99, min);
+                fflush(stdout);
+            }
+
+    freeAvailable();
+    free(values);
+    free(args);
+    free(sizes);
+    free(samples);
+    return 0;
+}
@@ -7,67 +7,896 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "Map.h"
+#include "Graph.h"
+#include "Search.h"
+#include "Path.h"
+#include "Reorder.h"
+#include "Compress.h"
+#include "Sssp.h"
+#include "ArcFlags.h"
+#include "Tiles.h"
+#include "Grid.h"
+#include "Trace.h"
+#include "Ksp.h"
+#include "Batch.h"
+#include "Shared.h"
+#include "Embedded.h"
+#include "Hda.h"
+#include "Memory.h"
+#include "Hub.h"
+#include "Delta.h"
+#include "Output.h"
+#include "Spatial.h"
+#include "GoalCache.h"
+#include "Range.h"
 
-int main(){
+/** most delta files given with -u **/
+#define MAX_DELTAS 16
 
-    List * all_cities = map_to_list("/Users/Lin/Desktop/Specialization Period/Advanced C/Project/Astar/Astar/FRANCE.MAP");
-    List * OPEN = newList(comp_f_of_n, prCities);
-    List * CLOSED = newList(compString, prCities);
-    City * start = find_city(all_cities, "Rennes");
-    City * goal = find_city(all_cities, "Lyon");
+static void usage(char * prog){
+    fprintf(stderr, "usage: %s [-e max_expansions] [-t max_seconds] [-m max_bytes]"
+            " [-r hilbert|rcm] [-p order_file] [-z packed_file] [-f regions]\n"
+            "       [-T tiled_file] [-C cache_bytes] [-H manhattan|euclidean|greatcircle|none] [-s] [-M] [-v]\n"
+            "       [-k paths] [-D threads] [-L hub_file] [-u delta_file ...] [-G goal_cache_bytes] [-o format] [-x trace_file]\n"
+            "       [-E | map] [start goal]\n"
+            "       %s [-e max_expansions] [-t max_seconds] [-m max_bytes] [-i] [-w workers] [-L hub_file] [-u delta_file ...] [-s] [-M]\n"
+            "       [-G goal_cache_bytes] [-v] [-o format] -b batch_file [map]\n"
+            "       %s -a [-j threads] [-o format] map start\n"
+            "       %s -R max_distance [-j threads] [-s] [-o format] map start ...\n"
+            "       %s [-e max_expansions] [-t max_seconds] [-m max_bytes] [-n] [-z packed_file] [-s]"
+            " [-x trace_file] grid x,y x,y\n"
+            "format: human (default), csv, json or binary\n"
+            "a city is a name or coordinates lat,lgt; put -- before the map if some are negative\n"
+            "-H none leaves the estimate uncalibrated, also in a tiled map saved with it: a batch then needs -i\n", prog, prog, prog, prog, prog);
+}
+
+
+/*************************************************************
+ * private function writing the events recorded by the trace points, then
+ * freeing them
+ * @param tracefile the file to write, NULL for none
+ * @return the exit code of the program
+ *************************************************************/
+static int dump_trace(char * tracefile){
+    status s = tracefile ? trace_dump(tracefile) : OK;
+    trace_close();
+    if (s != OK){
+        fprintf(stderr, "%s: %s\n", tracefile, s == ERRUNABLE ? "built without TRACE" : message(s));
+        return 1;
+    }
+    return 0;
+}
+
+
+/*************************************************************
+ * private function writing the rest of the results, then the trace
+ * @param out the writer of the results
+ * @param tracefile the file of the trace, NULL for none
+ * @return the exit code of the program
+ *************************************************************/
+static int finish(Writer * out, char * tracefile){
+    status s = delWriter(out);
+    if (s != OK){
+        fprintf(stderr, "%s\n", message(s));
+        return 1;
+    }
+    return dump_trace(tracefile);
+}
+
+
+/** stream of the statistics, where -M displays the memory used **/
+static FILE * memory_info = NULL;
+
+/** private function displaying the memory used, at exit when -M is given **/
+static void report_memory(void){
+    mem_report(memory_info ? memory_info : stdout);
+}
+
+
+/*************************************************************
+ * private function searching a path on a grid map, the cells being
+ * given as "x,y"
+ * @return the exit code of the program
+ *************************************************************/
+static int run_grid(char * mapfile, char * from, char * to, int jps, char * packedfile,
+                    Budget * budget, int showStats){
+    Grid * grid = load_grid(mapfile);
+    if (!grid){
+        fprintf(stderr, "%s: %s\n", mapfile, message(ERROPEN));
+        return 1;
+    }
+    if (packedfile && save_grid(grid, packedfile) != OK){
+        fprintf(stderr, "%s: %s\n", packedfile, message(ERROPEN));
+        return 1;
+    }
+    int start = grid_node(grid, from);
+    int goal = grid_node(grid, to);
+    if (start < 0 || goal < 0){
+        fprintf(stderr, "%s: %s\n", start < 0 ? from : to, message(ERRABSENT));
+        return 1;
+    }
     
-    addList(OPEN, start);
-    start->distFromStart = 0;
-    start->distToGoal=h_of_n(start, goal);
+    Workspace * ws = newGridWorkspace(grid);
+    Path * path = newPath(grid->width * grid->height);
+    if (!ws || !path){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    SearchStats stats;
+    status s = grid_search(grid, start, goal, jps, budget, ws, &stats);
+    if (s != ERRNOPATH && extract_path(ws, path) != OK){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
     
-    while(OPEN->head){
-        void * e;
-        remFromListAt(OPEN, 1, &e);
-        addList(CLOSED, e);
-        City * n = (City *) e;
-        
-        if(n == goal){
-            puts("\n");
-            puts("Success!\n");
-            puts("The path found:\n");
-            while(n){
-                printf("%s<-",n->name);
-                n = n ->ptr;
-            }
-            puts("\n");
-            return 0;
+    if (s == OK){
+        puts("\n");
+        puts("Success!\n");
+        puts("The path found:\n");
+        prGridPath(grid, path);
+    }
+    else if (s == ERRBUDGET){
+        puts("\n");
+        printf("%s after %ld expansions\n\n", message(s), stats.expanded);
+        puts("Best partial path:\n");
+        prGridPath(grid, path);
+    }
+    else{
+        puts("failure");
+    }
+    if (showStats)
+        printf("expanded %ld, relaxed %ld, reopened %ld, %zu bytes, %.6f s\n",
+               stats.expanded, stats.relaxed, stats.reopened, stats.bytes, stats.seconds);
+    
+    delPath(path);
+    delWorkspace(ws);
+    delGrid(grid);
+    return 0;
+}
+
+
+/** private function displaying the occupancy and counters of a goal cache **/
+static void show_goals(FILE * info, GoalCache * goals){
+    GoalCacheStats gs;
+    if (!goals) return;
+    goal_cache_stats(goals, &gs);
+    fprintf(info, "goal cache: %d of %d goals held (%zu bytes), %ld hits in %ld searches, %ld built in %.3f s, %ld evicted\n",
+            gs.held, gs.capacity, gs.bytes, gs.hits, gs.lookups, gs.builds, gs.buildSeconds, gs.evictions);
+}
+
+
+/** private order of the queries of a batch by start city, then by position **/
+static BatchQuery * sort_batch;
+static int by_start_city(const void * a, const void * b){
+    int x = *(const int *)a, y = *(const int *)b;
+    if (sort_batch[x].start != sort_batch[y].start) return sort_batch[x].start < sort_batch[y].start ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+
+/** private function reading all a worker sends, into a buffer to free **/
+static char * read_all(int fd, size_t * size){
+    size_t cap = 1 << 16;
+    char * buf = (char *) malloc(cap);
+    ssize_t got;
+    *size = 0;
+    while (buf && (got = read(fd, buf + *size, cap - *size)) > 0){
+        *size += got;
+        if (*size == cap){
+            char * bigger = (char *) realloc(buf, 2 * cap);
+            if (!bigger) free(buf);
+            buf = bigger;
+            cap *= 2;
+        }
+    }
+    return buf;
+}
+
+
+/*************************************************************
+ * private function answering a batch of queries in worker processes
+ * forked after the graph was copied into shared memory. The queries are
+ * cut into one block per worker; when grouped, they are first ordered by
+ * start city and no start city is split between two blocks, so each one is
+ * still answered by a single resumed search. A worker formats its records
+ * in memory and sends their lengths, then the records, then its statistics:
+ * the records are written in the order of the batch, in the format of out
+ * (whose header is written first), and the statistics after them. Each
+ * worker has its own copy of the goal cache, if any.
+ * @param graph the shared graph
+ * @return the exit code of the program
+ *************************************************************/
+static int run_workers(Graph * graph, BatchQuery * q, int n, int grouped, Budget * budget,
+                       int nWorkers, int showStats, Writer * out, GoalCache * goals){
+    int * fds = (int *) malloc(nWorkers * sizeof(int));
+    pid_t * pids = (pid_t *) malloc(nWorkers * sizeof(pid_t));
+    int * order = (int *) malloc((n + 1) * sizeof(int));
+    int * block = (int *) malloc((nWorkers + 1) * sizeof(int));
+    char ** sent = (char **) calloc(nWorkers, sizeof(char *));
+    size_t * sentBytes = (size_t *) calloc(nWorkers, sizeof(size_t));
+    size_t * statsAt = (size_t *) calloc(nWorkers, sizeof(size_t));
+    int * worker = (int *) malloc((n + 1) * sizeof(int));
+    if (!fds || !pids || !order || !block || !sent || !sentBytes || !statsAt || !worker){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    
+    /* blocks of about n / nWorkers queries, a start city not split when grouped */
+    for (int i = 0; i < n; i++){
+        order[i] = i;
+        worker[i] = -1;
+    }
+    if (grouped){
+        sort_batch = q;
+        qsort(order, n, sizeof(int), by_start_city);
+    }
+    block[0] = 0;
+    for (int k = 1; k <= nWorkers; k++){
+        int end = (int)((long long)n * k / nWorkers);
+        if (end < block[k - 1]) end = block[k - 1];
+        while (grouped && end > 0 && end < n && q[order[end]].start == q[order[end - 1]].start) end++;
+        block[k] = end;
+    }
+    
+    write_header(out, RECORD_ROUTE);
+    flush_writer(out);
+    int started = 0;
+    for (; started < nWorkers; started++){
+        int p[2];
+        if (pipe(p) != 0 || (pids[started] = fork()) < 0){
+            perror("worker");
+            break;
+        }
+        if (pids[started] > 0){
+            close(p[1]);
+            fds[started] = p[0];
+            continue;
         }
         
-        Node * tmp = n->neighbours->head;
-        
-        while(tmp){
-            
-            City * succ = ((neighbour *)tmp->val)->city;
-            int distance =((neighbour *)tmp->val)->distance;
-            int distance_so_far = n->distFromStart + distance;
-            
-            if((isInList(OPEN, succ)!=0) ||
-              ((isInList(CLOSED, succ)!=0) &&
-                    (distance_so_far > succ->distFromStart)))
-            {
-                    tmp = tmp->next;
-            }
-            else{
-                if(isInList(OPEN, succ)!=0){
-                    remFromList(OPEN, succ);
+        /* worker: its block of queries, formatted in memory */
+        close(p[0]);
+        int lo = block[started], m = block[started + 1] - lo;
+        BatchQuery * mine = (BatchQuery *) malloc((m + 1) * sizeof(BatchQuery));
+        int * lengths = (int *) malloc((m + 1) * sizeof(int));
+        char * text = NULL;
+        size_t size = 0;
+        FILE * mem = open_memstream(&text, &size);
+        Writer * rec = mem ? newWriter(mem, out->fmt, 0) : NULL;
+        Workspace * ws = newWorkspace(graph);
+        if (!mine || !lengths || !rec || !ws){
+            fprintf(stderr, "%s\n", message(ERRALLOC));
+            _exit(1);
+        }
+        for (int j = 0; j < m; j++) mine[j] = q[order[lo + j]];
+        ws->goals = goals;
+        SearchStats stats;
+        status s = run_batch(graph, mine, m, grouped, budget, ws, &stats);
+        if (s != OK){
+            fprintf(stderr, "%s\n", message(s));
+            _exit(1);
+        }
+        for (int j = 0; j < m; j++){
+            size_t before = size;
+            write_route(rec, graph, order[lo + j] + 1, mine[j].start, mine[j].goal, mine[j].startName,
+                        mine[j].goalName, mine[j].res, UNREACHED, mine[j].path);
+            if (flush_writer(rec) != OK) _exit(1);
+            lengths[j] = (int)(size - before);
+        }
+        if (showStats){
+            FILE * info = out->fmt == FORMAT_HUMAN ? mem : stderr;
+            fprintf(info, "worker %d, %d queries: expanded %ld, relaxed %ld, reopened %ld, %zu bytes, %.6f s\n",
+                    started + 1, m, stats.expanded, stats.relaxed, stats.reopened, stats.bytes, stats.seconds);
+            show_goals(info, goals);
+        }
+        fflush(mem);
+        FILE * pipeOut = fdopen(p[1], "w");
+        if (!pipeOut || fwrite(lengths, sizeof(int), m, pipeOut) != (size_t)m
+            || fwrite(text, 1, size, pipeOut) != size || fclose(pipeOut) != 0)
+            _exit(1);
+        _exit(0);
+    }
+    
+    /* a worker that fails does not stop the others, its queries are left out */
+    int failed = started < nWorkers;
+    for (int k = 0; k < started; k++){
+        sent[k] = read_all(fds[k], &sentBytes[k]);
+        close(fds[k]);
+        int ws;
+        if (waitpid(pids[k], &ws, 0) < 0 || !WIFEXITED(ws) || WEXITSTATUS(ws) != 0
+            || !sent[k] || sentBytes[k] < (block[k + 1] - block[k]) * sizeof(int)){
+            fprintf(stderr, "worker %d failed\n", k + 1);
+            failed = 1;
+            free(sent[k]);
+            sent[k] = NULL;
+        }
+    }
+    
+    /* where the record of every query is, and where the statistics of each
+     * worker start, in what it sent */
+    size_t * offset = (size_t *) malloc((n + 1) * sizeof(size_t));
+    int * length = (int *) malloc((n + 1) * sizeof(int));
+    if (!offset || !length){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    for (int k = 0; k < started; k++){
+        int m = block[k + 1] - block[k];
+        size_t off = m * sizeof(int);
+        for (int j = 0; sent[k] && j < m; j++){
+            int i = order[block[k] + j];
+            worker[i] = k;
+            memcpy(&length[i], sent[k] + j * sizeof(int), sizeof(int));
+            offset[i] = off;
+            off += length[i];
+        }
+        if (sent[k] && off > sentBytes[k]){
+            fprintf(stderr, "worker %d failed\n", k + 1);
+            failed = 1;
+            free(sent[k]);
+            sent[k] = NULL;
+        }
+        statsAt[k] = off;
+    }
+    
+    /* the records in the order of the batch, then the statistics of the workers */
+    for (int i = 0; i < n; i++){
+        int k = worker[i];
+        if (k >= 0 && sent[k]) fwrite(sent[k] + offset[i], 1, length[i], stdout);
+    }
+    for (int k = 0; k < started; k++)
+        if (sent[k]) fwrite(sent[k] + statsAt[k], 1, sentBytes[k] - statsAt[k], stdout);
+    free(offset);
+    free(length);
+    for (int k = 0; k < started; k++) free(sent[k]);
+    free(fds);
+    free(pids);
+    free(order);
+    free(block);
+    free(sent);
+    free(sentBytes);
+    free(statsAt);
+    free(worker);
+    return failed;
+}
+
+int main(int argc, char * argv[]){
+    
+    char * mapfile = "FRANCE.MAP";
+    char * from = "Rennes";
+    char * to = "Lyon";
+    char * reorder = NULL;
+    char * orderfile = NULL;
+    char * packedfile = NULL;
+    int allCities = 0;
+    int nThreads = 0;
+    int nRegions = 0;
+    char * tiledfile = NULL;
+    size_t cacheBytes = 64 << 20;
+    int showStats = 0;
+    int jps = 1;
+    char * tracefile = NULL;
+    char * estimate = NULL;
+    int kPaths = 1;
+    char * batchfile = NULL;
+    int grouped = 1;
+    int nWorkers = 0;
+    int embedded = 0;
+    int hdaThreads = 0;
+    char * hubfile = NULL;
+    int fmt = FORMAT_HUMAN;
+    size_t goalBytes = 0;
+    int rangeDist = -1;
+    long rangeLimit;
+    char * end;
+    char ** places = &from;
+    int nPlaces = 1;
+    char * deltas[MAX_DELTAS];
+    int nDeltas = 0;
+    Budget budget = {0, 0, 0};
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "e:t:m:r:p:z:aj:f:T:C:snx:H:k:b:iw:ED:ML:u:vo:G:R:")) != -1){
+        switch (opt){
+            case 'e': budget.maxExpansions = atol(optarg); break;
+            case 't': budget.maxSeconds = atof(optarg); break;
+            case 'm': budget.maxBytes = (size_t) atol(optarg); break;
+            case 'r': reorder = optarg; break;
+            case 'p': orderfile = optarg; break;
+            case 'z': packedfile = optarg; break;
+            case 'a': allCities = 1; break;
+            case 'j': nThreads = atoi(optarg); break;
+            case 'f': nRegions = atoi(optarg); break;
+            case 'T': tiledfile = optarg; break;
+            case 'C': cacheBytes = (size_t) atol(optarg); break;
+            case 's': showStats = 1; break;
+            case 'n': jps = 0; break;
+            case 'x': tracefile = optarg; break;
+            case 'H': estimate = optarg; break;
+            case 'k': kPaths = atoi(optarg); break;
+            case 'b': batchfile = optarg; break;
+            case 'i': grouped = 0; break;
+            case 'w': nWorkers = atoi(optarg); break;
+            case 'E': embedded = 1; break;
+            case 'D': hdaThreads = atoi(optarg); break;
+            case 'M': atexit(report_memory); break;
+            case 'L': hubfile = optarg; break;
+            case 'u':
+                if (nDeltas == MAX_DELTAS){
+                    usage(argv[0]);
+                    return 1;
+                }
+                deltas[nDeltas++] = optarg;
+                break;
+            case 'v': verbose_load = 1; break;
+            case 'G': goalBytes = (size_t) atol(optarg); break;
+            case 'R':
+                rangeLimit = strtol(optarg, &end, 10);
+                if (end == optarg || *end || rangeLimit < 0 || rangeLimit > INT_MAX){
+                    usage(argv[0]);
+                    return 1;
                 }
-                if(isInList(CLOSED, succ)!=0){
-                    remFromList(CLOSED, succ);
+                rangeDist = (int)rangeLimit;
+                break;
+            case 'o':
+                if ((fmt = parse_format(optarg)) < 0){
+                    usage(argv[0]);
+                    return 1;
                 }
-                succ->distFromStart = distance_so_far;
-                succ->ptr = n;
-                addList(OPEN, succ);
-                tmp = tmp->next;
+                break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    /* HDA* has no partial path to give when a budget runs out: it takes none */
+    if (hdaThreads && (budget.maxExpansions || budget.maxSeconds > 0 || budget.maxBytes)){
+        usage(argv[0]);
+        return 1;
+    }
+    /* range searches answer their origins alone, without a budget */
+    if (rangeDist >= 0 && (batchfile || nWorkers || kPaths != 1 || allCities || hdaThreads || budget.maxExpansions
+                           || budget.maxSeconds > 0 || budget.maxBytes)){
+        usage(argv[0]);
+        return 1;
+    }
+    /* statistics go along the results for people, apart from records */
+    FILE * info = fmt == FORMAT_HUMAN ? stdout : stderr;
+    memory_info = info;
+    if (embedded) mapfile = (char *)embedded_map.source;
+    else if (optind < argc) mapfile = argv[optind++];
+    if (allCities && optind < argc) from = argv[optind++];
+    else if (rangeDist >= 0 && optind < argc){
+        places = argv + optind;
+        nPlaces = argc - optind;
+    }
+    else if (optind + 1 < argc){
+        from = argv[optind++];
+        to = argv[optind++];
+    }
+    
+    /* grid maps have their own search, from cell to cell */
+    if (!embedded && is_grid(mapfile)){
+        if (allCities || rangeDist >= 0 || !strchr(from, ',')){
+            usage(argv[0]);
+            return 1;
+        }
+        int res = run_grid(mapfile, from, to, jps, packedfile, &budget, showStats);
+        return res ? res : dump_trace(tracefile);
+    }
+    
+    /* a map is either a text file read into a list of cities, a compressed
+     * or tiled graph, or the map compiled in */
+    Graph * graph;
+    List * all_cities = NULL;
+    if (embedded) graph = embedded_graph(&embedded_map);
+    else if (is_compressed(mapfile)) graph = load_compressed(mapfile);
+    else if (is_tiled(mapfile)) graph = load_tiled(mapfile, cacheBytes);
+    else {
+        all_cities = map_to_list(mapfile);
+        if (!all_cities){
+            fprintf(stderr, "%s: %s\n", mapfile, message(ERROPEN));
+            return 1;
+        }
+        graph = list_to_graph(all_cities);
+    }
+    /* a stored graph that cannot be loaded is mostly a file cut or damaged */
+    if (!graph && !all_cities){
+        fprintf(stderr, "%s: %s\n", mapfile, message(ERROPEN));
+        return 1;
+    }
+    Workspace * ws = graph ? newWorkspace(graph) : NULL;
+    if (!ws){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    
+    /* calibrate the estimate on the roads of the map, except on tiled maps
+     * unless asked for (every tile would be read, they keep the scale they
+     * were saved with) and on the map compiled in (calibrated when
+     * generated) */
+    char * metrics[] = {"manhattan", "euclidean", "greatcircle"};
+    int m = 0;
+    while (estimate && m < 3 && strcmp(estimate, metrics[m]) != 0) m++;
+    if (estimate && m == 3 && strcmp(estimate, "none") != 0){
+        usage(argv[0]);
+        return 1;
+    }
+    if (m == 3){
+        graph->hMetric = METRIC_MANHATTAN;
+        graph->hScale = DEFAULT_H_SCALE;
+    }
+    else if ((estimate || (!embedded && (!graph->store || !is_tiled(mapfile)))) && calibrate_h(graph, (metric)m) != OK){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    /* the estimate left uncalibrated, by -H none or in a tiled map saved
+     * with it, may not be consistent, which resumed searches rely on: a
+     * batch is then answered with -i */
+    if (batchfile && grouped && graph->hScale == DEFAULT_H_SCALE){
+        usage(argv[0]);
+        return 1;
+    }
+    
+    /* renumber the nodes (and save that order) or restore a saved order */
+    if (reorder || orderfile){
+        int * perm = NULL;
+        if (reorder && strcmp(reorder, "hilbert") == 0) perm = hilbert_order(graph);
+        else if (reorder && strcmp(reorder, "rcm") == 0) perm = rcm_order(graph);
+        else if (reorder){
+            usage(argv[0]);
+            return 1;
+        }
+        else perm = load_order(graph, orderfile);
+        /* an order file that cannot be read is refused, an order that cannot
+         * be computed is short of memory */
+        status s = perm ? renumber_graph(graph, perm) : reorder ? ERRALLOC : ERRACCESS;
+        free(perm);
+        if (s != OK){
+            fprintf(stderr, "%s: %s\n", orderfile ? orderfile : reorder, message(s));
+            return 1;
+        }
+        if (reorder && orderfile && save_order(graph, orderfile) != OK){
+            fprintf(stderr, "%s: %s\n", orderfile, message(ERROPEN));
+            return 1;
+        }
+    }
+    
+    /* tiles are runs of consecutive nodes: they need a geographic order */
+    if (tiledfile){
+        int * perm = reorder || orderfile ? NULL : hilbert_order(graph);
+        status s = perm ? renumber_graph(graph, perm) : OK;
+        free(perm);
+        if (s == OK) s = save_tiled(graph, 0, tiledfile);
+        if (s != OK){
+            fprintf(stderr, "%s: %s\n", tiledfile, message(s));
+            return 1;
+        }
+    }
+    
+    if (packedfile){
+        Graph * packed = compress_graph(graph);
+        status s = packed ? save_compressed(packed, packedfile) : ERRUNABLE;
+        if (s != OK){
+            fprintf(stderr, "%s: %s\n", packedfile, message(s));
+            return 1;
+        }
+        delGraph(packed);
+    }
+    
+    /* changes to the map, in an overlay over the map as loaded */
+    if (nDeltas){
+        graph = newOverlay(graph, 1);
+        if (!graph){
+            fprintf(stderr, "%s\n", message(ERRALLOC));
+            return 1;
+        }
+        double scale = graph->hScale;
+        for (int d = 0; d < nDeltas; d++){
+            int line;
+            status s = apply_delta(graph, deltas[d], &line);
+            if (s != OK){
+                if (line) fprintf(stderr, "%s:%d: %s\n", deltas[d], line, message(s));
+                else fprintf(stderr, "%s: %s\n", deltas[d], message(s));
+                return 1;
             }
         }
+        if (showStats){
+            fprintf(info, "%d delta files: %d cities, %d roads, overlay holding the roads of %d cities\n",
+                   nDeltas, graph->nCities, graph->nEdges, overlay_changes(graph));
+            if (graph->hScale < scale)
+                fprintf(info, "estimate scaled down from %.6f to %.6f by roads shorter than it\n",
+                       scale, graph->hScale);
+        }
+        delWorkspace(ws);
+        ws = newWorkspace(graph);
+        if (!ws){
+            fprintf(stderr, "%s\n", message(ERRALLOC));
+            return 1;
+        }
     }
     
-    puts("failure");
-    return 0;
+    if (nRegions){
+        graph->arcFlags = build_arc_flags(graph, nRegions, nThreads);
+        if (!graph->arcFlags){
+            fprintf(stderr, "-f %d: %s\n", nRegions, message(ERRUNABLE));
+            return 1;
+        }
+    }
+    
+    /* hub labels: read from the file, or built and written to it if there
+     * is none (a file of another map is not overwritten) */
+    HubLabels * hubs = NULL;
+    if (hubfile){
+        hubs = load_hub_labels(graph, hubfile);
+        if (!hubs && access(hubfile, F_OK) == 0){
+            fprintf(stderr, "%s: %s\n", hubfile, message(ERRACCESS));
+            return 1;
+        }
+        if (!hubs){
+            hubs = build_hub_labels(graph);
+            status s = hubs ? save_hub_labels(hubs, hubfile) : ERRALLOC;
+            if (s != OK){
+                fprintf(stderr, "%s: %s\n", hubfile, message(s));
+                return 1;
+            }
+            if (showStats) fprintf(info, "hub labels built in %.2f s\n", hubs->buildSeconds);
+        }
+    }
+    
+    /* exact estimates toward the goals many queries go to */
+    GoalCache * goals = NULL;
+    if (goalBytes){
+        goals = newGoalCache(graph, goalBytes, 0);
+        if (!goals){
+            fprintf(stderr, "%s\n", message(ERRALLOC));
+            return 1;
+        }
+        ws->goals = goals;
+    }
+    
+    /* the results, in one buffer written in large blocks */
+    Writer * out = newWriter(stdout, (format)fmt, 0);
+    if (!out){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    
+    /* shortest path tree: distance and predecessor of every city from start */
+    if (allCities){
+        int start = find_place(graph, from);
+        int * dist = (int *) malloc((graph->nCities + 1) * sizeof(int));
+        int * parent = (int *) malloc((graph->nCities + 1) * sizeof(int));
+        status s = start < 0 ? ERRABSENT : !dist || !parent ? ERRALLOC
+            : delta_stepping(graph, start, 0, nThreads, dist, parent);
+        if (s != OK){
+            fprintf(stderr, "%s: %s\n", from, message(s));
+            return 1;
+        }
+        write_header(out, RECORD_TREE);
+        for (int u = 0; u < graph->nCities; u++) write_tree(out, graph, u, dist[u], parent[u]);
+        free(dist);
+        free(parent);
+        return finish(out, tracefile);
+    }
+    
+    /* cities within a distance of every origin, the origins shared among threads */
+    if (rangeDist >= 0){
+        int nWs = nThreads > 0 ? nThreads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (nWs > nPlaces) nWs = nPlaces;
+        if (nWs < 1) nWs = 1;
+        int * origins = (int *) malloc(nPlaces * sizeof(int));
+        Reach ** reach = (Reach **) calloc(nPlaces, sizeof(Reach *));
+        Workspace ** spaces = (Workspace **) calloc(nWs, sizeof(Workspace *));
+        status s = origins && reach && spaces ? OK : ERRALLOC;
+        for (int i = 0; s == OK && i < nPlaces; i++){
+            if ((origins[i] = find_place(graph, places[i])) < 0){
+                fprintf(stderr, "%s: %s\n", places[i], message(ERRABSENT));
+                return 1;
+            }
+            if (!(reach[i] = newReach(0))) s = ERRALLOC;
+        }
+        spaces[0] = ws;
+        for (int t = 1; s == OK && t < nWs; t++)
+            if (!(spaces[t] = newWorkspace(graph))) s = ERRALLOC;
+        SearchStats stats;
+        if (s == OK) s = range_searches(graph, origins, nPlaces, rangeDist, spaces, nWs, reach, &stats);
+        if (s != OK){
+            fprintf(stderr, "%s\n", message(s));
+            return 1;
+        }
+        write_header(out, RECORD_RANGE);
+        for (int i = 0; i < nPlaces; i++){
+            char line[256], buf[20];
+            snprintf(line, sizeof(line), "%s, within %d: %d cities\n",
+                     city_name(graph, origins[i], buf), rangeDist, reach[i]->n);
+            write_text(out, line);
+            for (int j = 0; j < reach[i]->n; j++)
+                write_reach(out, graph, origins[i], reach[i]->node[j], reach[i]->dist[j], reach[i]->parent[j]);
+        }
+        flush_writer(out);
+        if (showStats)
+            fprintf(info, "%d origins, %d threads: expanded %ld, relaxed %ld, pruned %ld, %zu bytes, %.6f s\n",
+                    nPlaces, nWs, stats.expanded, stats.relaxed, stats.pruned, stats.bytes, stats.seconds);
+        for (int i = 0; i < nPlaces; i++) delReach(reach[i]);
+        for (int t = 1; t < nWs; t++) delWorkspace(spaces[t]);
+        free(reach);
+        free(spaces);
+        free(origins);
+        return finish(out, tracefile);
+    }
+    
+    /* batch of distances, from the hub labels */
+    if (batchfile && hubs){
+        int n = 0;
+        BatchQuery * q = read_batch(graph, batchfile, &n);
+        if (!q){
+            fprintf(stderr, "%s: %s\n", batchfile, message(ERROPEN));
+            return 1;
+        }
+        double t0 = search_clock();
+        write_header(out, RECORD_ROUTE);
+        for (int i = 0; i < n; i++){
+            int d = q[i].res == ERRABSENT ? UNREACHED : hub_distance(hubs, q[i].start, q[i].goal);
+            write_route(out, graph, i + 1, q[i].start, q[i].goal, q[i].startName, q[i].goalName,
+                        q[i].res == ERRABSENT ? ERRABSENT : d == UNREACHED ? ERRNOPATH : OK, d, NULL);
+        }
+        flush_writer(out);
+        if (showStats) fprintf(info, "%d distances, %.6f s\n", n, search_clock() - t0);
+        delBatch(q, n);
+        delHubLabels(hubs);
+        delArcFlags(graph->arcFlags);
+        delWorkspace(ws);
+        delGraph(graph);
+        return finish(out, tracefile);
+    }
+    
+    /* batch of queries, grouped by start city unless -i */
+    if (batchfile){
+        /* pre-fork: the workers share one read-only copy of the graph */
+        if (nWorkers > 0){
+            Graph * shared = share_graph(graph, NULL);
+            if (!shared){
+                fprintf(stderr, "%s\n", message(ERRALLOC));
+                return 1;
+            }
+            delGoalCache(goals);
+            delArcFlags(graph->arcFlags);
+            delWorkspace(ws);
+            delGraph(graph);
+            delCities(all_cities);
+            graph = shared;
+            if (goalBytes && !(goals = newGoalCache(graph, goalBytes, 0))){
+                fprintf(stderr, "%s\n", message(ERRALLOC));
+                return 1;
+            }
+        }
+        int n = 0;
+        BatchQuery * q = read_batch(graph, batchfile, &n);
+        if (!q){
+            fprintf(stderr, "%s: %s\n", batchfile, message(ERROPEN));
+            return 1;
+        }
+        if (nWorkers > 0){
+            if (showStats) fprintf(info, "shared graph: %zu bytes, %d workers\n", shared_bytes(graph), nWorkers);
+            int res = run_workers(graph, q, n, grouped, &budget, nWorkers, showStats, out, goals);
+            delBatch(q, n);
+            delGoalCache(goals);
+            delGraph(graph);
+            if (res) return res;
+            return finish(out, tracefile);
+        }
+        SearchStats stats;
+        status s = run_batch(graph, q, n, grouped, &budget, ws, &stats);
+        if (s != OK){
+            fprintf(stderr, "%s\n", message(s));
+            return 1;
+        }
+        write_header(out, RECORD_ROUTE);
+        for (int i = 0; i < n; i++)
+            write_route(out, graph, i + 1, q[i].start, q[i].goal, q[i].startName, q[i].goalName, q[i].res,
+                        UNREACHED, q[i].path);
+        flush_writer(out);
+        if (showStats){
+            fprintf(info, "%d queries: expanded %ld, relaxed %ld, reopened %ld, %zu bytes, %.6f s\n",
+                   n, stats.expanded, stats.relaxed, stats.reopened, stats.bytes, stats.seconds);
+            show_goals(info, goals);
+        }
+        delBatch(q, n);
+        delArcFlags(graph->arcFlags);
+        delWorkspace(ws);
+        delGoalCache(goals);
+        delGraph(graph);
+        return finish(out, tracefile);
+    }
+    
+    int start = find_place(graph, from);
+    int goal = find_place(graph, to);
+    if (start < 0 || goal < 0){
+        fprintf(stderr, "%s: %s\n", start < 0 ? from : to, message(ERRABSENT));
+        return 1;
+    }
+    
+    /* alternatives: the k shortest loopless paths */
+    if (kPaths > 1){
+        Path ** paths = (Path **) malloc(kPaths * sizeof(Path *));
+        int found = 0;
+        SearchStats stats;
+        status s = paths ? k_shortest_paths(graph, start, goal, kPaths, nThreads, paths, &found, &stats) : ERRALLOC;
+        if (s != OK && s != ERRNOPATH){
+            fprintf(stderr, "%s\n", message(s));
+            return 1;
+        }
+        char title[64];
+        snprintf(title, sizeof title, "\n\nThe %d shortest paths found:\n\n", found);
+        write_text(out, found ? title : "failure\n");
+        write_header(out, RECORD_ROUTE);
+        for (int i = 0; i < found; i++){
+            write_route(out, graph, i + 1, start, goal, NULL, NULL, OK, UNREACHED, paths[i]);
+            delPath(paths[i]);
+        }
+        flush_writer(out);
+        if (showStats)
+            fprintf(info, "expanded %ld, relaxed %ld, reopened %ld, %zu bytes, %.6f s\n",
+                   stats.expanded, stats.relaxed, stats.reopened, stats.bytes, stats.seconds);
+        free(paths);
+        delArcFlags(graph->arcFlags);
+        delWorkspace(ws);
+        delGoalCache(goals);
+        delGraph(graph);
+        return finish(out, tracefile);
+    }
+    
+    /* one query on several threads (HDA*), or on the calling thread */
+    SearchStats stats;
+    Path * path = newPath(graph->nCities);
+    status s = !path ? ERRALLOC : hdaThreads > 0 ? hda_star(graph, start, goal, hdaThreads, path, &stats)
+        : astar(graph, start, goal, &budget, ws, &stats);
+    if (!path || s == ERRALLOC || (!hdaThreads && s != ERRNOPATH && extract_path(ws, path) != OK)){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 1;
+    }
+    
+    char title[96];
+    if (s == ERRBUDGET) snprintf(title, sizeof title, "\n\n%s after %ld expansions\n\nBest partial path:\n\n",
+                                 message(s), stats.expanded);
+    write_text(out, s == OK ? "\n\nSuccess!\n\nThe path found:\n\n" : s == ERRBUDGET ? title : "");
+    write_header(out, RECORD_ROUTE);
+    write_route(out, graph, 0, start, goal, NULL, NULL, s, UNREACHED, s == ERRNOPATH ? NULL : path);
+    if (hubs){
+        double t0 = search_clock();
+        int d = hub_distance(hubs, start, goal);
+        double seconds = search_clock() - t0;
+        char line[64];
+        if (d == UNREACHED) snprintf(line, sizeof line, "Hub labels: no path\n");
+        else snprintf(line, sizeof line, "Hub labels: distance %d\n", d);
+        write_text(out, line);
+        flush_writer(out);
+        if (showStats) fprintf(info, "hub labels: %.1f entries per node, %zu bytes, %.6f s\n",
+                              (double)(hubs->outFirst[graph->nCities] + hubs->inFirst[graph->nCities]) / graph->nCities / 2 - 1,
+                              hub_labels_bytes(hubs), seconds);
+        delHubLabels(hubs);
+    }
+    
+    flush_writer(out);
+    if (showStats){
+        TileStats ts;
+        fprintf(info, "estimate: %s x %.6f\n", metrics[graph->hMetric], graph->hScale);
+        fprintf(info, "expanded %ld, relaxed %ld, reopened %ld, pruned %ld, %zu bytes, %.6f s\n",
+               stats.expanded, stats.relaxed, stats.reopened, stats.pruned, stats.bytes, stats.seconds);
+        if (tile_stats(graph, &ts) == OK)
+            fprintf(info, "tiles: %ld hits, %ld misses, %ld evictions, %d resident (%zu bytes, peak %zu of %zu)\n",
+                   ts.hits, ts.misses, ts.evictions, ts.resident, ts.residentBytes, ts.peakBytes, ts.budgetBytes);
+        show_goals(info, goals);
+    }
+    
+    delArcFlags(graph->arcFlags);
+    delPath(path);
+    delWorkspace(ws);
+    delGoalCache(goals);
+    delGraph(graph);
+    return finish(out, tracefile);
 }
@@ -0,0 +1,303 @@
+//
+//  perfcheck.c
+//  Astar
+//
+//  Performance regression check, run by make perf.
+//
+//  usage: perfcheck [-b baseline] [-u] [-e reference] [-U] [-t threshold] [-r repetitions] map ...
+//
+//  For every map, the same deterministic queries are answered (seeded
+//  random starts, QUERY_GOALS random goals each, the estimate calibrated
+//  as Astar does) and their costs checked against Dijkstra from every
+//  start: a wrong cost fails the check whatever the timings. Three metrics
+//  are then measured:
+//    load_ms:   reading the map with map_to_list and list_to_graph
+//    query_us:  latency per query of the whole set
+//    expanded:  expansions of the whole set (exact, not timed)
+//  Timings are the fastest of the repetitions (15 by default), each one
+//  running the work as many times as it takes to last MIN_SAMPLE_MS, so
+//  that small maps are not measured at the resolution of the clock: other
+//  processes only ever slow a repetition down, so the fastest one varies
+//  much less from run to run than the median.
+//
+//  Timings depend on the machine: they are compared with the baseline file
+//  of this machine (one "map metric value" line each), and any timing worse
+//  than it by more than threshold percent (10 by default) is a regression.
+//  Without a baseline file, or with -u, the timings are written as the new
+//  baseline instead. Expansions are the same on every machine: they are
+//  compared with the reference file, kept with the sources, and any
+//  increase is a regression. Only -U writes the reference, when a change
+//  of the searches is meant to change them. A table of the changes of all
+//  metrics is displayed.
+//
+//  Exit code: 0 if no regression, 1 if a metric regressed, 2 if a cost is
+//  wrong or a map cannot be read.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Map.h"
+#include "Graph.h"
+#include "Search.h"
+#include "Sssp.h"
+
+#define QUERY_STARTS 20
+#define QUERY_GOALS 10
+#define MIN_SAMPLE_MS 20.0
+#define MAX_METRICS 64
+
+/** A measured metric of a map, and its value in the baseline (-1 if absent) **/
+typedef struct Metric{
+    char map[200];
+    char name[16];
+    double value;
+    double baseline;
+    int exact;
+}Metric;
+
+static Metric metrics[MAX_METRICS];
+static int nMetrics = 0;
+
+/** private linear congruential generator, so the queries only depend on the map **/
+static unsigned long long seed_state;
+static unsigned rnd(void){
+    seed_state = seed_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned)(seed_state >> 33);
+}
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int compDouble(const void * a, const void * b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+
+/** private function recording a metric of a map, exact if it does not depend on the machine **/
+static void record(char * map, char * name, double value, int exact){
+    if (nMetrics == MAX_METRICS) return;
+    Metric * m = &metrics[nMetrics++];
+    snprintf(m->map, sizeof m->map, "%s", map);
+    snprintf(m->name, sizeof m->name, "%s", name);
+    m->value = value;
+    m->baseline = -1;
+    m->exact = exact;
+}
+
+
+/** private function loading a map, NULL if it cannot be read **/
+static Graph * load(char * mapfile, List ** all_cities){
+    *all_cities = map_to_list(mapfile);
+    return *all_cities ? list_to_graph(*all_cities) : NULL;
+}
+
+
+/*************************************************************
+ * private function measuring a map: checks the costs of its queries and
+ * records its metrics
+ * @param mapfile the map
+ * @param reps number of repetitions of the timings
+ * @return 0, or 2 if the map cannot be read or a cost is wrong
+ *************************************************************/
+static int measure(char * mapfile, int reps){
+    List * all_cities;
+    Graph * g = load(mapfile, &all_cities);
+    if (!g || calibrate_h(g, METRIC_MANHATTAN) != OK){
+        fprintf(stderr, "%s: %s\n", mapfile, message(ERROPEN));
+        return 2;
+    }
+    
+    /* the queries, with their reference costs from Dijkstra */
+    int nQueries = QUERY_STARTS * QUERY_GOALS;
+    int * from = (int *) malloc(nQueries * sizeof(int));
+    int * to = (int *) malloc(nQueries * sizeof(int));
+    int * ref = (int *) malloc(nQueries * sizeof(int));
+    int * dist = (int *) malloc((g->nCities + 1) * sizeof(int));
+    int * parent = (int *) malloc((g->nCities + 1) * sizeof(int));
+    double * samples = (double *) malloc(reps * sizeof(double));
+    Workspace * ws = newWorkspace(g);
+    if (!from || !to || !ref || !dist || !parent || !samples || !ws){
+        fprintf(stderr, "%s\n", message(ERRALLOC));
+        return 2;
+    }
+    seed_state = (unsigned long long)g->nCities * 2654435761ULL + g->nEdges;
+    for (int s = 0; s < QUERY_STARTS; s++){
+        int start = rnd() % g->nCities;
+        if (dijkstra(g, start, dist, parent) != OK){
+            fprintf(stderr, "%s\n", message(ERRALLOC));
+            return 2;
+        }
+        for (int k = 0; k < QUERY_GOALS; k++){
+            int i = s * QUERY_GOALS + k;
+            from[i] = start;
+            to[i] = rnd() % g->nCities;
+            ref[i] = dist[to[i]] == UNREACHED ? -1 : dist[to[i]];
+        }
+    }
+    
+    long expanded = 0;
+    for (int i = 0; i < nQueries; i++){
+        SearchStats st;
+        status s = astar(g, from[i], to[i], NULL, ws, &st);
+        int cost = s == OK ? ws->g[ws->reached] : -1;
+        if (cost != ref[i]){
+            char a[20], b[20];
+            fprintf(stderr, "%s: %s to %s costs %d instead of %d\n", mapfile,
+                    city_name(g, from[i], a), city_name(g, to[i], b), cost, ref[i]);
+            return 2;
+        }
+        expanded += st.expanded;
+    }
+    
+    /* latency: fastest repetition of as many passes over the queries as last MIN_SAMPLE_MS */
+    int passes = 1;
+    for (int r = -1; r < reps; r++){
+        double t0 = now_ms();
+        for (int p = 0; p < passes; p++)
+            for (int i = 0; i < nQueries; i++) astar(g, from[i], to[i], NULL, ws, NULL);
+        double elapsed = now_ms() - t0;
+        if (r < 0){
+            while (passes * elapsed < MIN_SAMPLE_MS) passes *= 2;
+            continue;
+        }
+        samples[r] = elapsed / passes / nQueries * 1e3;
+    }
+    qsort(samples, reps, sizeof(double), compDouble);
+    double queryUs = samples[0];
+    
+    delWorkspace(ws);
+    delGraph(g);
+    delCities(all_cities);
+    
+    /* loading, with the list of cities destroyed between loads */
+    passes = 1;
+    for (int r = -1; r < reps; r++){
+        double t0 = now_ms();
+        for (int p = 0; p < passes; p++){
+            g = load(mapfile, &all_cities);
+            if (!g) return 2;
+            delGraph(g);
+            delCities(all_cities);
+        }
+        double elapsed = now_ms() - t0;
+        if (r < 0){
+            while (passes * elapsed < MIN_SAMPLE_MS) passes *= 2;
+            continue;
+        }
+        samples[r] = elapsed / passes;
+    }
+    qsort(samples, reps, sizeof(double), compDouble);
+    
+    record(mapfile, "load_ms", samples[0], 0);
+    record(mapfile, "query_us", queryUs, 0);
+    record(mapfile, "expanded", (double)expanded, 1);
+    free(from);
+    free(to);
+    free(ref);
+    free(dist);
+    free(parent);
+    free(samples);
+    return 0;
+}
+
+
+/** private function reading the baseline values of the measured metrics,
+ * exact ones or timings, 0 if there is no such file **/
+static int read_baseline(char * filepath, int exact){
+    FILE * f = fopen(filepath, "r");
+    if (!f) return 0;
+    char map[200], name[16], line[512];
+    double value;
+    while (fgets(line, sizeof line, f)){
+        if (line[0] == '#' || sscanf(line, "%199s %15s %lf", map, name, &value) != 3) continue;
+        for (int i = 0; i < nMetrics; i++)
+            if (metrics[i].exact == exact && strcmp(metrics[i].map, map) == 0 && strcmp(metrics[i].name, name) == 0)
+                metrics[i].baseline = value;
+    }
+    fclose(f);
+    return 1;
+}
+
+
+/** private function writing the measured metrics, exact ones or timings, as the baseline **/
+static int write_baseline(char * filepath, int exact){
+    FILE * f = fopen(filepath, "w");
+    if (!f) return 0;
+    fprintf(f, "# map metric value, written by perfcheck %s\n", exact ? "-U" : "-u");
+    for (int i = 0; i < nMetrics; i++)
+        if (metrics[i].exact == exact) fprintf(f, "%s %s %.6g\n", metrics[i].map, metrics[i].name, metrics[i].value);
+    return fclose(f) == 0;
+}
+
+
+int main(int argc, char * argv[]){
+    char * baseline = "perf.baseline", * reference = "perf.reference";
+    double threshold = 10;
+    int reps = 15, update = 0, updateReference = 0, opt;
+    while ((opt = getopt(argc, argv, "b:ue:Ut:r:")) != -1){
+        switch (opt){
+            case 'b': baseline = optarg; break;
+            case 'u': update = 1; break;
+            case 'e': reference = optarg; break;
+            case 'U': updateReference = 1; break;
+            case 't': threshold = atof(optarg); break;
+            case 'r': reps = atoi(optarg); break;
+            default: reps = 0;
+        }
+    }
+    if (reps < 1 || threshold < 0 || optind == argc){
+        fprintf(stderr, "usage: %s [-b baseline] [-u] [-e reference] [-U] [-t threshold] [-r repetitions] map ...\n",
+                argv[0]);
+        return 2;
+    }
+    
+    verbose_load = 0;
+    for (int m = optind; m < argc; m++)
+        if (measure(argv[m], reps) != 0) return 2;
+    
+    /* -u and -U only write; otherwise the timings of the first run of this
+     * machine are written as its baseline, and compared with themselves */
+    if (updateReference && !write_baseline(reference, 1)){
+        fprintf(stderr, "%s: %s\n", reference, message(ERROPEN));
+        return 2;
+    }
+    if ((update || (!updateReference && !read_baseline(baseline, 0))) && !write_baseline(baseline, 0)){
+        fprintf(stderr, "%s: %s\n", baseline, message(ERROPEN));
+        return 2;
+    }
+    if (update || updateReference){
+        for (int i = 0; i < nMetrics; i++)
+            if (metrics[i].exact ? updateReference : update)
+                printf("%-20s %-10s %14.4g\n", metrics[i].map, metrics[i].name, metrics[i].value);
+        if (updateReference) printf("reference written to %s\n", reference);
+        if (update) printf("baseline written to %s\n", baseline);
+        return 0;
+    }
+    read_baseline(baseline, 0);
+    read_baseline(reference, 1);
+    
+    int regressions = 0;
+    printf("%-20s %-10s %14s %14s %9s\n", "map", "metric", "baseline", "current", "change");
+    for (int i = 0; i < nMetrics; i++){
+        Metric * m = &metrics[i];
+        if (m->baseline < 0){
+            printf("%-20s %-10s %14s %14.4g %9s\n", m->map, m->name, "-", m->value, "new");
+            continue;
+        }
+        double change = m->baseline > 0 ? 100 * (m->value / m->baseline - 1) : m->value > 0 ? 100 : 0;
+        int regressed = change > (m->exact ? 0 : threshold);
+        regressions += regressed;
+        printf("%-20s %-10s %14.4g %14.4g %+8.1f%%%s\n", m->map, m->name, m->baseline, m->value, change,
+               regressed ? "  REGRESSION" : "");
+    }
+    if (regressions) printf("%d metric%s worse than the baseline or the reference\n",
+                            regressions, regressions > 1 ? "s" : "");
+    return regressions ? 1 : 0;
+}
@@ -32,6 +32,8 @@ static char* msg[] = {
     "Value already exists",
     "index out of bounds",
     "unable to perform operation",
+    "search budget exhausted",
+    "no path between given cities",
     
     "unknown error"
 };
@@ -30,6 +30,8 @@ typedef enum {
     ERREXIST,
     ERRINDEX,
     ERRUNABLE,
+    ERRBUDGET,
+    ERRNOPATH,
     
     ERRUNKNOWN,
 } status;